@@ -0,0 +1,413 @@
+/*
+ * simbench.c
+ *
+ * Author: Sean Manson
+ *
+ * Cycle benchmark of the firmware, run under simavr.
+ *
+ * The firmware is built with BENCHMARK defined, so each of the markers
+ * in ../src/bench.h writes to GPIOR0. We watch those writes and count
+ * the CPU cycles between the start and end of each marker. Serial
+ * input is played in from a script (as if typed on the terminal) and
+ * the joystick is held in the centre, so the game is started and the
+ * frog moved around in the same way every run.
+ *
+ * At the end the number of times each marker was hit and the min,
+ * mean and max cycles are printed. The max of each is compared with
+ * the budget for that marker, and any that are over budget fail.
+ *
+ * Usage: simbench [--update] [--duration ms] firmware.elf input budgets
+ * With --update, the budgets file is rewritten from the results (the
+ * max of each marker plus BUDGET_HEADROOM percent). If budgets is -,
+ * the results are only printed.
+ *
+ * The input script has one line per input: the time (in ms from
+ * reset) followed by a space and the characters to send. \n, \r, \e
+ * (escape) and \\ can be used. Blank lines and lines starting with #
+ * are ignored. The budgets file has one line per marker: the name and
+ * the budget in cycles. If it has a line saying "uncalibrated", the
+ * budgets are only estimates: markers over them are reported but
+ * don't fail. (--update leaves this line out.)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+#include <simavr/avr_adc.h>
+
+#include "bench.h"
+
+#define CPU_FREQUENCY 8000000UL
+#define CYCLES_PER_MS (CPU_FREQUENCY / 1000)
+
+// GPIOR0 is I/O register 0x1E, i.e. data address 0x3E
+#define GPIOR0_ADDRESS 0x3E
+
+// Joystick position (mV on A6 and A7 - the centre with AVCC = 5V)
+#define SUPPLY_MV 5000
+#define JOYSTICK_CENTRE_MV 2500
+
+#define DEFAULT_DURATION_MS 20000
+#define MAX_DEPTH 8
+#define MAX_INPUTS 512
+#define MAX_LINE 256
+#define BUDGET_HEADROOM 10
+
+// The name of each marker, as used in the budgets file
+static const char* const marker_names[BENCH_NUM_MARKERS] = {
+	[BENCH_ISR_TIMER0] = "isr_timer0",
+	[BENCH_ISR_ADC] = "isr_adc",
+	[BENCH_ISR_USART_RX] = "isr_usart_rx",
+	[BENCH_ISR_USART_UDRE] = "isr_usart_udre",
+	[BENCH_ISR_EEPROM] = "isr_eeprom",
+	[BENCH_ISR_SYNTH] = "isr_synth",
+	[BENCH_SPI_BURST] = "spi_burst",
+	[BENCH_SCROLL_LANE] = "scroll_lane",
+	[BENCH_SCROLL_LOG_CHANNEL] = "scroll_log_channel",
+	[BENCH_REDRAW_WHOLE_DISPLAY] = "redraw_whole_display",
+	[BENCH_REDRAW_ROADSIDE] = "redraw_roadside",
+	[BENCH_REDRAW_TRAFFIC_LANE] = "redraw_traffic_lane",
+	[BENCH_REDRAW_RIVER_CHANNEL] = "redraw_river_channel",
+	[BENCH_REDRAW_RIVERBANK] = "redraw_riverbank",
+	[BENCH_REDRAW_FROG] = "redraw_frog",
+	[BENCH_PLAY_LEVEL_LOOP] = "play_level_loop",
+};
+
+// simavr's names for the chip, most specific first
+static const char* const mcu_names[] = {"atmega324a", "atmega324p", "atmega324"};
+
+typedef struct {
+	uint32_t count;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+	uint64_t budget; // 0 if there isn't one
+} MarkerStats;
+
+static MarkerStats markers[BENCH_NUM_MARKERS];
+
+// Whether the budgets were measured (see above)
+static uint8_t calibrated = 1;
+
+// Markers which have begun but not ended, innermost last
+static struct {
+	uint8_t id;
+	avr_cycle_count_t start;
+} stack[MAX_DEPTH];
+static uint8_t depth;
+static uint32_t marker_errors;
+
+// Scripted serial input, in time order
+static struct {
+	avr_cycle_count_t cycle;
+	uint8_t byte;
+} inputs[MAX_INPUTS];
+static uint32_t num_inputs;
+
+static void usage(void);
+static uint8_t marker_id(const char* name);
+static void gpior0_write(avr_t* avr, avr_io_addr_t address, uint8_t value, void* param);
+static void end_marker(uint8_t id, avr_cycle_count_t cycle);
+static uint8_t read_inputs(const char* filename);
+static uint8_t read_budgets(const char* filename);
+static uint8_t write_budgets(const char* filename);
+static avr_t* load_firmware(const char* filename);
+static void connect_inputs(avr_t* avr);
+static uint8_t report(void);
+
+int main(int argc, char** argv) {
+	uint8_t update = 0;
+	uint32_t duration = DEFAULT_DURATION_MS;
+	int arg = 1;
+
+	while (arg < argc && argv[arg][0] == '-') {
+		if (strcmp(argv[arg], "--update") == 0) {
+			update = 1;
+		} else if (strcmp(argv[arg], "--duration") == 0 && arg + 1 < argc) {
+			duration = strtoul(argv[++arg], NULL, 10);
+		} else {
+			usage();
+			return 2;
+		}
+		arg++;
+	}
+	if (argc - arg != 3) {
+		usage();
+		return 2;
+	}
+	const char* elf_filename = argv[arg];
+	const char* input_filename = argv[arg + 1];
+	const char* budgets_filename = argv[arg + 2];
+
+	uint8_t have_budgets = strcmp(budgets_filename, "-") != 0;
+	if (!read_inputs(input_filename) ||
+			(have_budgets && !update && !read_budgets(budgets_filename))) {
+		return 2;
+	}
+	avr_t* avr = load_firmware(elf_filename);
+	if (!avr) {
+		return 2;
+	}
+	connect_inputs(avr);
+	avr_register_io_write(avr, GPIOR0_ADDRESS, gpior0_write, NULL);
+
+	// Run, sending each input once its time comes
+	avr_cycle_count_t end = (avr_cycle_count_t)duration * CYCLES_PER_MS;
+	avr_irq_t* uart_input = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+	uint32_t next_input = 0;
+	while (avr->cycle < end) {
+		while (next_input < num_inputs && avr->cycle >= inputs[next_input].cycle) {
+			avr_raise_irq(uart_input, inputs[next_input].byte);
+			next_input++;
+		}
+		int state = avr_run(avr);
+		if (state == cpu_Done || state == cpu_Crashed) {
+			fprintf(stderr, "simbench: firmware stopped after %llu cycles\n",
+					(unsigned long long)avr->cycle);
+			return 1;
+		}
+	}
+
+	printf("%u ms (%llu cycles) simulated, %u of %u inputs sent\n",
+			(unsigned)duration, (unsigned long long)avr->cycle,
+			(unsigned)next_input, (unsigned)num_inputs);
+	if (update && have_budgets) {
+		report();
+		return write_budgets(budgets_filename) ? 0 : 1;
+	}
+	return report() ? 0 : 1;
+}
+
+static void usage(void) {
+	fprintf(stderr, "usage: simbench [--update] [--duration ms] firmware.elf input budgets\n");
+}
+
+// Return the id of the marker with the given name, or 0 if there isn't one
+static uint8_t marker_id(const char* name) {
+	for (uint8_t id = 1; id < BENCH_NUM_MARKERS; id++) {
+		if (marker_names[id] && strcmp(marker_names[id], name) == 0) {
+			return id;
+		}
+	}
+	return 0;
+}
+
+/* MARKERS */
+// Called instead of the write to GPIOR0
+static void gpior0_write(avr_t* avr, avr_io_addr_t address, uint8_t value, void* param) {
+	(void)param;
+	avr->data[address] = value;
+
+	uint8_t id = value & ~BENCH_END_FLAG;
+	if (id == 0 || id >= BENCH_NUM_MARKERS) {
+		marker_errors++;
+	} else if (value & BENCH_END_FLAG) {
+		end_marker(id, avr->cycle);
+	} else if (depth == MAX_DEPTH) {
+		marker_errors++;
+	} else {
+		stack[depth].id = id;
+		stack[depth].start = avr->cycle;
+		depth++;
+	}
+}
+
+static void end_marker(uint8_t id, avr_cycle_count_t cycle) {
+	if (depth == 0 || stack[depth - 1].id != id) {
+		// Not nested properly - throw away what we have
+		marker_errors++;
+		depth = 0;
+		return;
+	}
+	depth--;
+	uint64_t cycles = cycle - stack[depth].start;
+	MarkerStats* stats = &markers[id];
+	if (stats->count == 0 || cycles < stats->min) {
+		stats->min = cycles;
+	}
+	if (cycles > stats->max) {
+		stats->max = cycles;
+	}
+	stats->total += cycles;
+	stats->count++;
+}
+
+/* FILES */
+static uint8_t read_inputs(const char* filename) {
+	char line[MAX_LINE];
+	FILE* file = fopen(filename, "r");
+	if (!file) {
+		perror(filename);
+		return 0;
+	}
+	while (fgets(line, sizeof(line), file)) {
+		char* text;
+		unsigned long time = strtoul(line, &text, 10);
+		if (line[0] == '#' || text == line) {
+			continue;
+		}
+		if (*text == ' ') {
+			text++;
+		}
+		for (; *text && *text != '\n'; text++) {
+			uint8_t byte = *text;
+			if (byte == '\\' && text[1]) {
+				text++;
+				switch (*text) {
+					case 'n': byte = '\n'; break;
+					case 'r': byte = '\r'; break;
+					case 'e': byte = 0x1B; break;
+					default: byte = *text; break;
+				}
+			}
+			if (num_inputs == MAX_INPUTS) {
+				fprintf(stderr, "%s: too many inputs\n", filename);
+				fclose(file);
+				return 0;
+			}
+			inputs[num_inputs].cycle = (avr_cycle_count_t)time * CYCLES_PER_MS;
+			inputs[num_inputs].byte = byte;
+			num_inputs++;
+		}
+	}
+	fclose(file);
+	return 1;
+}
+
+static uint8_t read_budgets(const char* filename) {
+	char line[MAX_LINE];
+	char name[MAX_LINE];
+	unsigned long long budget;
+	FILE* file = fopen(filename, "r");
+	if (!file) {
+		perror(filename);
+		return 0;
+	}
+	while (fgets(line, sizeof(line), file)) {
+		if (strncmp(line, "uncalibrated", 12) == 0) {
+			calibrated = 0;
+			continue;
+		}
+		if (line[0] == '#' || sscanf(line, "%255s %llu", name, &budget) != 2) {
+			continue;
+		}
+		uint8_t id = marker_id(name);
+		if (!id) {
+			fprintf(stderr, "%s: unknown marker %s\n", filename, name);
+			fclose(file);
+			return 0;
+		}
+		markers[id].budget = budget;
+	}
+	fclose(file);
+	return 1;
+}
+
+static uint8_t write_budgets(const char* filename) {
+	FILE* file = fopen(filename, "w");
+	if (!file) {
+		perror(filename);
+		return 0;
+	}
+	fprintf(file, "# Cycle budget (worst case) of each benchmark marker.\n");
+	fprintf(file, "# Written by 'make budgets': the max measured plus %d%%.\n",
+			BUDGET_HEADROOM);
+	for (uint8_t id = 1; id < BENCH_NUM_MARKERS; id++) {
+		if (markers[id].count) {
+			fprintf(file, "%s %llu\n", marker_names[id],
+					(unsigned long long)(markers[id].max * (100 + BUDGET_HEADROOM) / 100));
+		}
+	}
+	printf("Wrote %s\n", filename);
+	return fclose(file) == 0;
+}
+
+/* SIMULATOR */
+static avr_t* load_firmware(const char* filename) {
+	elf_firmware_t firmware;
+	avr_t* avr = NULL;
+
+	memset(&firmware, 0, sizeof(firmware));
+	if (elf_read_firmware(filename, &firmware) != 0) {
+		fprintf(stderr, "simbench: couldn't read %s\n", filename);
+		return NULL;
+	}
+	for (size_t i = 0; i < sizeof(mcu_names) / sizeof(mcu_names[0]) && !avr; i++) {
+		avr = avr_make_mcu_by_name(mcu_names[i]);
+	}
+	if (!avr) {
+		fprintf(stderr, "simbench: this simavr doesn't support the ATmega324\n");
+		return NULL;
+	}
+	avr_init(avr);
+	avr_load_firmware(avr, &firmware);
+	avr->frequency = CPU_FREQUENCY;
+	avr->vcc = SUPPLY_MV;
+	avr->avcc = SUPPLY_MV;
+	avr->aref = SUPPLY_MV;
+	return avr;
+}
+
+// Hold the joystick in the centre, turn the sound switch on and keep
+// the serial output off our stdout. The buttons (B0 to B3) are left
+// low, i.e. not pushed. SPI needs nothing: simavr completes each byte
+// after 8 SPI clocks whether or not anything is listening.
+static void connect_inputs(avr_t* avr) {
+	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC6), JOYSTICK_CENTRE_MV);
+	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC7), JOYSTICK_CENTRE_MV);
+	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 3), 1);
+
+	uint32_t flags = 0;
+	avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+	flags &= ~AVR_UART_FLAG_STDIO;
+	avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+}
+
+/* RESULTS */
+// Print the results and return 1 if everything is within budget (or
+// the budgets aren't calibrated yet)
+static uint8_t report(void) {
+	uint8_t passed = 1;
+
+	printf("%-22s %8s %10s %10s %10s %10s\n", "marker", "count", "min", "mean",
+			"max", "budget");
+	for (uint8_t id = 1; id < BENCH_NUM_MARKERS; id++) {
+		MarkerStats* stats = &markers[id];
+		if (!stats->count) {
+			if (stats->budget) {
+				printf("%-22s not reached (check the input script)\n", marker_names[id]);
+			}
+			continue;
+		}
+		printf("%-22s %8u %10llu %10llu %10llu", marker_names[id], (unsigned)stats->count,
+				(unsigned long long)stats->min,
+				(unsigned long long)(stats->total / stats->count),
+				(unsigned long long)stats->max);
+		if (stats->budget) {
+			printf(" %10llu", (unsigned long long)stats->budget);
+			if (stats->max > stats->budget) {
+				printf(calibrated ? "  OVER BUDGET" : "  OVER ESTIMATE");
+				passed = !calibrated && passed;
+			}
+		}
+		printf("\n");
+	}
+	if (marker_errors) {
+		printf("%u marker(s) out of order - check the BENCH_BEGIN/BENCH_END pairs\n",
+				(unsigned)marker_errors);
+		passed = 0;
+	}
+	if (!calibrated && passed) {
+		printf("Budgets not calibrated yet (run 'make budgets') - nothing checked\n");
+	} else {
+		printf(passed ? "All markers within budget\n" : "Benchmark FAILED\n");
+	}
+	return passed;
+}
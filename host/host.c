@@ -0,0 +1,64 @@
+/*
+ * host.c
+ *
+ * Author: Sean Manson
+ *
+ * Stand-ins for the microcontroller's registers and timer 0 in the
+ * host build.
+ */
+
+#include <avr/io.h>
+
+#include "host.h"
+#include "timer0.h"
+#include "sound.h"
+
+// avr-libc's RAND_MAX (the host's is usually larger)
+#define AVR_RAND_MAX 0x7FFF
+
+volatile uint8_t SREG;
+
+static uint32_t clock_ticks;
+static uint32_t rand_state = 1;
+
+void host_reset_clock(void) {
+	clock_ticks = 0;
+}
+
+void host_advance_clock(uint32_t ms) {
+	clock_ticks += ms;
+}
+
+uint32_t get_clock_ticks(void) {
+	return clock_ticks;
+}
+
+uint32_t get_clock_micros(void) {
+	return clock_ticks * 1000;
+}
+
+// The "minimal standard" generator used by avr-libc
+int host_rand(void) {
+	int32_t hi, lo, x;
+
+	x = rand_state;
+	if (x == 0) {
+		x = 123459876L;
+	}
+	hi = x / 127773L;
+	lo = x % 127773L;
+	x = 16807L * lo - 2836L * hi;
+	if (x < 0) {
+		x += 0x7FFFFFFFL;
+	}
+	rand_state = x;
+	return x % (AVR_RAND_MAX + 1UL);
+}
+
+void host_srand(unsigned int seed) {
+	rand_state = (uint16_t)seed;
+}
+
+// Sound isn't emulated
+void play_quiet_sound(uint16_t frequency, uint8_t time) {
+}
@@ -0,0 +1,39 @@
+/*
+ * host.h
+ *
+ * Author: Sean Manson
+ *
+ * Support for building and testing parts of the game on a PC (the
+ * "host") rather than on the microcontroller.
+ *
+ * The modules in ../src which only deal with the game and the display
+ * are compiled as they are, against the stand-in AVR headers in
+ * include/. The hardware they would talk to is replaced:
+ *    - the LED matrix (and SPI) by the emulator in matrix_emulator.h
+ *    - timer 0 by a clock which only moves when host_advance_clock()
+ *      is called, so tests run the same every time
+ *    - the buzzer by nothing (sounds are ignored)
+ * rand() and srand() are replaced (by the Makefile) with host_rand()
+ * and host_srand(), which work the same way as avr-libc's, so a game
+ * with a given seed plays out the same as on the microcontroller.
+ */
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdint.h>
+
+/* Set the clock (as returned by get_clock_ticks()) back to 0.
+ */
+void host_reset_clock(void);
+
+/* Move the clock on by the given number of milliseconds.
+ */
+void host_advance_clock(uint32_t ms);
+
+/* avr-libc's rand() and srand().
+ */
+int host_rand(void);
+void host_srand(unsigned int seed);
+
+#endif /* HOST_H_ */
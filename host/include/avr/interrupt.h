@@ -0,0 +1,19 @@
+/*
+ * interrupt.h
+ *
+ * Host build stand-in for <avr/interrupt.h>. There are no interrupts
+ * on the host, so handlers are ordinary functions which the tests can
+ * call themselves.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+
+#define sei() (SREG |= _BV(SREG_I))
+#define cli() (SREG &= ~_BV(SREG_I))
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
@@ -0,0 +1,22 @@
+/*
+ * io.h
+ *
+ * Host build stand-in for <avr/io.h>. Only what the modules built on
+ * the host need is defined here; registers are plain variables (see
+ * host.c) so that code which writes to them still links.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+
+#define SREG_I 7
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+
+#endif /* HOST_AVR_IO_H_ */
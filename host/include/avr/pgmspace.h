@@ -0,0 +1,29 @@
+/*
+ * pgmspace.h
+ *
+ * Host build stand-in for <avr/pgmspace.h>. Program memory is just
+ * ordinary (read only) memory on the host. pgm_read_word() reads the
+ * element's own type, as pointer tables in program memory are read
+ * with it and pointers are wider than 16 bits on the host.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char*
+
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(address))
+
+#define printf_P printf
+#define snprintf_P snprintf
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
@@ -0,0 +1,14 @@
+/*
+ * delay.h
+ *
+ * Host build stand-in for <util/delay.h>. Delays do nothing on the
+ * host.
+ */
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+#define _delay_ms(ms) ((void)(ms))
+#define _delay_us(us) ((void)(us))
+
+#endif /* HOST_UTIL_DELAY_H_ */
@@ -0,0 +1,321 @@
+/*
+ * matrix_emulator.c
+ *
+ * Author: Sean Manson
+ *
+ * Host-side emulator of the LED matrix controller. Also provides the
+ * SPI functions for the host build. When the display is made up of more
+ * than one panel, each has its own controller, and bytes go to the one
+ * selected with spi_select_slave().
+ */
+
+#include <string.h>
+
+#include "matrix_emulator.h"
+#include "spi.h"
+
+// Number of bytes which follow each command
+#define UPDATE_ALL_LENGTH (PANEL_NUM_COLUMNS * PANEL_NUM_ROWS)
+#define UPDATE_PIXEL_LENGTH 2
+#define UPDATE_ROW_LENGTH (1 + PANEL_NUM_COLUMNS)
+#define UPDATE_COL_LENGTH (1 + PANEL_NUM_ROWS)
+#define SHIFT_DISPLAY_LENGTH 1
+
+// Directions (bits) in the shift command's argument
+#define SHIFT_RIGHT 0x01
+#define SHIFT_LEFT 0x02
+#define SHIFT_DOWN 0x04
+#define SHIFT_UP 0x08
+
+// One panel's controller: what is on its display, the command being
+// received (or -1 if waiting for a command), its argument bytes so far
+// and how many more are expected
+typedef struct {
+	PanelData display;
+	int16_t command;
+	uint8_t arguments[UPDATE_ALL_LENGTH];
+	uint8_t num_arguments;
+	uint8_t arguments_left;
+} Panel;
+
+static Panel panels[MATRIX_NUM_PANELS];
+
+// The panel receiving bytes
+static Panel* selected;
+
+// Counts for this frame and since the last reset
+static EmulatorStats frame_stats;
+static EmulatorStats total_stats;
+
+static void start_command(Panel* panel, uint8_t byte);
+static void finish_command(Panel* panel);
+static void shift_display(Panel* panel, uint8_t directions);
+static void count_command(uint8_t index);
+
+void emulator_reset(void) {
+	for (uint8_t i = 0; i < MATRIX_NUM_PANELS; i++) {
+		memset(panels[i].display, 0, sizeof(panels[i].display));
+		panels[i].command = -1;
+		panels[i].num_arguments = 0;
+		panels[i].arguments_left = 0;
+	}
+	selected = &panels[0];
+	memset(&frame_stats, 0, sizeof(frame_stats));
+	memset(&total_stats, 0, sizeof(total_stats));
+}
+
+void emulator_receive_byte(uint8_t byte) {
+	Panel* panel = selected;
+
+	frame_stats.bytes++;
+	total_stats.bytes++;
+	if (panel->command < 0) {
+		start_command(panel, byte);
+	} else {
+		panel->arguments[panel->num_arguments++] = byte;
+		panel->arguments_left--;
+	}
+	if (panel->command >= 0 && panel->arguments_left == 0) {
+		finish_command(panel);
+	}
+}
+
+PixelColour emulator_get_pixel(uint8_t x, uint8_t y) {
+	x %= MATRIX_NUM_COLUMNS;
+	y %= MATRIX_NUM_ROWS;
+	return panels[(y / PANEL_NUM_ROWS) * MATRIX_PANELS_ACROSS + x / PANEL_NUM_COLUMNS]
+			.display[x % PANEL_NUM_COLUMNS][y % PANEL_NUM_ROWS];
+}
+
+void emulator_get_frame(MatrixData frame) {
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+			frame[x][y] = emulator_get_pixel(x, y);
+		}
+	}
+}
+
+uint8_t emulator_is_mid_command(void) {
+	for (uint8_t i = 0; i < MATRIX_NUM_PANELS; i++) {
+		if (panels[i].command >= 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void emulator_end_frame(EmulatorStats* stats) {
+	*stats = frame_stats;
+	memset(&frame_stats, 0, sizeof(frame_stats));
+}
+
+void emulator_get_totals(EmulatorStats* stats) {
+	*stats = total_stats;
+}
+
+uint32_t emulator_count_commands(const EmulatorStats* stats) {
+	uint32_t count = 0;
+	for (uint8_t i = 0; i < EMULATOR_NUM_COMMANDS; i++) {
+		count += stats->commands[i];
+	}
+	return count;
+}
+
+void emulator_write_ascii(FILE* file) {
+	for (int8_t y = MATRIX_NUM_ROWS - 1; y >= 0; y--) {
+		for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+			PixelColour pixel = emulator_get_pixel(x, y);
+			uint8_t red = pixel & 0x0F;
+			uint8_t green = pixel >> 4;
+			char c;
+			if (pixel == 0) {
+				c = '.';
+			} else if (green == 0) {
+				c = 'R';
+			} else if (red == 0) {
+				c = 'G';
+			} else if (red == green) {
+				c = 'Y';
+			} else if (red > green) {
+				c = 'O';
+			} else {
+				c = 'L';
+			}
+			// Dim pixels are shown in lower case
+			if (pixel != 0 && red < 8 && green < 8) {
+				c += 'a' - 'A';
+			}
+			fputc(c, file);
+		}
+		fputc('\n', file);
+	}
+}
+
+uint8_t emulator_write_ppm(const char* filename, uint8_t scale) {
+	FILE* file = fopen(filename, "wb");
+	if (!file) {
+		return 0;
+	}
+	fprintf(file, "P6\n%d %d\n255\n", MATRIX_NUM_COLUMNS * scale,
+			MATRIX_NUM_ROWS * scale);
+	for (int8_t y = MATRIX_NUM_ROWS - 1; y >= 0; y--) {
+		for (uint8_t row = 0; row < scale; row++) {
+			for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+				PixelColour pixel = emulator_get_pixel(x, y);
+				// Each 4 bit level becomes an 8 bit level (0xF * 17 = 0xFF)
+				uint8_t rgb[3] = {(pixel & 0x0F) * 17, (pixel >> 4) * 17, 0};
+				for (uint8_t column = 0; column < scale; column++) {
+					fwrite(rgb, 1, 3, file);
+				}
+			}
+		}
+	}
+	return fclose(file) == 0;
+}
+
+
+/* SPI functions for the host build. Bytes go straight to the emulator
+ * and nothing comes back, like the real display.
+ */
+void spi_setup_master(uint8_t clockdivider) {
+	(void)clockdivider;
+}
+
+uint8_t spi_send_byte(uint8_t byte) {
+	emulator_receive_byte(byte);
+	return 0;
+}
+
+void spi_setup_slave_selects(uint8_t num_slaves) {
+	(void)num_slaves;
+}
+
+void spi_select_slave(uint8_t slave) {
+	// A controller part way through a command would lose its place on
+	// the real display, so the emulator treats this as an error
+	if (selected->command >= 0) {
+		frame_stats.errors++;
+		total_stats.errors++;
+	}
+	if (slave < MATRIX_NUM_PANELS) {
+		selected = &panels[slave];
+	}
+}
+
+
+/* HELPER FUNCTIONS */
+// Begin decoding a new command
+static void start_command(Panel* panel, uint8_t byte) {
+	panel->command = byte;
+	panel->num_arguments = 0;
+	switch (byte) {
+		case EMULATOR_CMD_UPDATE_ALL:
+			panel->arguments_left = UPDATE_ALL_LENGTH;
+			break;
+		case EMULATOR_CMD_UPDATE_PIXEL:
+			panel->arguments_left = UPDATE_PIXEL_LENGTH;
+			break;
+		case EMULATOR_CMD_UPDATE_ROW:
+			panel->arguments_left = UPDATE_ROW_LENGTH;
+			break;
+		case EMULATOR_CMD_UPDATE_COL:
+			panel->arguments_left = UPDATE_COL_LENGTH;
+			break;
+		case EMULATOR_CMD_SHIFT_DISPLAY:
+			panel->arguments_left = SHIFT_DISPLAY_LENGTH;
+			break;
+		case EMULATOR_CMD_CLEAR_SCREEN:
+			panel->arguments_left = 0;
+			break;
+		default:
+			// Not a command - the controller ignores it
+			frame_stats.errors++;
+			total_stats.errors++;
+			panel->command = -1;
+			break;
+	}
+}
+
+// Carry out the command once all of its bytes have been received
+static void finish_command(Panel* panel) {
+	uint8_t* arguments = panel->arguments;
+	uint8_t x, y;
+
+	switch (panel->command) {
+		case EMULATOR_CMD_UPDATE_ALL:
+			// Sent a row at a time, from the bottom row
+			for (y = 0; y < PANEL_NUM_ROWS; y++) {
+				for (x = 0; x < PANEL_NUM_COLUMNS; x++) {
+					panel->display[x][y] = arguments[y * PANEL_NUM_COLUMNS + x];
+				}
+			}
+			count_command(EMULATOR_UPDATE_ALL);
+			break;
+		case EMULATOR_CMD_UPDATE_PIXEL:
+			panel->display[arguments[0] & 0x0F][(arguments[0] >> 4) & 0x07] = arguments[1];
+			count_command(EMULATOR_UPDATE_PIXEL);
+			break;
+		case EMULATOR_CMD_UPDATE_ROW:
+			for (x = 0; x < PANEL_NUM_COLUMNS; x++) {
+				panel->display[x][arguments[0] & 0x07] = arguments[1 + x];
+			}
+			count_command(EMULATOR_UPDATE_ROW);
+			break;
+		case EMULATOR_CMD_UPDATE_COL:
+			for (y = 0; y < PANEL_NUM_ROWS; y++) {
+				panel->display[arguments[0] & 0x0F][y] = arguments[1 + y];
+			}
+			count_command(EMULATOR_UPDATE_COL);
+			break;
+		case EMULATOR_CMD_SHIFT_DISPLAY:
+			shift_display(panel, arguments[0]);
+			count_command(EMULATOR_SHIFT_DISPLAY);
+			break;
+		case EMULATOR_CMD_CLEAR_SCREEN:
+			memset(panel->display, 0, sizeof(panel->display));
+			count_command(EMULATOR_CLEAR_SCREEN);
+			break;
+	}
+	panel->command = -1;
+}
+
+// Shift a panel's display one pixel in each of the given directions.
+// Pixels shifted in from the edge are blank.
+static void shift_display(Panel* panel, uint8_t directions) {
+	PixelColour (*display)[PANEL_NUM_ROWS] = panel->display;
+	uint8_t x, y;
+
+	if (directions & SHIFT_RIGHT) {
+		for (x = PANEL_NUM_COLUMNS - 1; x > 0; x--) {
+			memcpy(display[x], display[x - 1], PANEL_NUM_ROWS);
+		}
+		memset(display[0], 0, PANEL_NUM_ROWS);
+	}
+	if (directions & SHIFT_LEFT) {
+		for (x = 0; x < PANEL_NUM_COLUMNS - 1; x++) {
+			memcpy(display[x], display[x + 1], PANEL_NUM_ROWS);
+		}
+		memset(display[PANEL_NUM_COLUMNS - 1], 0, PANEL_NUM_ROWS);
+	}
+	if (directions & SHIFT_DOWN) {
+		for (x = 0; x < PANEL_NUM_COLUMNS; x++) {
+			for (y = 0; y < PANEL_NUM_ROWS - 1; y++) {
+				display[x][y] = display[x][y + 1];
+			}
+			display[x][PANEL_NUM_ROWS - 1] = 0;
+		}
+	}
+	if (directions & SHIFT_UP) {
+		for (x = 0; x < PANEL_NUM_COLUMNS; x++) {
+			for (y = PANEL_NUM_ROWS - 1; y > 0; y--) {
+				display[x][y] = display[x][y - 1];
+			}
+			display[x][0] = 0;
+		}
+	}
+}
+
+static void count_command(uint8_t index) {
+	frame_stats.commands[index]++;
+	total_stats.commands[index]++;
+}
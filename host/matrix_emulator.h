@@ -0,0 +1,102 @@
+/*
+ * matrix_emulator.h
+ *
+ * Author: Sean Manson
+ *
+ * Host-side emulator of the LED matrix controller.
+ *
+ * In the host build this takes the place of spi.c: every byte that
+ * ledmatrix.c sends with spi_send_byte() is decoded here, just as the
+ * controller on the LED matrix board would, into a 16x8 frame of
+ * pixel colours. If the display is made up of several panels (see
+ * ledmatrix.h) each panel's controller is emulated, and the functions
+ * below work on the whole display. Each command and byte is counted, so
+ * the tests can check both what is on the display and how much SPI
+ * traffic it took to get it there. Selecting another panel part way
+ * through a command counts as an error.
+ *
+ * The counts are kept for the current "frame" (whatever the test
+ * decides that is - e.g. one game tick) and in total since the last
+ * reset. emulator_end_frame() returns the current frame's counts and
+ * starts a new frame.
+ */
+
+#ifndef MATRIX_EMULATOR_H_
+#define MATRIX_EMULATOR_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ledmatrix.h"
+
+// The controller's commands, as sent by ledmatrix.c
+#define EMULATOR_CMD_UPDATE_ALL 0x00
+#define EMULATOR_CMD_UPDATE_PIXEL 0x01
+#define EMULATOR_CMD_UPDATE_ROW 0x02
+#define EMULATOR_CMD_UPDATE_COL 0x03
+#define EMULATOR_CMD_SHIFT_DISPLAY 0x04
+#define EMULATOR_CMD_CLEAR_SCREEN 0x0F
+
+// Index of each command in EmulatorStats.commands
+#define EMULATOR_UPDATE_ALL 0
+#define EMULATOR_UPDATE_PIXEL 1
+#define EMULATOR_UPDATE_ROW 2
+#define EMULATOR_UPDATE_COL 3
+#define EMULATOR_SHIFT_DISPLAY 4
+#define EMULATOR_CLEAR_SCREEN 5
+#define EMULATOR_NUM_COMMANDS 6
+
+// SPI traffic counts. bytes includes the command bytes. errors counts
+// bytes which weren't a valid command.
+typedef struct {
+	uint32_t bytes;
+	uint32_t commands[EMULATOR_NUM_COMMANDS];
+	uint32_t errors;
+} EmulatorStats;
+
+/* Clear the display and all of the counts.
+ */
+void emulator_reset(void);
+
+/* Decode one byte sent to the controller. (spi_send_byte() calls this.)
+ */
+void emulator_receive_byte(uint8_t byte);
+
+/* Return the colour of the pixel at (x, y).
+ */
+PixelColour emulator_get_pixel(uint8_t x, uint8_t y);
+
+/* Copy the whole display into frame.
+ */
+void emulator_get_frame(MatrixData frame);
+
+/* Return whether any controller is part way through a command.
+ */
+uint8_t emulator_is_mid_command(void);
+
+/* Copy the counts for the current frame into stats and start a new
+ * frame.
+ */
+void emulator_end_frame(EmulatorStats* stats);
+
+/* Copy the counts since the last reset into stats.
+ */
+void emulator_get_totals(EmulatorStats* stats);
+
+/* Return the number of commands in stats.
+ */
+uint32_t emulator_count_commands(const EmulatorStats* stats);
+
+/* Write the display as text, one line per row from the top down. Each pixel is a character: '.' for off, 'R', 'G', 'Y', 'O'
+ * for the standard colours and 'r', 'g', 'y', 'o' for dimmer pixels
+ * of the same hue.
+ */
+void emulator_write_ascii(FILE* file);
+
+/* Write the display as a binary (P6) PPM image, with each pixel drawn
+ * as a scale x scale square. Returns 1 if successful, 0 if the file
+ * couldn't be written.
+ */
+uint8_t emulator_write_ppm(const char* filename, uint8_t scale);
+
+#endif /* MATRIX_EMULATOR_H_ */
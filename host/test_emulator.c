@@ -0,0 +1,194 @@
+/*
+ * test_emulator.c
+ *
+ * Author: Sean Manson
+ *
+ * Checks that the matrix emulator decodes what ledmatrix.c sends, and
+ * reports the SPI traffic of the scrolling display and animations.
+ * If given a directory, the last frame of each is also written there
+ * as a PPM image.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host.h"
+#include "timer0.h"
+#include "matrix_emulator.h"
+#include "ledmatrix.h"
+#include "scrolling_char_display.h"
+#include "animation.h"
+
+static int failures;
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static void check(int passed, const char* condition, int line) {
+	if (!passed) {
+		printf("FAIL line %d: %s\n", line, condition);
+		failures++;
+	}
+}
+
+static void write_image(const char* directory, const char* name) {
+	char filename[256];
+	if (!directory) {
+		return;
+	}
+	snprintf(filename, sizeof(filename), "%s/%s.ppm", directory, name);
+	CHECK(emulator_write_ppm(filename, 8));
+}
+
+// Each of the ledmatrix.c commands changes the right pixels and sends
+// the right number of bytes
+static void test_commands(void) {
+	EmulatorStats stats;
+	MatrixRow row;
+	MatrixColumn col;
+	MatrixData data;
+	uint8_t x, y;
+
+	emulator_reset();
+	ledmatrix_update_pixel(3, 5, COLOUR_RED);
+	emulator_end_frame(&stats);
+	CHECK(emulator_get_pixel(3, 5) == COLOUR_RED);
+	CHECK(stats.bytes == 3);
+	CHECK(stats.commands[EMULATOR_UPDATE_PIXEL] == 1);
+
+	for (x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		row[x] = x;
+	}
+	ledmatrix_update_row(2, row);
+	emulator_end_frame(&stats);
+	CHECK(emulator_get_pixel(0, 2) == 0 && emulator_get_pixel(15, 2) == 15);
+	CHECK(stats.bytes == 18);
+
+	for (y = 0; y < MATRIX_NUM_ROWS; y++) {
+		col[y] = COLOUR_GREEN;
+	}
+	ledmatrix_update_column(9, col);
+	ledmatrix_update_column_mask(10, 0x81, COLOUR_ORANGE);
+	emulator_end_frame(&stats);
+	CHECK(emulator_get_pixel(9, 0) == COLOUR_GREEN && emulator_get_pixel(9, 7) == COLOUR_GREEN);
+	CHECK(emulator_get_pixel(10, 0) == COLOUR_ORANGE && emulator_get_pixel(10, 7) == COLOUR_ORANGE);
+	CHECK(emulator_get_pixel(10, 3) == 0);
+	CHECK(stats.bytes == 20 && stats.commands[EMULATOR_UPDATE_COL] == 2);
+
+	ledmatrix_shift_display_left();
+	CHECK(emulator_get_pixel(8, 0) == COLOUR_GREEN && emulator_get_pixel(15, 2) == 0);
+	ledmatrix_shift_display_right();
+	CHECK(emulator_get_pixel(9, 0) == COLOUR_GREEN && emulator_get_pixel(0, 2) == 0);
+	ledmatrix_shift_display_up();
+	CHECK(emulator_get_pixel(3, 6) == COLOUR_RED && emulator_get_pixel(9, 0) == 0);
+	ledmatrix_shift_display_down();
+	CHECK(emulator_get_pixel(3, 5) == COLOUR_RED && emulator_get_pixel(9, 7) == 0);
+	emulator_end_frame(&stats);
+	CHECK(stats.bytes == 8 && stats.commands[EMULATOR_SHIFT_DISPLAY] == 4);
+
+	for (x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		for (y = 0; y < MATRIX_NUM_ROWS; y++) {
+			data[x][y] = x + 16 * y;
+		}
+	}
+	ledmatrix_update_all(data);
+	emulator_end_frame(&stats);
+	CHECK(emulator_get_pixel(4, 0) == 4 && emulator_get_pixel(15, 7) == 127);
+	CHECK(stats.bytes == 129);
+
+	ledmatrix_clear();
+	emulator_end_frame(&stats);
+	CHECK(emulator_get_pixel(15, 7) == 0);
+	CHECK(stats.bytes == 1);
+
+	CHECK(!emulator_is_mid_command());
+	emulator_get_totals(&stats);
+	CHECK(stats.errors == 0);
+	CHECK(emulator_count_commands(&stats) == 10);
+}
+
+// Each scroll step of the scrolling display is one shift and one column
+static void test_scrolling(const char* directory) {
+	EmulatorStats stats;
+	uint32_t steps = 0, max_bytes = 0;
+
+	emulator_reset();
+	host_reset_clock();
+	init_scrolling_display();
+	set_text_colour(COLOUR_GREEN);
+	set_scroll_speed(10);
+	set_scrolling_display_text("Frogger 1.0!");
+	while (update_scrolling_display()) {
+		emulator_end_frame(&stats);
+		if (stats.bytes) {
+			steps++;
+			if (stats.bytes > max_bytes) {
+				max_bytes = stats.bytes;
+			}
+		}
+		if (steps == 20) {
+			write_image(directory, "scroll");
+		}
+		host_advance_clock(1);
+	}
+	emulator_end_frame(&stats);
+	emulator_get_totals(&stats);
+	printf("scrolling: %u steps, %u bytes, at most %u bytes a step, %u ms\n",
+			(unsigned)steps, (unsigned)stats.bytes, (unsigned)max_bytes,
+			(unsigned)get_clock_ticks());
+	CHECK(max_bytes == 12);
+	CHECK(stats.commands[EMULATOR_UPDATE_COL] == steps);
+	CHECK(stats.commands[EMULATOR_SHIFT_DISPLAY] == steps);
+	// The speed is 10 pixels per second
+	CHECK(get_clock_ticks() >= (steps - 1) * 100U && get_clock_ticks() <= steps * 100U);
+
+	CHECK(display_static_text("42"));
+	emulator_write_ascii(stdout);
+	write_image(directory, "static");
+	CHECK(emulator_get_pixel(6, 1) == COLOUR_GREEN);
+	// Four digits fit, but five don't and leave the display alone
+	emulator_end_frame(&stats);
+	CHECK(display_static_text("9999"));
+	CHECK(!display_static_text("12345"));
+	emulator_end_frame(&stats);
+	CHECK(stats.bytes > 0);
+	CHECK(!display_static_text("12345"));
+	emulator_end_frame(&stats);
+	CHECK(stats.bytes == 0);
+}
+
+// Animations play through without sending anything invalid
+static void test_animations(const char* directory) {
+	EmulatorStats stats;
+
+	emulator_reset();
+	host_reset_clock();
+	play_animation_level_complete();
+	while (update_animation()) {
+		host_advance_clock(1);
+	}
+	emulator_get_totals(&stats);
+	printf("level complete animation: %u bytes, %u commands, %u ms\n",
+			(unsigned)stats.bytes, (unsigned)emulator_count_commands(&stats),
+			(unsigned)get_clock_ticks());
+	emulator_write_ascii(stdout);
+	write_image(directory, "level_complete");
+	CHECK(stats.errors == 0);
+	CHECK(get_animation_overruns() == 0);
+	CHECK(emulator_get_pixel(0, 0) == COLOUR_YELLOW);
+	CHECK(emulator_get_pixel(5, 5) == COLOUR_GREEN);
+}
+
+int main(int argc, char** argv) {
+	const char* directory = argc > 1 ? argv[1] : NULL;
+
+	test_commands();
+	test_scrolling(directory);
+	test_animations(directory);
+
+	if (failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("All emulator checks passed\n");
+	return 0;
+}
@@ -0,0 +1,529 @@
+/*
+ * test_game.c
+ *
+ * Author: Sean Manson
+ *
+ * Golden-frame tests for the game's display output.
+ *
+ * Each scenario drives game.c through a scripted game (scrolling the
+ * lanes, moving the frog, etc.) with the LED matrix emulator in place
+ * of the display. The frames it takes snapshots of, and the SPI
+ * traffic it needed, are compared against the golden file for the
+ * scenario in golden/. A scenario fails if any frame is different, or
+ * if it sent more bytes or commands than the golden file says (a
+ * bandwidth regression). If it sent fewer, it passes with a note, so
+ * the golden files can be updated to lock in the improvement.
+ *
+ * Usage: test_game [--update] [golden directory]
+ * With --update, the golden files are rewritten from the results.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "matrix_emulator.h"
+#include "game.h"
+#include "patterns.h"
+
+// Colours used by game.c (for the player to recognise)
+#define COLOUR_EDGES 0x12
+#define COLOUR_LOGS 0x3C
+
+// Directions of each lane and log channel, as play_level() scrolls
+// them on the first level
+static const int8_t lane_directions[3] = {1, -1, 1};
+static const int8_t log_directions[2] = {-1, 1};
+
+// Results of a scenario: the snapshots taken (as text) and the traffic
+#define MAX_FRAMES_TEXT 8192
+typedef struct {
+	char frames[MAX_FRAMES_TEXT];
+	size_t frames_length;
+	uint32_t num_frames;
+	uint32_t ticks;
+	uint32_t max_tick_bytes;
+	EmulatorStats totals;
+} Result;
+
+static Result result;
+
+/* SCENARIO HELPERS */
+// Take a snapshot of the display. Each row (from the top) is written
+// as the hex colour of each pixel.
+static void snapshot(const char* label) {
+	char* text = result.frames + result.frames_length;
+	size_t left = MAX_FRAMES_TEXT - result.frames_length;
+	int n = snprintf(text, left, "frame %s\n", label);
+
+	for (int8_t y = MATRIX_NUM_ROWS - 1; y >= 0; y--) {
+		n += snprintf(text + n, left - n, "%d:", y);
+		for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+			n += snprintf(text + n, left - n, " %02x", emulator_get_pixel(x, y));
+		}
+		n += snprintf(text + n, left - n, "\n");
+	}
+	result.frames_length += n;
+	result.num_frames++;
+}
+
+// Finish a tick, noting the traffic sent during it
+static void end_tick(void) {
+	EmulatorStats stats;
+	emulator_end_frame(&stats);
+	if (stats.bytes > result.max_tick_bytes) {
+		result.max_tick_bytes = stats.bytes;
+	}
+	result.ticks++;
+}
+
+// Start a new game with the given seed and number of frogs, and put
+// the frogs out
+static void start_game(unsigned int seed, uint8_t frogs) {
+	srand(seed);
+	emulator_reset();
+	memset(&result, 0, sizeof(result));
+	set_number_of_frogs(frogs);
+	init_game();
+	for (uint8_t frog = 0; frog < frogs; frog++) {
+		put_frog_at_start(frog);
+	}
+	end_tick();
+}
+
+// Scroll every lane and log channel once
+static void scroll_all(void) {
+	for (uint8_t lane = 0; lane < 3; lane++) {
+		scroll_lane(lane, lane_directions[lane]);
+	}
+	for (uint8_t channel = 0; channel < 2; channel++) {
+		scroll_log_channel(channel, log_directions[channel]);
+	}
+}
+
+// Put a new frog out, as play_level() does after each frog
+static void next_frog(uint8_t frog) {
+	remove_dead_frogs();
+	put_frog_at_start(frog);
+}
+
+// Whether the frog could be at (column, row) after the next scroll,
+// judging by what is on the display
+static uint8_t is_safe(int8_t column, int8_t row) {
+	if (column < 0 || column >= MATRIX_NUM_COLUMNS) {
+		return 0;
+	}
+	switch (row) {
+		case 0:
+		case 4:
+			return 1;
+		case 1:
+		case 2:
+		case 3: {
+			// Clear now, and after the traffic moves along
+			int8_t before = column - lane_directions[row - 1];
+			return emulator_get_pixel(column, row) == 0 &&
+					(before < 0 || before >= MATRIX_NUM_COLUMNS ||
+					emulator_get_pixel(before, row) == 0);
+		}
+		case 5:
+		case 6: {
+			// On a log which won't take us off the edge
+			int8_t after = column + log_directions[row - 5];
+			return emulator_get_pixel(column, row) == COLOUR_LOGS &&
+					after >= 0 && after < MATRIX_NUM_COLUMNS;
+		}
+		case 7:
+			return emulator_get_pixel(column, row) == 0;
+	}
+	return 0;
+}
+
+// Make one careful move of the given frog towards the riverbank, if
+// there is one
+static void play_move(uint8_t frog) {
+	int8_t row = get_frog_row(frog);
+	int8_t column = get_frog_column(frog);
+
+	if (is_safe(column, row + 1)) {
+		move_frog_forward(frog);
+	} else if (is_safe(column - 1, row + 1)) {
+		move_frog_forward_left(frog);
+	} else if (is_safe(column + 1, row + 1)) {
+		move_frog_forward_right(frog);
+	} else if (!is_safe(column, row)) {
+		// Staying put isn't safe - dodge sideways or back
+		if (is_safe(column - 1, row)) {
+			move_frog_left(frog);
+		} else if (is_safe(column + 1, row)) {
+			move_frog_right(frog);
+		} else if (row > 0 && is_safe(column, row - 1)) {
+			move_frog_backward(frog);
+		}
+	}
+}
+
+/* SCENARIOS */
+// The game as it starts
+static void scenario_start(void) {
+	start_game(1, 1);
+	snapshot("start");
+}
+
+// Traffic and logs scrolling with the frog waiting at the start
+static void scenario_scroll(void) {
+	start_game(2, 1);
+	for (uint8_t tick = 1; tick <= 40; tick++) {
+		scroll_all();
+		end_tick();
+		if (tick % 10 == 0) {
+			char label[16];
+			snprintf(label, sizeof(label), "tick %d", tick);
+			snapshot(label);
+		}
+	}
+}
+
+// The frog moving in each direction along the roadside and into the
+// first lane
+static void scenario_move_frog(void) {
+	start_game(3, 1);
+	move_frog_right(0);
+	end_tick();
+	move_frog_left(0);
+	end_tick();
+	move_frog_left(0);
+	end_tick();
+	snapshot("moved along roadside");
+	move_frog_backward_left(0);
+	end_tick();
+	move_frog_forward(0);
+	end_tick();
+	snapshot("moved forward");
+	move_frog_backward(0);
+	end_tick();
+	snapshot("moved back");
+}
+
+// The frog gets to the river, rides a log to the edge and dies
+static void scenario_log_edge(void) {
+	uint16_t tick;
+
+	start_game(4, 1);
+	for (tick = 0; tick < 200 && get_frog_row(0) < 5; tick++) {
+		if (!is_frog_alive(0)) {
+			next_frog(0);
+		}
+		play_move(0);
+		scroll_all();
+		end_tick();
+	}
+	if (get_frog_row(0) != 5 || !is_frog_alive(0)) {
+		printf("log_edge: the frog didn't get onto a log\n");
+		result.frames_length = 0;
+		return;
+	}
+	snapshot("on log");
+	while (is_frog_alive(0) && tick++ < 200) {
+		scroll_all();
+		end_tick();
+	}
+	snapshot("hit edge");
+}
+
+// Frogs are played across until the riverbank is full
+static void scenario_fill_riverbank(void) {
+	uint16_t frogs = 0;
+
+	start_game(5, 1);
+	for (uint16_t tick = 0; tick < 3000 && !is_riverbank_full(); tick++) {
+		if (!is_frog_alive(0) || frog_has_reached_riverbank(0)) {
+			frogs++;
+			next_frog(0);
+			end_tick();
+		}
+		play_move(0);
+		scroll_all();
+		end_tick();
+	}
+	printf("fill_riverbank: %u frogs\n", frogs);
+	if (!is_riverbank_full()) {
+		printf("fill_riverbank: the riverbank wasn't filled\n");
+		result.frames_length = 0;
+		return;
+	}
+	snapshot("riverbank full");
+}
+
+// Two frogs are played across at once until the riverbank is full
+static void scenario_two_frogs(void) {
+	uint16_t frogs = 0;
+
+	start_game(6, 2);
+	for (uint16_t tick = 0; tick < 3000 && !is_riverbank_full(); tick++) {
+		for (uint8_t frog = 0; frog < 2; frog++) {
+			if (!is_frog_alive(frog) || frog_has_reached_riverbank(frog)) {
+				frogs++;
+				next_frog(frog);
+				end_tick();
+			}
+		}
+		for (uint8_t frog = 0; frog < 2; frog++) {
+			play_move(frog);
+		}
+		scroll_all();
+		end_tick();
+		if (tick == 20) {
+			snapshot("tick 20");
+		}
+	}
+	printf("two_frogs: %u frogs\n", frogs);
+	if (!is_riverbank_full()) {
+		printf("two_frogs: the riverbank wasn't filled\n");
+		result.frames_length = 0;
+		return;
+	}
+	snapshot("riverbank full");
+}
+
+// Check a generated pattern: runs of 1s from min_run long, separated by
+// gaps from min_gap to max_gap wide (all the way round). Returns 0 and
+// prints why if not.
+static int check_pattern(const char* what, uint32_t pattern,
+		uint8_t min_run, uint8_t min_gap, uint8_t max_gap) {
+	uint8_t start, i, length;
+
+	// Start at the beginning of a run
+	for (start = 0; start < PATTERN_WIDTH; start++) {
+		if ((pattern >> start & 1) && !(pattern >> ((start + PATTERN_WIDTH - 1) % PATTERN_WIDTH) & 1)) {
+			break;
+		}
+	}
+	if (start == PATTERN_WIDTH) {
+		printf("generated: %s %08x has no gaps or no runs\n", what, (unsigned)pattern);
+		return 0;
+	}
+	for (i = 0; i < PATTERN_WIDTH; i += length) {
+		uint8_t bit = pattern >> ((start + i) % PATTERN_WIDTH) & 1;
+		for (length = 0; i + length < PATTERN_WIDTH &&
+				(pattern >> ((start + i + length) % PATTERN_WIDTH) & 1) == bit; length++) {
+		}
+		if (bit ? length < min_run : (length < min_gap || length > max_gap)) {
+			printf("generated: %s %08x has a %s of %u\n", what, (unsigned)pattern,
+					bit ? "run" : "gap", length);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Patterns generated for every level follow the limits in patterns.h
+// and are the same each time for the same seed, and a game is played
+// with them. (This must be the last scenario: it leaves the generated
+// patterns in place.)
+static void scenario_generated(void) {
+	uint32_t lanes[NUM_LANES], logs[NUM_LOG_CHANNELS];
+	uint32_t again_lanes[NUM_LANES], again_logs[NUM_LOG_CHANNELS];
+	int ok = 1;
+
+	for (uint16_t seed = 0; seed < 256 && ok; seed++) {
+		for (uint8_t level = 1; level <= 99 && ok; level++) {
+			generate_patterns(seed * 251, level, lanes, NUM_LANES, logs, NUM_LOG_CHANNELS);
+			for (uint8_t i = 0; i < NUM_LANES; i++) {
+				ok &= check_pattern("lane", lanes[i], 1, PATTERN_MIN_LANE_GAP, PATTERN_WIDTH);
+			}
+			for (uint8_t i = 0; i < NUM_LOG_CHANNELS; i++) {
+				ok &= check_pattern("log channel", logs[i], PATTERN_MIN_LOG_LENGTH, 1,
+						PATTERN_MAX_LOG_GAP);
+			}
+			generate_patterns(seed * 251, level, again_lanes, NUM_LANES, again_logs,
+					NUM_LOG_CHANNELS);
+			if (memcmp(lanes, again_lanes, sizeof(lanes)) || memcmp(logs, again_logs, sizeof(logs))) {
+				printf("generated: seed %u level %u gave different patterns\n", seed * 251, level);
+				ok = 0;
+			}
+		}
+	}
+	if (!ok) {
+		result.frames_length = 0;
+		return;
+	}
+
+	generate_game_patterns(1234, 10);
+	start_game(7, 1);
+	snapshot("start");
+	for (uint8_t tick = 1; tick <= 20; tick++) {
+		scroll_all();
+		end_tick();
+	}
+	snapshot("tick 20");
+}
+
+typedef struct {
+	const char* name;
+	void (*run)(void);
+} Scenario;
+
+static const Scenario scenarios[] = {
+	{"start", scenario_start},
+	{"scroll", scenario_scroll},
+	{"move_frog", scenario_move_frog},
+	{"log_edge", scenario_log_edge},
+	{"fill_riverbank", scenario_fill_riverbank},
+	{"two_frogs", scenario_two_frogs},
+	{"generated", scenario_generated},
+};
+#define NUM_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+/* GOLDEN FILES */
+// Names of the counts in the golden files (the commands are in the
+// order of EmulatorStats.commands)
+static const char* const command_names[EMULATOR_NUM_COMMANDS] = {
+	"update_all", "update_pixel", "update_row", "update_col", "shift", "clear"
+};
+
+static void write_golden(FILE* file, const char* name) {
+	fprintf(file, "# Golden output of the \"%s\" scenario (host/test_game.c).\n", name);
+	fprintf(file, "# Regenerate with 'make golden' in host/.\n");
+	fwrite(result.frames, 1, result.frames_length, file);
+	fprintf(file, "ticks %u\n", (unsigned)result.ticks);
+	fprintf(file, "bytes %u\n", (unsigned)result.totals.bytes);
+	fprintf(file, "max_tick_bytes %u\n", (unsigned)result.max_tick_bytes);
+	for (uint8_t i = 0; i < EMULATOR_NUM_COMMANDS; i++) {
+		fprintf(file, "%s %u\n", command_names[i], (unsigned)result.totals.commands[i]);
+	}
+}
+
+// Compare a count against the golden file. Returns 1 if it is a
+// regression.
+static int compare_count(const char* scenario, const char* name,
+		uint32_t actual, uint32_t golden) {
+	if (actual > golden) {
+		printf("%s: %s went up from %u to %u\n", scenario, name,
+				(unsigned)golden, (unsigned)actual);
+		return 1;
+	} else if (actual < golden) {
+		printf("%s: %s went down from %u to %u (update the golden files)\n",
+				scenario, name, (unsigned)golden, (unsigned)actual);
+	}
+	return 0;
+}
+
+// Compare the result against the golden file. Returns the number of
+// problems found.
+static int compare_golden(FILE* file, const char* name) {
+	static char frames[MAX_FRAMES_TEXT];
+	size_t frames_length = 0;
+	char line[256], key[32];
+	unsigned value;
+	int problems = 0;
+
+	while (fgets(line, sizeof(line), file)) {
+		if (line[0] == '#') {
+			continue;
+		}
+		if (strncmp(line, "frame", 5) != 0 && (line[0] < '0' || line[0] > '9') &&
+				sscanf(line, "%31s %u", key, &value) == 2) {
+			if (strcmp(key, "ticks") == 0) {
+				if (result.ticks != value) {
+					printf("%s: ran for %u ticks, not %u\n", name,
+							(unsigned)result.ticks, value);
+					problems++;
+				}
+			} else if (strcmp(key, "bytes") == 0) {
+				problems += compare_count(name, key, result.totals.bytes, value);
+			} else if (strcmp(key, "max_tick_bytes") == 0) {
+				problems += compare_count(name, key, result.max_tick_bytes, value);
+			} else {
+				for (uint8_t i = 0; i < EMULATOR_NUM_COMMANDS; i++) {
+					if (strcmp(key, command_names[i]) == 0) {
+						problems += compare_count(name, key,
+								result.totals.commands[i], value);
+					}
+				}
+			}
+			continue;
+		}
+		size_t length = strlen(line);
+		if (frames_length + length < MAX_FRAMES_TEXT) {
+			memcpy(frames + frames_length, line, length);
+			frames_length += length;
+		}
+	}
+
+	if (frames_length != result.frames_length ||
+			memcmp(frames, result.frames, frames_length) != 0) {
+		printf("%s: frames differ from the golden file. Got:\n%.*s", name,
+				(int)result.frames_length, result.frames);
+		problems++;
+	}
+	return problems;
+}
+
+int main(int argc, char** argv) {
+	const char* directory = "golden";
+	uint8_t update = 0;
+	int failed = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--update") == 0) {
+			update = 1;
+		} else {
+			directory = argv[i];
+		}
+	}
+
+	for (uint8_t i = 0; i < NUM_SCENARIOS; i++) {
+		char filename[256];
+		FILE* file;
+
+		scenarios[i].run();
+		emulator_get_totals(&result.totals);
+		if (result.totals.errors || emulator_is_mid_command()) {
+			printf("%s: invalid bytes were sent to the display\n", scenarios[i].name);
+			failed++;
+			continue;
+		}
+		if (result.frames_length == 0) {
+			// The scenario didn't play out as expected
+			failed++;
+			continue;
+		}
+
+		snprintf(filename, sizeof(filename), "%s/%s.txt", directory, scenarios[i].name);
+		if (update) {
+			file = fopen(filename, "w");
+			if (!file) {
+				printf("%s: can't write %s\n", scenarios[i].name, filename);
+				failed++;
+				continue;
+			}
+			write_golden(file, scenarios[i].name);
+			fclose(file);
+			printf("%s: wrote %s\n", scenarios[i].name, filename);
+			continue;
+		}
+
+		file = fopen(filename, "r");
+		if (!file) {
+			printf("%s: no golden file %s\n", scenarios[i].name, filename);
+			failed++;
+			continue;
+		}
+		if (compare_golden(file, scenarios[i].name)) {
+			failed++;
+		} else {
+			printf("%s: %u frame(s), %u bytes over %u ticks - ok\n", scenarios[i].name,
+					(unsigned)result.num_frames, (unsigned)result.totals.bytes,
+					(unsigned)result.ticks);
+		}
+		fclose(file);
+	}
+
+	if (failed) {
+		printf("%d scenario(s) failed\n", failed);
+		return 1;
+	}
+	return 0;
+}
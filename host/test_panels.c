@@ -0,0 +1,290 @@
+/*
+ * test_panels.c
+ *
+ * Author: Sean Manson
+ *
+ * Checks the display and game on a display made up of more than one
+ * LED matrix panel. This is built (with everything it uses) with the
+ * panel options in the Makefile, e.g. two panels side by side and the
+ * long field, so that the game is played through the viewport.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "matrix_emulator.h"
+#include "ledmatrix.h"
+#include "scrolling_char_display.h"
+#include "animation.h"
+#include "game.h"
+
+#if MATRIX_NUM_PANELS < 2
+#error "test_panels should be built for more than one panel"
+#endif
+
+// Colours used by game.c
+#define COLOUR_FROG 0xFF
+#define COLOUR_EDGES 0x12
+#define COLOUR_LOGS 0x3C
+
+// Rows of the field (see game.h)
+#define HALFWAY_ROW (NUM_LANES + 1)
+#define RIVERBANK_ROW (GAME_NUM_ROWS - 1)
+
+static int failures;
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static void check(int passed, const char* condition, int line) {
+	if (!passed) {
+		printf("FAIL line %d: %s\n", line, condition);
+		failures++;
+	}
+}
+
+// Start again with a blank display. (ledmatrix.c is set up again so
+// that it knows the emulator has gone back to panel 0.)
+static void reset(void) {
+	emulator_reset();
+	ledmatrix_setup();
+	ledmatrix_set_viewport(0);
+}
+
+// Each command gets to the right panel, and costs the same for each
+// panel it covers
+static void test_commands(void) {
+	EmulatorStats stats;
+	MatrixRow row;
+	MatrixColumn col;
+	MatrixData data;
+	uint8_t x, y;
+
+	reset();
+	ledmatrix_update_pixel(MATRIX_NUM_COLUMNS - 1, MATRIX_NUM_ROWS - 1, COLOUR_RED);
+	ledmatrix_update_pixel(3, 2, COLOUR_GREEN);
+	emulator_end_frame(&stats);
+	CHECK(emulator_get_pixel(MATRIX_NUM_COLUMNS - 1, MATRIX_NUM_ROWS - 1) == COLOUR_RED);
+	CHECK(emulator_get_pixel(3, 2) == COLOUR_GREEN);
+	CHECK(stats.bytes == 6);
+
+	for (x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		row[x] = x + 1;
+	}
+	ledmatrix_update_row(MATRIX_NUM_ROWS - 1, row);
+	emulator_end_frame(&stats);
+	for (x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		CHECK(emulator_get_pixel(x, MATRIX_NUM_ROWS - 1) == x + 1);
+	}
+	CHECK(stats.bytes == MATRIX_PANELS_ACROSS * 18);
+
+	for (y = 0; y < MATRIX_NUM_ROWS; y++) {
+		col[y] = y + 1;
+	}
+	ledmatrix_update_column(PANEL_NUM_COLUMNS, col);
+	emulator_end_frame(&stats);
+	for (y = 0; y < MATRIX_NUM_ROWS; y++) {
+		CHECK(emulator_get_pixel(PANEL_NUM_COLUMNS, y) == y + 1);
+	}
+	CHECK(stats.bytes == MATRIX_PANELS_UP * 10);
+
+	for (x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		for (y = 0; y < MATRIX_NUM_ROWS; y++) {
+			data[x][y] = x + MATRIX_NUM_COLUMNS * y;
+		}
+	}
+	ledmatrix_update_all(data);
+	emulator_end_frame(&stats);
+	for (x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		for (y = 0; y < MATRIX_NUM_ROWS; y++) {
+			CHECK(emulator_get_pixel(x, y) == data[x][y]);
+		}
+	}
+	CHECK(stats.bytes == MATRIX_NUM_PANELS * 129);
+
+	// Each panel shifts on its own
+	ledmatrix_shift_display_left();
+	emulator_end_frame(&stats);
+	CHECK(emulator_get_pixel(0, 0) == data[1][0]);
+	CHECK(emulator_get_pixel(PANEL_NUM_COLUMNS - 1, 0) == 0);
+	CHECK(stats.bytes == MATRIX_NUM_PANELS * 2);
+
+	ledmatrix_clear();
+	emulator_end_frame(&stats);
+	CHECK(emulator_get_pixel(MATRIX_NUM_COLUMNS - 1, MATRIX_NUM_ROWS - 1) == 0);
+	CHECK(stats.bytes == MATRIX_NUM_PANELS);
+
+	CHECK(!emulator_is_mid_command());
+	emulator_get_totals(&stats);
+	CHECK(stats.errors == 0);
+}
+
+// The pixel and row functions show the rows in the viewport, and send
+// nothing for the others
+static void test_viewport(void) {
+	EmulatorStats stats;
+	MatrixRow row;
+	uint8_t x;
+
+	reset();
+	for (x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		row[x] = COLOUR_ORANGE;
+	}
+	ledmatrix_set_viewport(4);
+	ledmatrix_update_pixel(5, 3, COLOUR_RED);
+	ledmatrix_update_row(3, row);
+	ledmatrix_update_row(4 + MATRIX_NUM_ROWS, row);
+	emulator_end_frame(&stats);
+	CHECK(stats.bytes == 0);
+
+	ledmatrix_update_pixel(5, 4, COLOUR_RED);
+	ledmatrix_update_row(3 + MATRIX_NUM_ROWS, row);
+	emulator_end_frame(&stats);
+	CHECK(emulator_get_pixel(5, 0) == COLOUR_RED);
+	CHECK(emulator_get_pixel(MATRIX_NUM_COLUMNS - 1, MATRIX_NUM_ROWS - 1) == COLOUR_ORANGE);
+	CHECK(stats.bytes == 3 + MATRIX_PANELS_ACROSS * 18);
+	ledmatrix_set_viewport(0);
+}
+
+// Scrolled text moves across from panel to panel without a gap: after
+// each step, the display is the one before moved a column to the left
+static void test_scrolling(void) {
+	EmulatorStats stats;
+	MatrixData before, after;
+	uint32_t steps = 0, lit = 0;
+	uint8_t x, y, seamless = 1;
+
+	reset();
+	host_reset_clock();
+	init_scrolling_display();
+	set_text_colour(COLOUR_GREEN);
+	set_scrolling_display_text("Frogger " TEXT_YELLOW "1.0!");
+	emulator_get_frame(before);
+	while (update_scrolling_display()) {
+		emulator_end_frame(&stats);
+		if (stats.bytes) {
+			emulator_get_frame(after);
+			for (x = 0; x + 1 < MATRIX_NUM_COLUMNS; x++) {
+				for (y = 0; y < PANEL_NUM_ROWS; y++) {
+					if (after[x][y] != before[x + 1][y]) {
+						seamless = 0;
+					}
+					lit += (after[x][y] != 0);
+				}
+			}
+			memcpy(before, after, sizeof(before));
+			steps++;
+		}
+		host_advance_clock(1);
+	}
+	emulator_get_totals(&stats);
+	printf("panels scrolling: %u steps, %u bytes\n", (unsigned)steps,
+			(unsigned)stats.bytes);
+	CHECK(seamless);
+	CHECK(lit > 0);
+	CHECK(stats.errors == 0);
+}
+
+// Animations are shown on every panel
+static void test_animations(void) {
+	EmulatorStats stats;
+
+	reset();
+	host_reset_clock();
+	play_animation_level_complete();
+	while (update_animation()) {
+		host_advance_clock(1);
+	}
+	emulator_get_totals(&stats);
+	printf("panels level complete animation: %u bytes\n", (unsigned)stats.bytes);
+	CHECK(stats.errors == 0);
+	CHECK(emulator_get_pixel(0, 0) == COLOUR_YELLOW);
+	CHECK(emulator_get_pixel(MATRIX_NUM_COLUMNS - PANEL_NUM_COLUMNS, 0) == COLOUR_YELLOW);
+	CHECK(emulator_get_pixel(5, 5) == COLOUR_GREEN);
+	CHECK(emulator_get_pixel(MATRIX_NUM_COLUMNS - PANEL_NUM_COLUMNS + 5, 5) == COLOUR_GREEN);
+}
+
+// Whether the frog would be safe in the given row, judging by what is
+// on the display
+static uint8_t is_safe(uint8_t column, uint8_t row) {
+	PixelColour pixel = emulator_get_pixel(column, row - ledmatrix_get_viewport());
+	if (row == HALFWAY_ROW) {
+		return 1;
+	} else if (row < HALFWAY_ROW) {
+		return pixel == 0;
+	} else {
+		return pixel == COLOUR_LOGS;
+	}
+}
+
+// A frog is taken up the field to the last log channel, waiting for
+// each row ahead to be safe. The display follows it up.
+static void test_long_field(void) {
+	EmulatorStats stats;
+	uint8_t row, column, moving_row, tries;
+	int8_t first_row;
+
+	reset();
+	srand(5);
+	// Two frogs could be further apart than the display, so only one
+	// player can play on this field
+	CHECK(MAX_PLAYERS == 1);
+	set_number_of_frogs(2);
+	CHECK(get_number_of_frogs() == 1);
+	set_number_of_frogs(1);
+	init_game();
+	put_frog_at_start(0);
+	CHECK(ledmatrix_get_viewport() == 0);
+	CHECK(!is_riverbank_full());
+
+	for (row = 0; row + 1 < RIVERBANK_ROW; row++) {
+		column = get_frog_column(0);
+		if (row + 1 != HALFWAY_ROW) {
+			moving_row = (row + 1 < HALFWAY_ROW) ? row : row - 1;
+			for (tries = 0; tries < 32 && !is_safe(column, row + 1); tries++) {
+				scroll_moving_row(moving_row, 1);
+			}
+		}
+		move_frog_forward(0);
+		CHECK(is_frog_alive(0));
+		CHECK(get_frog_row(0) == row + 1);
+
+		first_row = get_frog_row(0) - 2;
+		if (first_row < 0) {
+			first_row = 0;
+		} else if (first_row > GAME_NUM_ROWS - MATRIX_NUM_ROWS) {
+			first_row = GAME_NUM_ROWS - MATRIX_NUM_ROWS;
+		}
+		CHECK(ledmatrix_get_viewport() == first_row);
+		CHECK(emulator_get_pixel(get_frog_column(0), get_frog_row(0) - first_row) == COLOUR_FROG);
+		if (HALFWAY_ROW >= first_row && HALFWAY_ROW < first_row + MATRIX_NUM_ROWS &&
+				get_frog_row(0) != HALFWAY_ROW) {
+			CHECK(emulator_get_pixel(0, HALFWAY_ROW - first_row) == COLOUR_EDGES);
+		}
+	}
+	// The riverbank is at the top of the display
+	CHECK(emulator_get_pixel(0, RIVERBANK_ROW - ledmatrix_get_viewport()) == COLOUR_EDGES);
+	CHECK(emulator_get_pixel(2, RIVERBANK_ROW - ledmatrix_get_viewport()) == 0);
+
+	emulator_get_totals(&stats);
+	printf("panels long field: %u bytes\n", (unsigned)stats.bytes);
+	CHECK(stats.errors == 0);
+}
+
+int main(int argc, char** argv) {
+	printf("%u panel(s) across, %u up; field of %u rows\n", MATRIX_PANELS_ACROSS,
+			MATRIX_PANELS_UP, GAME_NUM_ROWS);
+	test_commands();
+	test_viewport();
+	test_scrolling();
+	test_animations();
+	test_long_field();
+
+	if (failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("All panel checks passed\n");
+	return 0;
+}
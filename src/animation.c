@@ -0,0 +1,254 @@
+/*
+ * animation.c
+ *
+ * Written by Sean Manson
+ *
+ * Animation player for the LED matrix.
+ */
+
+#include <avr/pgmspace.h>
+#include <string.h>
+
+#include "animation.h"
+#include "ledmatrix.h"
+#include "timer0.h"
+
+// Bytes sent to the display for each way of updating it. Each panel
+// shows the same frame, so is sent the same changes.
+#define PIXEL_UPDATE_BYTES (3 * MATRIX_NUM_PANELS)
+#define ROW_UPDATE_BYTES ((2 + PANEL_NUM_COLUMNS) * MATRIX_NUM_PANELS)
+#define FULL_UPDATE_BYTES ((1 + PANEL_NUM_COLUMNS * PANEL_NUM_ROWS) * MATRIX_NUM_PANELS)
+
+// Time to send a byte to the display, in microseconds. The SPI clock
+// is the system clock divided by 128 (see ledmatrix_setup()), so each
+// bit takes 16us.
+#define SPI_BYTE_TIME_US 128
+
+// The in-built animations
+#define DEATH_X(colour) \
+	ANIM_RUN(4, 0, 1, colour), ANIM_RUN(11, 0, 1, colour), \
+	ANIM_RUN(5, 1, 1, colour), ANIM_RUN(10, 1, 1, colour), \
+	ANIM_RUN(6, 2, 1, colour), ANIM_RUN(9, 2, 1, colour), \
+	ANIM_RUN(7, 3, 1, colour), ANIM_RUN(8, 3, 1, colour), \
+	ANIM_RUN(8, 4, 1, colour), ANIM_RUN(7, 4, 1, colour), \
+	ANIM_RUN(9, 5, 1, colour), ANIM_RUN(6, 5, 1, colour), \
+	ANIM_RUN(10, 6, 1, colour), ANIM_RUN(5, 6, 1, colour), \
+	ANIM_RUN(11, 7, 1, colour), ANIM_RUN(4, 7, 1, colour)
+static const uint8_t animation_death[] PROGMEM = {
+	ANIM_KEY, 10, 1, ANIM_RUN(0, 0, 128, COLOUR_RED),
+	ANIM_KEY, 30, 16, DEATH_X(COLOUR_RED),
+	ANIM_DELTA, 15, 16, DEATH_X(0),
+	ANIM_DELTA, 30, 16, DEATH_X(COLOUR_RED),
+	ANIM_DELTA, 15, 16, DEATH_X(0),
+	ANIM_DELTA, 30, 16, DEATH_X(COLOUR_RED),
+	ANIM_END
+};
+
+// The border of the display. Runs carry on from the end of one row to
+// the start of the next, so each pair of side pixels is one run.
+#define BORDER(colour) \
+	ANIM_RUN(0, 0, 17, colour), ANIM_RUN(15, 1, 2, colour), \
+	ANIM_RUN(15, 2, 2, colour), ANIM_RUN(15, 3, 2, colour), \
+	ANIM_RUN(15, 4, 2, colour), ANIM_RUN(15, 5, 2, colour), \
+	ANIM_RUN(15, 6, 17, colour)
+static const uint8_t animation_level_complete[] PROGMEM = {
+	ANIM_KEY, 6, 1, ANIM_RUN(0, 0, 16, COLOUR_GREEN),
+	ANIM_DELTA, 6, 1, ANIM_RUN(0, 1, 16, COLOUR_GREEN),
+	ANIM_DELTA, 6, 1, ANIM_RUN(0, 2, 16, COLOUR_GREEN),
+	ANIM_DELTA, 6, 1, ANIM_RUN(0, 3, 16, COLOUR_GREEN),
+	ANIM_DELTA, 6, 1, ANIM_RUN(0, 4, 16, COLOUR_GREEN),
+	ANIM_DELTA, 6, 1, ANIM_RUN(0, 5, 16, COLOUR_GREEN),
+	ANIM_DELTA, 6, 1, ANIM_RUN(0, 6, 16, COLOUR_GREEN),
+	ANIM_DELTA, 6, 1, ANIM_RUN(0, 7, 16, COLOUR_GREEN),
+	ANIM_DELTA, 25, 7, BORDER(COLOUR_YELLOW),
+	ANIM_DELTA, 25, 7, BORDER(COLOUR_GREEN),
+	ANIM_DELTA, 25, 7, BORDER(COLOUR_YELLOW),
+	ANIM_END
+};
+
+// The animation playing. next_frame points to its next frame in
+// program memory, or is NULL if there is no animation playing.
+// next_frame_time is the clock tick at which that frame is due.
+static const uint8_t* next_frame;
+static uint32_t next_frame_time;
+
+// What is on the display. first_frame is set until the first frame
+// has been sent, as until then we don't know what is there.
+static PanelData frame;
+static uint8_t first_frame;
+
+// The pixels which have changed in the frame being drawn (bit x of
+// changed[y] for pixel (x, y)) and how many in each row
+static uint16_t changed[PANEL_NUM_ROWS];
+static uint8_t changed_count[PANEL_NUM_ROWS];
+
+// Number of frames which took too long to send
+static uint8_t overruns;
+
+static uint16_t draw_frame(const uint8_t* frame_data, uint8_t type);
+static void send_frame(uint8_t full);
+
+void play_animation(const uint8_t* animation) {
+	next_frame = animation;
+	next_frame_time = get_clock_ticks();
+	memset(frame, 0, sizeof(frame));
+	first_frame = 1;
+	overruns = 0;
+}
+
+uint8_t update_animation(void) {
+	uint32_t current_time;
+	uint8_t type, time;
+	uint16_t bytes;
+
+	if (!next_frame) {
+		return 0;
+	}
+	current_time = get_clock_ticks();
+	if ((int32_t)(current_time - next_frame_time) < 0) {
+		return 1;
+	}
+
+	type = pgm_read_byte(next_frame);
+	if (type == ANIM_END) {
+		next_frame = 0;
+		return 0;
+	}
+	time = pgm_read_byte(next_frame + 1);
+
+	// Work out the new frame and send it
+	bytes = draw_frame(next_frame + 2, type);
+	next_frame += 3 + 3 * pgm_read_byte(next_frame + 2);
+
+	// Check that sending it fit in the time it is shown for. If it
+	// didn't, show it for its full time from now, rather than cutting
+	// it short to catch up.
+	next_frame_time += 10 * (uint16_t)time;
+	if ((uint32_t)bytes * SPI_BYTE_TIME_US > 10000 * (uint32_t)time) {
+		overruns++;
+		next_frame_time = get_clock_ticks() + 10 * (uint16_t)time;
+	}
+	return 1;
+}
+
+void stop_animation(void) {
+	next_frame = 0;
+}
+
+uint8_t is_animation_playing(void) {
+	return next_frame != 0;
+}
+
+uint8_t get_animation_overruns(void) {
+	return overruns;
+}
+
+
+/* HELPER FUNCTIONS */
+// Apply the runs of a frame to our copy of the display, then send the
+// changes in whichever way needs the fewest bytes. Returns the number
+// of bytes sent.
+static uint16_t draw_frame(const uint8_t* frame_data, uint8_t type) {
+	uint8_t runs, position, length, colour, x, y;
+	uint16_t bytes = 0;
+
+	for (y = 0; y < PANEL_NUM_ROWS; y++) {
+		changed[y] = 0;
+		changed_count[y] = 0;
+	}
+	if (type == ANIM_KEY) {
+		// Start from a blank display
+		for (y = 0; y < PANEL_NUM_ROWS; y++) {
+			for (x = 0; x < PANEL_NUM_COLUMNS; x++) {
+				if (frame[x][y]) {
+					frame[x][y] = 0;
+					changed[y] |= 1U << x;
+					changed_count[y]++;
+				}
+			}
+		}
+	}
+
+	runs = pgm_read_byte(frame_data++);
+	while (runs--) {
+		position = pgm_read_byte(frame_data);
+		length = pgm_read_byte(frame_data + 1);
+		colour = pgm_read_byte(frame_data + 2);
+		frame_data += 3;
+		while (length-- && position < PANEL_NUM_COLUMNS * PANEL_NUM_ROWS) {
+			x = position & 0x0F;
+			y = position >> 4;
+			if (frame[x][y] != colour) {
+				frame[x][y] = colour;
+				if (!(changed[y] & (1U << x))) {
+					changed[y] |= 1U << x;
+					changed_count[y]++;
+				}
+			}
+			position++;
+		}
+	}
+
+	// Each changed row can be sent a pixel at a time or all at once
+	for (y = 0; y < PANEL_NUM_ROWS; y++) {
+		if (changed_count[y] * PIXEL_UPDATE_BYTES < ROW_UPDATE_BYTES) {
+			bytes += changed_count[y] * PIXEL_UPDATE_BYTES;
+		} else {
+			bytes += ROW_UPDATE_BYTES;
+		}
+	}
+	if (first_frame || bytes >= FULL_UPDATE_BYTES) {
+		bytes = FULL_UPDATE_BYTES;
+		send_frame(1);
+	} else {
+		send_frame(0);
+	}
+	first_frame = 0;
+	return bytes;
+}
+
+// Send the frame to every panel: the whole frame if full is 1,
+// otherwise the changed pixels and rows. The frame is drawn on the
+// display as it is, whatever the viewport is.
+static void send_frame(uint8_t full) {
+	MatrixRow row;
+	uint8_t x, y, up, across;
+	uint8_t viewport = ledmatrix_get_viewport();
+
+	if (full) {
+		ledmatrix_update_all_panels(frame);
+		return;
+	}
+	ledmatrix_set_viewport(0);
+	for (y = 0; y < PANEL_NUM_ROWS; y++) {
+		if (changed_count[y] * PIXEL_UPDATE_BYTES < ROW_UPDATE_BYTES) {
+			for (x = 0; x < PANEL_NUM_COLUMNS; x++) {
+				if (changed[y] & (1U << x)) {
+					for (up = 0; up < MATRIX_PANELS_UP; up++) {
+						for (across = 0; across < MATRIX_PANELS_ACROSS; across++) {
+							ledmatrix_update_pixel(across * PANEL_NUM_COLUMNS + x,
+									up * PANEL_NUM_ROWS + y, frame[x][y]);
+						}
+					}
+				}
+			}
+		} else {
+			for (x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+				row[x] = frame[x % PANEL_NUM_COLUMNS][y];
+			}
+			for (up = 0; up < MATRIX_PANELS_UP; up++) {
+				ledmatrix_update_row(up * PANEL_NUM_ROWS + y, row);
+			}
+		}
+	}
+	ledmatrix_set_viewport(viewport);
+}
+
+
+/* In-built animations */
+void play_animation_death(void) {
+	play_animation(animation_death);
+}
+void play_animation_level_complete(void) {
+	play_animation(animation_level_complete);
+}
@@ -0,0 +1,87 @@
+/*
+ * animation.h
+ *
+ * Author: Sean Manson
+ *
+ * Plays animations (sequences of frames) on the LED matrix.
+ *
+ * Animations are kept in program memory as a list of frames, each of
+ * which is:
+ *    - 1 byte frame type (ANIM_KEY or ANIM_DELTA), or ANIM_END to
+ *      finish the animation
+ *    - 1 byte time to show the frame for, in hundredths of seconds
+ *    - 1 byte number of runs
+ *    - the runs, each of which is 3 bytes (see ANIM_RUN): a start
+ *      position, a length and a colour. The run sets that many pixels
+ *      from the start position to the colour, going left to right
+ *      along each row and then onto the next row up.
+ * A key frame starts from a blank display, so only the lit pixels
+ * need runs. A delta frame starts from the previous frame, so only
+ * the pixels which change need runs. The first frame of an animation
+ * is drawn over a blank display and always sent in full, as we don't
+ * know what was on the display.
+ *
+ * A copy of the current frame is kept so that only the changes need
+ * to be sent to the display. For each frame we work out whether it is
+ * cheapest to send the changed pixels one at a time, the changed rows,
+ * or the whole display, and send that.
+ *
+ * Animations are 16x8 pixels. On a display made up of several panels
+ * (see ledmatrix.h) the same animation is shown on every panel, so it
+ * takes that many times as long to send.
+ *
+ * Each frame should be able to be sent within the time it is shown
+ * for. (Sending the whole of one panel takes about 17ms.) Frames which
+ * can't are still sent in full - we never skip frames, as the frames
+ * after depend on them - but are counted, and the frames after are
+ * shown late.
+ *
+ * Like the scrolling display, update_animation() uses timer 0 to tell
+ * when the next frame is due and returns straight away otherwise, so
+ * it can be called from any loop which is waiting for input.
+ */
+
+#ifndef ANIMATION_H_
+#define ANIMATION_H_
+
+#include <stdint.h>
+
+// Frame types
+#define ANIM_END 0
+#define ANIM_KEY 1
+#define ANIM_DELTA 2
+
+// A run of pixels in an animation frame, starting at (x, y)
+#define ANIM_RUN(x, y, length, colour) (((y)<<4) | (x)), (length), (colour)
+
+/* Start playing the given animation (in program memory). The first
+ * frame is shown on the next call to update_animation(). Replaces any
+ * animation which is already playing.
+ */
+void play_animation(const uint8_t* animation);
+
+/* Show the next frame of the animation if it is due. Should be called
+ * often while the animation plays. Returns 1 while the animation is
+ * still playing and 0 once it has finished.
+ */
+uint8_t update_animation(void);
+
+/* Stop the animation, leaving the current frame on the display.
+ */
+void stop_animation(void);
+
+/* Return whether an animation is playing.
+ */
+uint8_t is_animation_playing(void);
+
+/* Return the number of frames which couldn't be sent to the display
+ * within the time they are meant to be shown for (since the last call
+ * to play_animation()).
+ */
+uint8_t get_animation_overruns(void);
+
+/* In-built animations */
+void play_animation_death(void);
+void play_animation_level_complete(void);
+
+#endif /* ANIMATION_H_ */
@@ -0,0 +1,62 @@
+/*
+ * bench.h
+ *
+ * Author: Sean Manson
+ *
+ * Markers for the cycle benchmark (see bench/ in the top directory).
+ *
+ * When the firmware is built with BENCHMARK defined, BENCH_BEGIN(id)
+ * writes id to GPIOR0 and BENCH_END(id) writes id with the top bit
+ * set. GPIOR0 isn't used for anything else, each write is a single
+ * OUT instruction, and the simulator watches it to count the cycles
+ * between the two. Markers must be properly nested - an interrupt
+ * handler's markers will always be inside whatever it interrupted, so
+ * that is fine - and the cycles of an inner marker are included in
+ * those of the outer ones.
+ *
+ * The markers in an interrupt handler don't include the handler's
+ * prologue and epilogue (register saving, RETI), which is up to about
+ * 40 more cycles.
+ *
+ * Without BENCHMARK the markers compile away to nothing.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+// Marker ids. These must match the names in bench/simbench.c.
+#define BENCH_ISR_TIMER0 1
+#define BENCH_ISR_ADC 2
+#define BENCH_ISR_USART_RX 3
+#define BENCH_ISR_USART_UDRE 4
+#define BENCH_ISR_EEPROM 5
+#define BENCH_ISR_SYNTH 6
+#define BENCH_SPI_BURST 7
+#define BENCH_SCROLL_LANE 8
+#define BENCH_SCROLL_LOG_CHANNEL 9
+#define BENCH_REDRAW_WHOLE_DISPLAY 10
+#define BENCH_REDRAW_ROADSIDE 11
+#define BENCH_REDRAW_TRAFFIC_LANE 12
+#define BENCH_REDRAW_RIVER_CHANNEL 13
+#define BENCH_REDRAW_RIVERBANK 14
+#define BENCH_REDRAW_FROG 15
+#define BENCH_PLAY_LEVEL_LOOP 16
+#define BENCH_NUM_MARKERS 17
+
+#define BENCH_END_FLAG 0x80
+
+#ifdef BENCHMARK
+
+#include <avr/io.h>
+
+#define BENCH_BEGIN(id) (GPIOR0 = (id))
+#define BENCH_END(id) (GPIOR0 = (id) | BENCH_END_FLAG)
+
+#else
+
+#define BENCH_BEGIN(id) ((void)0)
+#define BENCH_END(id) ((void)0)
+
+#endif /* BENCHMARK */
+
+#endif /* BENCH_H_ */
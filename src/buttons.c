@@ -3,38 +3,47 @@
  *
  * Author: Peter Sutton
  * Edited: Sean Manson
- */ 
+ */
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "buttons.h"
 #include "timer0.h"
+#include "latency.h"
 
-// Global variable to keep track of the last button state so that we 
-// can detect changes when an interrupt fires. The lower 4 bits (0 to 3)
-// will correspond to the last state of port B pins 0 to 3.
-static volatile uint8_t last_button_state;
-
-// Our button queue. button_queue[0] is always the head of the queue. If we
-// take something off the queue we just move everything else along. We don't
-// use a circular buffer since it is usually expected that the queue is very
-// short. In most uses it will never have more than 1 element at a time.
-// This button queue can be changed by the interrupt handler below so we should
-// turn off interrupts if we're changing the queue outside the handler.
-#define BUTTON_QUEUE_SIZE 4
-static volatile uint8_t button_queue[BUTTON_QUEUE_SIZE];
-static volatile int8_t queue_length;
-
-// Time (according to the clock) when the current button command should be repeated
-// A value of 0 indicates that the buttons should not be repeated for now
-static volatile uint32_t button_repeat_time;
-
-// Button states for each button
-// Each of these correspond to the expected input when only one button is pressed
-#define BUTTON_B0 1
-#define BUTTON_B1 2
-#define BUTTON_B2 4
-#define BUTTON_B3 8
+// Our event queue. This is a circular buffer - button_timer_tick() adds
+// events at the head and get_button_event() takes them from the tail.
+// As each end is only changed by one side, we don't need to turn off
+// interrupts to use it. Must be a power of 2.
+#define BUTTON_QUEUE_SIZE 8
+static volatile ButtonEvent event_queue[BUTTON_QUEUE_SIZE];
+static volatile uint8_t queue_head;
+static volatile uint8_t queue_tail;
+static volatile uint16_t events_dropped;
+
+// Whether events should be queued
+static volatile uint8_t buttons_active;
+
+// Debouncing. Each button has a count which goes up every millisecond
+// the pin is high and down every millisecond it is low. The button is
+// considered pushed when this reaches DEBOUNCE_SAMPLES, and released
+// when it gets back to 0. button_state holds the debounced state of
+// each button (as a mask).
+static uint8_t debounce_count[4];
+static uint8_t button_state;
+
+// Chord detection. When a button is pushed we wait chord_countdown
+// milliseconds for any others, collecting them in chord_buttons.
+// chord_time is when the first one was pushed.
+static uint8_t chord_countdown;
+static uint8_t chord_buttons;
+static uint32_t chord_time;
+
+// The button (or chord) currently being held for repetition, and the
+// time (ms) until it is next repeated. A countdown of 0 indicates that
+// the buttons should not be repeated for now.
+static uint8_t held_buttons;
+static uint16_t repeat_countdown;
 
 // Delay values for repetition
 // initial press
@@ -42,191 +51,184 @@ static volatile uint32_t button_repeat_time;
 // continual press
 #define REPEAT_DELAY 150
 
-// Setup interrupt if any of pins B0 to B3 change. We do this
-// using a pin change interrupt. These pins correspond to pin
-// change interrupts PCINT8 to PCINT11 which are covered by
-// Pin change interrupt 1.
-void init_button_interrupts(void) {
-	// Disable interrupts so we can be sure that the interrupt
+static void queue_event(uint8_t type, uint8_t buttons, uint32_t time);
+static void finish_chord(void);
+
+void init_buttons(void) {
+	// Disable interrupts so we can be sure that the timer interrupt
 	// doesn't fire halfway through.
 	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
 	cli();
-	
-	// Enable the interrupt (see datasheet page 69)
-	PCICR |= (1<<PCIE1);
-	
-	// Make sure the interrupt flag is cleared (by writing a 
-	// 1 to it) (see datasheet page 69)
-	PCIFR |= (1<<PCIF1);
-	
-	// Choose which pins we're interested in by setting
-	// the relevant bits in the mask register (see datasheet page 70)
-	PCMSK1 |= (1<<PCINT8)|(1<<PCINT9)|(1<<PCINT10)|(1<<PCINT11);	
-	
-	// Empty the button push queue
-	queue_length = 0;
-	
-	// Clear the repeat time
-	button_repeat_time = 0;
-	
+
+	// Pins B0 to B3 are inputs
+	DDRB &= 0xF0;
+
+	// Start with all buttons up
+	for (uint8_t i = 0; i < 4; i++) {
+		debounce_count[i] = 0;
+	}
+	button_state = 0;
+	chord_countdown = 0;
+	held_buttons = 0;
+	repeat_countdown = 0;
+
+	// Empty the event queue
+	queue_head = 0;
+	queue_tail = 0;
+	events_dropped = 0;
+	buttons_active = 1;
+
 	// Reenable interrupts
 	if(interruptsOn) {
 		sei();
 	}
 }
 
+uint8_t get_button_event(ButtonEvent* event) {
+	if(queue_tail == queue_head) {
+		return 0;
+	}
+	event->type = event_queue[queue_tail].type;
+	event->buttons = event_queue[queue_tail].buttons;
+	event->time = event_queue[queue_tail].time;
+	queue_tail = (queue_tail + 1) & (BUTTON_QUEUE_SIZE - 1);
+	return 1;
+}
+
 int8_t button_pushed(void) {
-	int8_t return_value = -1;	// Assume no button pushed
-	if(queue_length > 0) {
-		// Remove the first element off the queue and move all the other
-		// entries closer to the front of the queue. We turn off interrupts (if on)
-		// before we make any changes to the queue. If interrupts were on
-		// we turn them back on when done.
-		return_value = button_queue[0];
-		
-		// Save whether interrupts were enabled and turn them off
-		int8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
-		cli();
-		
-		for(uint8_t i = 1; i < queue_length; i++) {
-			button_queue[i-1] = button_queue[i];
-		}
-		queue_length--;
-		
-		if(interrupts_were_enabled) {
-			// Turn them back on again
-			sei();
+	ButtonEvent event;
+	while(get_button_event(&event)) {
+		if(event.type == BUTTON_EVENT_PRESS || event.type == BUTTON_EVENT_CHORD) {
+			// Return the lowest numbered button
+			for(int8_t i = 0; i < 4; i++) {
+				if(event.buttons & (1<<i)) {
+					return i;
+				}
+			}
 		}
 	}
-	return return_value;
+	return -1;
 }
 
-void activate_buttons(void) {
-	// Disable interrupts so we can be sure that the interrupt
-	// doesn't fire halfway through.
+void clear_button_events(void) {
+	queue_tail = queue_head;
+}
+
+uint16_t get_button_events_dropped(void) {
 	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
 	cli();
-	
-	// Enable the interrupt (see datasheet page 69)
-	PCICR |= (1<<PCIE1);
-	
-	// Make sure the interrupt flag is cleared (by writing a
-	// 1 to it) (see datasheet page 69)
-	PCIFR |= (1<<PCIF1);
-	
-	// Empty the button push queue
-	queue_length = 0;
-	
-	//Reenable interrupts
+	uint16_t dropped = events_dropped;
 	if(interruptsOn) {
 		sei();
 	}
+	return dropped;
+}
+
+void activate_buttons(void) {
+	// Empty the event queue and start queueing again
+	clear_button_events();
+	buttons_active = 1;
 }
 
 void deactivate_buttons(void) {
-	// Disable interrupts so we can be sure that the interrupt
-	// doesn't fire halfway through.
-	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
-	cli();
-	
-	// Disable the interrupt (see datasheet page 69)
-	PCICR &= ~(1<<PCIE1);
-	
-	//Reenable interrupts
-	if(interruptsOn) {
-		sei();
-	}
+	buttons_active = 0;
 }
 
-int8_t should_button_repeat(void) {
-	// If we should not repeat this button
-	if (button_repeat_time == 0) {
-		return -1;
+void button_timer_tick(void) {
+	uint8_t pins = PINB & 0x0F;
+	uint8_t pushed = 0;
+	uint8_t released = 0;
+
+	// Debounce each button
+	for(uint8_t i = 0; i < 4; i++) {
+		uint8_t mask = 1<<i;
+		if(pins & mask) {
+			if(debounce_count[i] < DEBOUNCE_SAMPLES && ++debounce_count[i] == DEBOUNCE_SAMPLES
+					&& !(button_state & mask)) {
+				button_state |= mask;
+				pushed |= mask;
+			}
+		} else {
+			if(debounce_count[i] > 0 && --debounce_count[i] == 0 && (button_state & mask)) {
+				button_state &= ~mask;
+				released |= mask;
+			}
+		}
 	}
-	
-	// Disable interrupts so we can be sure that the interrupt
-	// doesn't fire halfway through.
-	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
-	cli();
-	
-	// Assume we should not repeat
-	int8_t return_value = -1;
-	
-	// Get the current state of the buttons
-	uint8_t button_state = PINB & 0x0F;
-	
-	// If there has been no changes in button state since last time, and
-	// it is time to repeat a button movement
-	if (get_clock_ticks() > button_repeat_time && button_state == last_button_state) {
-		// Go through each of the 'only one button pushed' states
-		// Return the value if it matches a single button state, and
-		// set the timer for the next repeat.
-		switch (button_state) {
-			case BUTTON_B0:
-				button_repeat_time = get_clock_ticks() + REPEAT_DELAY;
-				return_value = 0;
-				break;
-			case BUTTON_B1:
-				button_repeat_time = get_clock_ticks() + REPEAT_DELAY;
-				return_value = 1;
-				break;
-			case BUTTON_B2:
-				button_repeat_time = get_clock_ticks() + REPEAT_DELAY;
-				return_value = 2;
-				break;
-			case BUTTON_B3:
-				button_repeat_time = get_clock_ticks() + REPEAT_DELAY;
-				return_value = 3;
-				break;
-			default:
-				button_repeat_time = 0;
+
+	if(pushed) {
+		if(chord_countdown == 0) {
+			// Start waiting for any other buttons in this chord. Any
+			// button we were repeating is forgotten.
+			chord_buttons = pushed;
+			chord_time = get_clock_ticks();
+			chord_countdown = CHORD_WINDOW;
+			held_buttons = 0;
+			repeat_countdown = 0;
+
+			// Timestamp this input for latency measurement
+			latency_input_isr(LATENCY_SOURCE_BUTTON);
+		} else {
+			chord_buttons |= pushed;
 		}
-	} else if (button_state != last_button_state) {
-		// If the state has changed,
-		// ignore the buttons and reset our repeat
-		button_repeat_time = 0;
 	}
-	
-	// Reenable interrupts
-	if(interruptsOn) {
-		sei();
+
+	if(released) {
+		// If a button is let go before the chord is finished, report the
+		// push now so it comes before the release
+		if(chord_countdown != 0) {
+			finish_chord();
+		}
+		queue_event(BUTTON_EVENT_RELEASE, released, get_clock_ticks());
+		if(released & held_buttons) {
+			held_buttons = 0;
+			repeat_countdown = 0;
+		}
+	} else if(chord_countdown != 0) {
+		if(--chord_countdown == 0) {
+			finish_chord();
+		}
+	} else if(repeat_countdown != 0) {
+		if(--repeat_countdown == 0) {
+			queue_event(BUTTON_EVENT_REPEAT, held_buttons, get_clock_ticks());
+			repeat_countdown = REPEAT_DELAY;
+		}
 	}
-	return return_value;
 }
 
-// Interrupt handler for a change on buttons
-ISR(PCINT1_vect) {
-	// Get the current state of the buttons. We'll compare this with
-	// the last state to see what has changed.
-	uint8_t button_state = PINB & 0x0F;
-	
-	// If there is room in the queue:
-	if(queue_length < BUTTON_QUEUE_SIZE) {
-		// If the button state matches one of the specified single-button states,
-		// add this button to the queue and start repeating
-		switch (button_state) {
-			case BUTTON_B0:
-				button_queue[queue_length++] = 0;
-				button_repeat_time = get_clock_ticks() + INIT_DELAY;
-				break;
-			case BUTTON_B1:
-				button_queue[queue_length++] = 1;
-				button_repeat_time = get_clock_ticks() + INIT_DELAY;
-				break;
-			case BUTTON_B2:
-				button_queue[queue_length++] = 2;
-				button_repeat_time = get_clock_ticks() + INIT_DELAY;
-				break;
-			case BUTTON_B3:
-				button_queue[queue_length++] = 3;
-				button_repeat_time = get_clock_ticks() + INIT_DELAY;
-				break;
-			default:
-				button_repeat_time = 0;
+
+/* HELPER FUNCTIONS */
+// Add an event to the queue, if there's room and we're active
+static void queue_event(uint8_t type, uint8_t buttons, uint32_t time) {
+	if(!buttons_active) {
+		return;
+	}
+	uint8_t next_head = (queue_head + 1) & (BUTTON_QUEUE_SIZE - 1);
+	if(next_head == queue_tail) {
+		// Full
+		if(events_dropped < 0xFFFF) {
+			events_dropped++;
 		}
-		
+		return;
+	}
+	event_queue[queue_head].type = type;
+	event_queue[queue_head].buttons = buttons;
+	event_queue[queue_head].time = time;
+	queue_head = next_head;
+}
+
+// Report the buttons collected for this chord, and start repeating
+// them if they're all still held
+static void finish_chord(void) {
+	if(chord_buttons & (chord_buttons - 1)) {
+		// More than one button
+		queue_event(BUTTON_EVENT_CHORD, chord_buttons, chord_time);
+	} else {
+		queue_event(BUTTON_EVENT_PRESS, chord_buttons, chord_time);
+	}
+	chord_countdown = 0;
+	if((button_state & chord_buttons) == chord_buttons) {
+		held_buttons = chord_buttons;
+		repeat_countdown = INIT_DELAY;
 	}
-	
-	// Remember this button state
-	last_button_state = button_state;
 }
\ No newline at end of file
@@ -4,12 +4,17 @@
  * Author: Peter Sutton
  * Edited: Sean Manson
  *
- * We assume four push buttons (B0 to B3) are connected to pins B0 to B3. We configure
- * pin change interrupts on these pins.
+ * We assume four push buttons (B0 to B3) are connected to pins B0 to B3.
+ * These pins are sampled every millisecond (from the timer 0 interrupt) and
+ * debounced, and changes are turned into events in a small queue.
  *
- * These buttons can also be repeated at certain intervals after this interrupt fires
- * by being continually held down.
- */ 
+ * Buttons pushed within CHORD_WINDOW milliseconds of each other are reported
+ * together as a single chord event, so that combinations (e.g. B2 and B3 for
+ * a diagonal movement) can be used.
+ *
+ * These buttons (or chords) can also be repeated at certain intervals by
+ * being continually held down.
+ */
 
 
 #ifndef BUTTONS_H_
@@ -17,32 +22,70 @@
 
 #include <stdint.h>
 
-/* Set up pin change interrupts on pins B0 to B3.
- * This function disables and reenables interrupts as necessary.
+// Bit masks for each button
+#define BUTTON_B0 1
+#define BUTTON_B1 2
+#define BUTTON_B2 4
+#define BUTTON_B3 8
+
+// Event types
+#define BUTTON_EVENT_PRESS 0 // A single button was pushed
+#define BUTTON_EVENT_CHORD 1 // More than one button was pushed together
+#define BUTTON_EVENT_REPEAT 2 // The last button or chord is still held
+#define BUTTON_EVENT_RELEASE 3 // A button was let go
+
+// Number of samples (milliseconds) a button must be steadily up or down
+// for before it is considered to have changed
+#define DEBOUNCE_SAMPLES 5
+
+// Time (ms) after a button is pushed in which any other buttons pushed
+// are counted as part of a chord
+#define CHORD_WINDOW 20
+
+// A button event. buttons is the mask of buttons involved and time is
+// the clock tick at which the (first) button changed.
+typedef struct {
+	uint8_t type;
+	uint8_t buttons;
+	uint32_t time;
+} ButtonEvent;
+
+/* Set up the button sampling and empty the event queue.
  */
-void init_button_interrupts(void);
+void init_buttons(void);
+
+/* Take the next event off the queue. Returns 0 if there are no events
+ * waiting, or 1 if an event was copied into the given structure.
+ * (A small queue of events is kept. This function should be called
+ * frequently enough to ensure it does not overflow - if it does, the
+ * newest events are discarded and counted.)
+ */
+uint8_t get_button_event(ButtonEvent* event);
 
 /* Return the last button pushed (0 to 3) or -1 if there are no
- * button pushes to return. (A small queue of button pushes is
- * kept. This function should be called frequently enough to
- * ensure the queue does not overflow. Excess button pushes are
- * discarded.)
+ * button pushes to return. Releases and repeats are discarded. For
+ * a chord, the lowest numbered button in it is returned.
  */
 int8_t button_pushed(void);
 
-/* Activate/deactivate the button functionality as desired.
+/* Discard any events waiting in the queue.
+ */
+void clear_button_events(void);
+
+/* Returns the number of events which have been discarded because the
+ * queue was full.
+ */
+uint16_t get_button_events_dropped(void);
+
+/* Activate/deactivate the button functionality as desired. Buttons are
+ * still debounced while deactivated but no events are queued.
  */
 void activate_buttons(void);
 void deactivate_buttons(void);
 
-/* Returns whether the last held arrangement of buttons should be repeated, taking
- * into account the time since the last button movement.
- *
- * The value returned is -1 if no buttons should repeat, and n if Bn should repeat.
- *
- * Note that to make sense, this function should be run more frequently than the delay
- * time between movements.
+/* Sample and debounce the buttons. Called from the timer 0 interrupt
+ * handler every millisecond.
  */
-int8_t should_button_repeat(void);
+void button_timer_tick(void);
 
 #endif /* BUTTONS_H_ */
\ No newline at end of file
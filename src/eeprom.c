@@ -2,15 +2,20 @@
  * eeprom.c
  *
  * Author: Sean Manson
- */ 
+ */
 
 #include "eeprom.h"
+#include "eestore.h"
 
 #include <string.h>
 #include <stdio.h>
 
+#include <avr/io.h>
+#include <avr/interrupt.h>
 #include <avr/eeprom.h>
+#include <util/crc16.h>
 
+// Old fixed layout, only read to import data saved by older versions
 #define EEPROM_SIGNATURE 8
 #define EEPROM_SIGNATURE_LENGTH 8
 #define EEPROM_NAMES 16
@@ -19,84 +24,288 @@
 #define EEPROM_SCORES_LENGTH 10
 #define EEPROM_LEVELS 131
 #define EEPROM_LEVELS_LENGTH 5
+#define EEPROM_CALIBRATION 136
+#define EEPROM_CALIBRATION_LENGTH 12
+#define EEPROM_CALIBRATION_CHECKSUM 148
 
-static char highscore_names[HIGHSCORES_TO_STORE][HIGHSCORE_NAME_LENGTH+1];
-static uint16_t highscore_scores[HIGHSCORES_TO_STORE];
-static uint8_t highscore_levels[HIGHSCORES_TO_STORE];
+// Keys and versions of the records kept in the store. The version
+// should be increased whenever the layout of the record changes.
+// Each highscore slot has its own key, from KEY_HIGHSCORE_FIRST.
+#define KEY_HIGHSCORE_TABLE 0
+#define KEY_CALIBRATION 1
+#define KEY_SETTINGS 2
+#define KEY_HIGHSCORE_FIRST 8
+#define HIGHSCORE_TABLE_VERSION 1
+#define HIGHSCORE_VERSION 1
+#define CALIBRATION_VERSION 1
+#define SETTINGS_VERSION 1
+
+// The whole highscore table, as saved by earlier versions
+#define TABLE_HIGHSCORES 5
+#define TABLE_NAME_LENGTH 21
+typedef struct {
+	char names[TABLE_HIGHSCORES][TABLE_NAME_LENGTH+1];
+	uint16_t scores[TABLE_HIGHSCORES];
+	uint8_t levels[TABLE_HIGHSCORES];
+} HighscoreTable;
+
+// Layout of a highscore record
+#define RECORD_SCORE 0
+#define RECORD_LEVEL 2
+#define RECORD_DATE 3
+#define RECORD_NAME 5
+
+// Most EEPROM the records can take up: every highscore slot with a name
+// as long as it can be, the calibration, the settings and the (emptied)
+// old table. At least EEPROM_SPARE bytes must be left over, for records
+// to be written before the ones they replace are freed and for the gaps
+// between records.
+#define EEPROM_MOST_USED (HIGHSCORES_TO_STORE * EESTORE_RECORD_SIZE(RECORD_NAME + HIGHSCORE_NAME_LENGTH) \
+		+ EESTORE_RECORD_SIZE(EEPROM_CALIBRATION_LENGTH) + EESTORE_RECORD_SIZE(2) + EESTORE_RECORD_SIZE(0))
+#define EEPROM_SPARE 128
+#if EEPROM_MOST_USED + EEPROM_SPARE > E2END + 1
+#error "The highscores can't all fit in the EEPROM"
+#endif
+
+// A highscore in the table. slot is where it is kept in the EEPROM.
+typedef struct {
+	uint16_t score;
+	uint16_t date;
+	uint8_t level;
+	uint8_t slot;
+} Highscore;
+
+// The highscores, highest first, and the names of the top few
+static Highscore highscores[HIGHSCORES_TO_STORE];
+static uint8_t num_highscores;
+static char highscore_names[HIGHSCORES_TO_SHOW][HIGHSCORE_NAME_LENGTH+1];
+
+// Slots which are in use, slots which have changed since they were
+// last saved, and slots whose record is waiting to be written (one bit
+// each). A slot stays dirty until its record has been written, which
+// highscore_written() is told about from the EEPROM interrupt.
+static uint32_t used_slots;
+static volatile uint32_t dirty_slots;
+static volatile uint32_t queued_slots;
+
+// The last score added (in case it is too low for its name to be kept
+// with the others)
+static char last_name[HIGHSCORE_NAME_LENGTH+1];
+static uint8_t last_slot;
+
+// The settings are kept in RAM too, so they can be looked up without
+// waiting for any writes to finish
+static GameSettings settings;
+
+// Whether the settings or calibration still have to be saved, as the
+// store had no room for them yet (see update_eeprom())
+static uint8_t settings_unsaved;
+static uint8_t calibration_unsaved;
+static JoystickCalibration unsaved_calibration;
 static const char signature[8] = "Twigged";
 
+static int8_t add_highscore(const char* name, uint16_t score, uint8_t level, uint16_t date, uint8_t slot);
+static int8_t find_rank(uint16_t score, uint16_t date);
+static void highscore_written(uint8_t key);
+static void change_slot_bits(volatile uint32_t* bits, uint32_t set, uint32_t clear);
+
 void init_highscores(void) {
-	uint8_t x;
-	for (x = 0; x < HIGHSCORES_TO_STORE; x++) {
-		strcpy(highscore_names[x], "---");
-		highscore_scores[x] = 0;
-		highscore_levels[x] = 0;
-	}
+	num_highscores = 0;
+	used_slots = 0;
+	dirty_slots = 0;
+	queued_slots = 0;
+	last_slot = HIGHSCORES_TO_STORE;
 }
 
 void load_highscores_eeprom(void) {
-	if (test_signature()) {
-		// Load names
-		eeprom_read_block((void*)&highscore_names, (const void*)EEPROM_NAMES, EEPROM_NAMES_LENGTH);
-		// Load scores
-		eeprom_read_block((void*)&highscore_scores, (const void*)EEPROM_SCORES, EEPROM_SCORES_LENGTH);
-		// Load levels
-		eeprom_read_block((void*)&highscore_levels, (const void*)EEPROM_LEVELS, EEPROM_LEVELS_LENGTH);
-		printf(highscore_names[0]);
-	} else {
-		prepare_signature();
-		save_highscores_eeprom();
+	uint8_t record[RECORD_NAME + HIGHSCORE_NAME_LENGTH];
+	char name[HIGHSCORE_NAME_LENGTH+1];
+	GameSettings stored_settings;
+	uint8_t version, length, slot;
+
+	// Find the current records, bringing across anything saved in the
+	// old layout first
+	init_eestore();
+	import_old_eeprom();
+
+	settings.games_played = 0;
+	if (eestore_read(KEY_SETTINGS, &version, &stored_settings, sizeof(stored_settings)) == sizeof(stored_settings)
+			&& version == SETTINGS_VERSION) {
+		settings = stored_settings;
+	}
+
+	// Load each highscore slot
+	for (slot = 0; slot < HIGHSCORES_TO_STORE; slot++) {
+		length = eestore_read(KEY_HIGHSCORE_FIRST + slot, &version, record, sizeof(record));
+		if (length < RECORD_NAME || version != HIGHSCORE_VERSION) {
+			continue;
+		}
+		length -= RECORD_NAME;
+		if (length > HIGHSCORE_NAME_LENGTH) {
+			length = HIGHSCORE_NAME_LENGTH;
+		}
+		memcpy(name, &record[RECORD_NAME], length);
+		name[length] = 0;
+		if (add_highscore(name, record[RECORD_SCORE] | (record[RECORD_SCORE+1] << 8),
+				record[RECORD_LEVEL], record[RECORD_DATE] | (record[RECORD_DATE+1] << 8), slot) != -1) {
+			used_slots |= (uint32_t)1 << slot;
+		}
+	}
+	if (num_highscores == 0) {
+		import_highscore_table();
 	}
 }
 
 void save_highscores_eeprom(void) {
-	// Save names
-	eeprom_update_block((const void*)&highscore_names, (void*)EEPROM_NAMES, EEPROM_NAMES_LENGTH);
-	// Save scores
-	eeprom_update_block((const void*)&highscore_scores, (void*)EEPROM_SCORES, EEPROM_SCORES_LENGTH);
-	// Save levels
-	eeprom_update_block((const void*)&highscore_levels, (void*)EEPROM_LEVELS, EEPROM_LEVELS_LENGTH);
+	uint8_t record[RECORD_NAME + HIGHSCORE_NAME_LENGTH];
+	const char* name;
+	uint8_t rank, slot, length;
+	uint32_t bit;
+
+	// Write out each highscore which has changed (and isn't already on
+	// its way)
+	for (rank = 0; rank < num_highscores && dirty_slots; rank++) {
+		slot = highscores[rank].slot;
+		bit = (uint32_t)1 << slot;
+		if (!(dirty_slots & bit) || (queued_slots & bit)) {
+			continue;
+		}
+		if (rank < HIGHSCORES_TO_SHOW) {
+			name = highscore_names[rank];
+		} else if (slot == last_slot) {
+			name = last_name;
+		} else {
+			// We no longer know its name, but the score still has to be
+			// saved (the slot may have held a score which has been
+			// pushed out of the table)
+			name = "";
+		}
+		length = strlen(name);
+		record[RECORD_SCORE] = highscores[rank].score & 0xFF;
+		record[RECORD_SCORE+1] = highscores[rank].score >> 8;
+		record[RECORD_LEVEL] = highscores[rank].level;
+		record[RECORD_DATE] = highscores[rank].date & 0xFF;
+		record[RECORD_DATE+1] = highscores[rank].date >> 8;
+		memcpy(&record[RECORD_NAME], name, length);
+		// (Marked as queued first, as the callback can come straight away)
+		change_slot_bits(&queued_slots, bit, 0);
+		if (!eestore_write(KEY_HIGHSCORE_FIRST + slot, HIGHSCORE_VERSION, record,
+				RECORD_NAME + length, highscore_written)) {
+			change_slot_bits(&queued_slots, 0, bit);
+		}
+	}
 }
 
-// Finds an appropriate place to insert this score, shifting all others downwards.
-int8_t get_appropriate_index(uint16_t score) {
-	uint8_t x;
-	for (x = 0; x < HIGHSCORES_TO_STORE; x++) {
-		if (score >= highscore_scores[x]) {
-			shift_values_after(x);
-			return x;
+int8_t get_highscore_rank(uint16_t score) {
+	return find_rank(score, settings.games_played);
+}
+
+int8_t insert_highscore(const char* new_name, uint16_t new_score, uint8_t new_level) {
+	uint8_t slot;
+	int8_t rank;
+
+	if (find_rank(new_score, settings.games_played) == -1) {
+		return -1;
+	}
+
+	// Use a free slot, or take over the slot of the lowest score
+	if (num_highscores < HIGHSCORES_TO_STORE) {
+		for (slot = 0; used_slots & ((uint32_t)1 << slot); slot++) {
+			;
 		}
+	} else {
+		slot = highscores[HIGHSCORES_TO_STORE-1].slot;
 	}
-	
-	return -1;
+
+	rank = add_highscore(new_name, new_score, new_level, settings.games_played, slot);
+	used_slots |= (uint32_t)1 << slot;
+	change_slot_bits(&dirty_slots, (uint32_t)1 << slot, 0);
+	strcpy(last_name, new_name);
+	last_slot = slot;
+	return rank;
+}
+
+const char* get_highscore_name(uint8_t rank) {
+	if (rank >= num_highscores || rank >= HIGHSCORES_TO_SHOW) {
+		return "---";
+	}
+	return highscore_names[rank];
 }
 
-void set_highscore(uint8_t index, const char* new_name, uint16_t new_score, uint8_t new_level) {
-	strcpy(highscore_names[index], new_name);
-	highscore_scores[index] = new_score;
-	highscore_levels[index] = new_level;
+uint16_t get_highscore_score(uint8_t rank) {
+	if (rank >= num_highscores) {
+		return 0;
+	}
+	return highscores[rank].score;
 }
 
-const char* get_highscore_name(uint8_t index) {
-	return highscore_names[index];
+uint8_t get_highscore_level(uint8_t rank) {
+	if (rank >= num_highscores) {
+		return 0;
+	}
+	return highscores[rank].level;
 }
 
-uint16_t get_highscore_score(uint8_t index) {
-	return highscore_scores[index];
+uint16_t get_highscore_date(uint8_t rank) {
+	if (rank >= num_highscores) {
+		return 0;
+	}
+	return highscores[rank].date;
 }
 
-uint8_t get_highscore_level(uint8_t index) {
-	return highscore_levels[index];
+
+uint8_t load_calibration_eeprom(JoystickCalibration* calibration) {
+	JoystickCalibration stored;
+	uint8_t version;
+
+	// Only use this if it's the current layout and the values make sense
+	if (eestore_read(KEY_CALIBRATION, &version, &stored, sizeof(stored)) != sizeof(stored)
+			|| version != CALIBRATION_VERSION || !is_joystick_calibration_valid(&stored)) {
+		return 0;
+	}
+	*calibration = stored;
+	return 1;
+}
+
+void save_calibration_eeprom(const JoystickCalibration* calibration) {
+	unsaved_calibration = *calibration;
+	calibration_unsaved = !eestore_write(KEY_CALIBRATION, CALIBRATION_VERSION,
+			&unsaved_calibration, sizeof(JoystickCalibration), 0);
+}
+
+
+void load_settings_eeprom(GameSettings* new_settings) {
+	*new_settings = settings;
+}
+
+void save_settings_eeprom(const GameSettings* new_settings) {
+	settings = *new_settings;
+	settings_unsaved = !eestore_write(KEY_SETTINGS, SETTINGS_VERSION, &settings, sizeof(settings), 0);
+}
+
+
+void update_eeprom(void) {
+	eestore_update();
+	if (settings_unsaved) {
+		settings_unsaved = !eestore_write(KEY_SETTINGS, SETTINGS_VERSION, &settings, sizeof(settings), 0);
+	}
+	if (calibration_unsaved) {
+		calibration_unsaved = !eestore_write(KEY_CALIBRATION, CALIBRATION_VERSION,
+				&unsaved_calibration, sizeof(JoystickCalibration), 0);
+	}
+	if (dirty_slots) {
+		save_highscores_eeprom();
+	}
 }
 
 
 /* HELPER FUNCTIONS */
 uint8_t test_signature(void) {
-	char eeprom_string[6];
+	char eeprom_string[EEPROM_SIGNATURE_LENGTH];
 	uint8_t x;
-	
+
 	eeprom_read_block((void*)&eeprom_string, (const void*)EEPROM_SIGNATURE, EEPROM_SIGNATURE_LENGTH);
-	
+
 	for (x = 0; x < EEPROM_SIGNATURE_LENGTH; x++) {
 		if (signature[x] != eeprom_string[x]) {
 			return 0;
@@ -105,15 +314,144 @@ uint8_t test_signature(void) {
 	return 1;
 }
 
-void prepare_signature(void) {
-	eeprom_update_block((const void*)&signature, (void*)EEPROM_SIGNATURE, EEPROM_SIGNATURE_LENGTH);
+void import_old_eeprom(void) {
+	HighscoreTable old_highscores;
+	JoystickCalibration old_calibration;
+	uint8_t version;
+
+	if (!test_signature()) {
+		return;
+	}
+
+	// Copy across anything which isn't in the store yet. (If the power
+	// went off partway through doing this last time, some of it will
+	// already be there.)
+	if (!eestore_read(KEY_HIGHSCORE_TABLE, &version, &old_highscores, 0)) {
+		memset(&old_highscores, 0, sizeof(old_highscores));
+		eeprom_read_block((void*)&old_highscores.names, (const void*)EEPROM_NAMES, EEPROM_NAMES_LENGTH);
+		eeprom_read_block((void*)&old_highscores.scores, (const void*)EEPROM_SCORES, EEPROM_SCORES_LENGTH);
+		eeprom_read_block((void*)&old_highscores.levels, (const void*)EEPROM_LEVELS, EEPROM_LEVELS_LENGTH);
+		if (!eestore_write(KEY_HIGHSCORE_TABLE, HIGHSCORE_TABLE_VERSION, &old_highscores, sizeof(old_highscores), 0)) {
+			return;
+		}
+	}
+	if (!eestore_read(KEY_CALIBRATION, &version, &old_calibration, 0)) {
+		eestore_flush();
+		eeprom_read_block((void*)&old_calibration, (const void*)EEPROM_CALIBRATION, EEPROM_CALIBRATION_LENGTH);
+		if (eeprom_read_byte((const uint8_t*)EEPROM_CALIBRATION_CHECKSUM) == get_calibration_checksum(&old_calibration)
+				&& is_joystick_calibration_valid(&old_calibration)) {
+			if (!eestore_write(KEY_CALIBRATION, CALIBRATION_VERSION, &old_calibration, sizeof(old_calibration), 0)) {
+				return;
+			}
+		}
+	}
+
+	// Everything is in the store now, so the old layout is no longer
+	// needed. (We wait until it's definitely all been written first.)
+	eestore_flush();
+	eeprom_update_byte((uint8_t*)EEPROM_SIGNATURE, 0xFF);
+}
+
+// Bring across the whole highscore table saved by earlier versions,
+// then replace it with an empty record so it no longer takes up space
+void import_highscore_table(void) {
+	HighscoreTable table;
+	uint8_t version, x;
+
+	if (eestore_read(KEY_HIGHSCORE_TABLE, &version, &table, sizeof(table)) != sizeof(table)
+			|| version != HIGHSCORE_TABLE_VERSION) {
+		return;
+	}
+	// (Going from the bottom up keeps equal scores in the same order)
+	for (x = TABLE_HIGHSCORES; x-- > 0; ) {
+		if (table.scores[x] != 0 || table.levels[x] != 0) {
+			table.names[x][HIGHSCORE_NAME_LENGTH] = 0;
+			insert_highscore(table.names[x], table.scores[x], table.levels[x]);
+		}
+	}
+	save_highscores_eeprom();
+	eestore_flush();
+	if (!dirty_slots) {
+		eestore_write(KEY_HIGHSCORE_TABLE, HIGHSCORE_TABLE_VERSION, &table, 0, 0);
+	}
 }
 
-void shift_values_after(uint8_t index_to_shift) {
+// Put a highscore into the table in order, returning its rank (or -1
+// if the table is full and it's lower than everything in it). The
+// score at the bottom is dropped if the table is full.
+static int8_t add_highscore(const char* name, uint16_t score, uint8_t level, uint16_t date, uint8_t slot) {
+	int8_t rank = find_rank(score, date);
 	uint8_t x;
-	for (x = HIGHSCORES_TO_STORE-1; x > index_to_shift; x--) {
-		strcpy(highscore_names[x], highscore_names[x-1]);
-		highscore_scores[x] = highscore_scores[x-1];
-		highscore_levels[x] = highscore_levels[x-1];
+
+	if (rank == -1) {
+		return -1;
+	}
+	if (num_highscores < HIGHSCORES_TO_STORE) {
+		num_highscores++;
+	}
+
+	// Move everything below down a place
+	for (x = num_highscores-1; x > rank; x--) {
+		highscores[x] = highscores[x-1];
+		if (x < HIGHSCORES_TO_SHOW) {
+			strcpy(highscore_names[x], highscore_names[x-1]);
+		}
+	}
+	highscores[rank].score = score;
+	highscores[rank].level = level;
+	highscores[rank].date = date;
+	highscores[rank].slot = slot;
+	if (rank < HIGHSCORES_TO_SHOW) {
+		strcpy(highscore_names[rank], name);
+	}
+	return rank;
+}
+
+// Finds where a score would go in the table. Scores are ordered from
+// highest to lowest, with equal scores ordered newest first.
+static int8_t find_rank(uint16_t score, uint16_t date) {
+	uint8_t x;
+	for (x = 0; x < num_highscores; x++) {
+		if (score > highscores[x].score ||
+				(score == highscores[x].score && date >= highscores[x].date)) {
+			return x;
+		}
+	}
+	if (num_highscores < HIGHSCORES_TO_STORE) {
+		return num_highscores;
 	}
-}
\ No newline at end of file
+	return -1;
+}
+
+// Called once a highscore record has been written: from the EEPROM
+// interrupt, or straight away (with interrupts on) if the record hadn't
+// changed. The interrupt can finish another slot at any time, so the
+// bits are changed with change_slot_bits() either way.
+static void highscore_written(uint8_t key) {
+	uint32_t bit = (uint32_t)1 << (key - KEY_HIGHSCORE_FIRST);
+	if (queued_slots & bit) {
+		change_slot_bits(&dirty_slots, 0, bit);
+		change_slot_bits(&queued_slots, 0, bit);
+	}
+}
+
+// Set and clear bits of dirty_slots or queued_slots, which are also
+// changed by highscore_written(). Safe to use from interrupt handlers.
+static void change_slot_bits(volatile uint32_t* bits, uint32_t set, uint32_t clear) {
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	*bits = (*bits | set) & ~clear;
+	if(interruptsOn) {
+		sei();
+	}
+}
+
+uint8_t get_calibration_checksum(const JoystickCalibration* calibration) {
+	const uint8_t* data = (const uint8_t*)calibration;
+	uint8_t crc = 0;
+	uint8_t x;
+	for (x = 0; x < EEPROM_CALIBRATION_LENGTH; x++) {
+		crc = _crc_ibutton_update(crc, data[x]);
+	}
+	return crc;
+}
@@ -3,40 +3,98 @@
  *
  * Author: Sean Manson
  *
- * EEPROM code for loading and saving highscores.
+ * EEPROM code for loading and saving highscores, the joystick
+ * calibration and the game settings.
  *
- * This game uses 128 bytes of EEPROM, starting at address 8:
- *    - 8 bytes of signature
- *    - 5 * 21 bytes for a name
+ * Each of these is kept as a versioned record in the log-structured
+ * store (see eestore.h), which spreads writes across the whole EEPROM
+ * and recovers the last good copy if the power goes off mid-write.
+ *
+ * Each highscore has a record of its own, in one of HIGHSCORES_TO_STORE
+ * slots which never move. A record is packed as:
+ *    - 2 bytes score
+ *    - 1 byte level
+ *    - 2 bytes date (the number of games which had been played)
+ *    - the name, without a terminator
+ * so each takes 12-24 bytes of EEPROM. Even with every name as long as
+ * it can be, all of the slots take 720 bytes, leaving room in the 1 KB
+ * EEPROM for the other records and for records being replaced. The
+ * ranking is kept in RAM, so adding a score only writes the record for
+ * the slot it goes into (the slot of the lowest score, once the table
+ * is full). Only the names of the top HIGHSCORES_TO_SHOW scores (and
+ * the last one added) are kept in RAM; a score which has lost its name
+ * is saved without one.
+ *
+ * Older versions of the game used 141 bytes of EEPROM at fixed
+ * addresses, starting at address 8:
+ *    - 8 bytes of signature ("Twigged")
+ *    - 5 * 21 bytes for a name (longer than names are now - they
+ *      are cut short when imported)
  *    - 5 * 2 bytes for a score
  *    - 5 * 1 byte for a level
- *
- */ 
+ *    - 12 bytes of joystick calibration
+ *    - 1 byte checksum (CRC-8) of the joystick calibration
+ * If the signature is found, this data is copied into the store and
+ * the signature cleared.
+ */
 
 
 #ifndef EEPROM_H_
 #define EEPROM_H_
 
 #include <stdint.h>
+#include "joystick.h"
+
+#define HIGHSCORES_TO_STORE 30
+#define HIGHSCORES_TO_SHOW 10
+#define HIGHSCORE_NAME_LENGTH 12
 
-#define HIGHSCORES_TO_STORE 5
-#define HIGHSCORE_NAME_LENGTH 21
+// Settings kept between games
+typedef struct {
+	uint16_t games_played;
+} GameSettings;
 
+// Highscores. load_highscores_eeprom() must be called before any
+// other function here which uses the EEPROM.
 void init_highscores(void);
 void load_highscores_eeprom(void);
 void save_highscores_eeprom(void);
 
-int8_t get_appropriate_index(uint16_t score);
+// Returns the rank (from 0) a score would take in the table, or -1 if
+// it isn't high enough. Nothing is changed until insert_highscore().
+int8_t get_highscore_rank(uint16_t score);
+
+// Add a score to the table, returning its rank (or -1 if it isn't
+// high enough). It is saved by the next save_highscores_eeprom().
+int8_t insert_highscore(const char* new_name, uint16_t new_score, uint8_t new_level);
+
+// Details of the score at a given rank. Names are only available for
+// the top HIGHSCORES_TO_SHOW.
+const char* get_highscore_name(uint8_t rank);
+uint16_t get_highscore_score(uint8_t rank);
+uint8_t get_highscore_level(uint8_t rank);
+uint16_t get_highscore_date(uint8_t rank);
+
+// Joystick calibration. Loading returns 0 (and leaves the calibration
+// untouched) if no valid calibration has been saved.
+uint8_t load_calibration_eeprom(JoystickCalibration* calibration);
+void save_calibration_eeprom(const JoystickCalibration* calibration);
 
-void set_highscore(uint8_t index, const char* new_name, uint16_t new_score, uint8_t new_level);
+// Settings. These are read from the EEPROM along with the highscores;
+// loading gives the defaults if none have been saved.
+void load_settings_eeprom(GameSettings* settings);
+void save_settings_eeprom(const GameSettings* settings);
 
-const char* get_highscore_name(uint8_t index);
-uint16_t get_highscore_score(uint8_t index);
-uint8_t get_highscore_level(uint8_t index);
+// Saving can have to wait while the free space in the EEPROM is gathered
+// together (see eestore.h). This carries that on and saves anything
+// which had to wait, so it should be called regularly, e.g. each time
+// around the game loop.
+void update_eeprom(void);
 
 // Helper
 uint8_t test_signature(void);
-void prepare_signature(void);
-void shift_values_after(uint8_t index_to_shift);
+void import_old_eeprom(void);
+void import_highscore_table(void);
+uint8_t get_calibration_checksum(const JoystickCalibration* calibration);
 
 #endif /* EEPROM_H_ */
\ No newline at end of file
@@ -0,0 +1,534 @@
+/*
+ * eestore.c
+ *
+ * Written by Sean Manson
+ *
+ * Log-structured record store in the EEPROM.
+ */
+
+#include "eestore.h"
+#include "bench.h"
+#include "stackcheck.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+// The log covers the whole EEPROM
+#define EESTORE_START 0
+#define EESTORE_END (E2END+1)
+
+// Where an empty store starts writing (after the old fixed layout)
+#define EESTORE_FIRST_WRITE 152
+
+// Record layout
+#define HEADER_KEY 0
+#define HEADER_VERSION 1
+#define HEADER_SEQUENCE 2
+#define HEADER_LENGTH 4
+#define HEADER_SIZE 5
+#define CRC_SIZE 2
+
+// Marks a key which has no record
+#define NO_RECORD 0xFFFF
+
+// Marks that no key was found
+#define NO_KEY 0xFF
+
+// Address and payload length of the current record for each key (the
+// last one queued, which may not have been written yet)
+static uint16_t current_record[EESTORE_MAX_KEYS];
+static uint8_t current_length[EESTORE_MAX_KEYS];
+
+// Address and payload length of the last record for each key which has
+// been completely written. This is what we'd fall back to after a power
+// loss, so it mustn't be written over until the record replacing it has
+// been written too. (Updated by the EEPROM interrupt.)
+static volatile uint16_t saved_record[EESTORE_MAX_KEYS];
+static volatile uint8_t saved_length[EESTORE_MAX_KEYS];
+
+// Where the next record will be written, and its sequence number
+static uint16_t write_address;
+static uint16_t next_sequence;
+
+// Set once eestore_lock() has been called
+static uint8_t locked;
+
+// Where the free space is being gathered up to (see compact_step()), or
+// NO_RECORD if it isn't being gathered
+static uint16_t compact_address;
+
+// Records waiting to be written. Each job is a run of bytes to write
+// to consecutive addresses, whose data is kept in order in the write
+// buffer. eestore_write() adds jobs and data at the heads of these
+// circular buffers and the EEPROM ready interrupt takes them from the
+// tails, so (as each end is only changed by one side) we don't need to
+// turn off interrupts to use them. EESTORE_JOBS must be a power of 2.
+#define EESTORE_JOBS 4
+#define WRITE_BUFFER_SIZE 160
+typedef struct {
+	uint16_t address; // where the next byte goes
+	uint8_t length; // bytes left to write
+	uint8_t key;
+	uint16_t record; // where the record starts
+	uint8_t record_length; // payload length of the record
+	EestoreCallback callback;
+} WriteJob;
+static volatile WriteJob jobs[EESTORE_JOBS];
+static volatile uint8_t jobs_head;
+static volatile uint8_t jobs_tail;
+static uint8_t write_buffer[WRITE_BUFFER_SIZE];
+static volatile uint8_t buffer_head;
+static volatile uint8_t buffer_tail;
+
+static uint16_t get_record_size(uint8_t length);
+static uint16_t check_record(uint16_t address, uint8_t* key, uint16_t* sequence);
+static uint8_t is_newer(uint16_t sequence, uint16_t than);
+static uint8_t is_same_record(uint16_t address, uint8_t version, const uint8_t* data, uint8_t length);
+static uint8_t find_space(uint16_t size);
+static uint8_t is_in_the_way(uint16_t start, uint8_t length, uint16_t size);
+static void compact_step(void);
+static void move_record(uint8_t key, uint16_t address);
+static void queue_job(uint8_t key, uint16_t address, uint8_t length, EestoreCallback callback);
+static uint8_t get_buffer_free(void);
+static void buffer_bytes(const uint8_t* data, uint8_t length);
+static void wait_for_writes(void);
+static void write_next_byte(void);
+
+void init_eestore(void) {
+	uint16_t sequences[EESTORE_MAX_KEYS];
+	uint16_t newest_sequence = 0;
+	uint16_t address, size, sequence;
+	uint8_t key;
+	uint8_t found = 0;
+
+	for (key = 0; key < EESTORE_MAX_KEYS; key++) {
+		current_record[key] = NO_RECORD;
+	}
+	write_address = EESTORE_FIRST_WRITE;
+	compact_address = NO_RECORD;
+	jobs_head = 0;
+	jobs_tail = 0;
+	buffer_head = 0;
+	buffer_tail = 0;
+
+	// Walk through the EEPROM a block at a time. Whenever we find a
+	// valid record we skip to the end of it.
+	address = EESTORE_START;
+	while (address < EESTORE_END) {
+		size = check_record(address, &key, &sequence);
+		if (size == 0) {
+			address += EESTORE_BLOCK;
+			continue;
+		}
+		if (current_record[key] == NO_RECORD || is_newer(sequence, sequences[key])) {
+			current_record[key] = address;
+			current_length[key] = eeprom_read_byte((const uint8_t*)(address + HEADER_LENGTH));
+			sequences[key] = sequence;
+		}
+		if (!found || is_newer(sequence, newest_sequence)) {
+			// Carry on writing after the most recent record
+			newest_sequence = sequence;
+			write_address = address + size;
+			found = 1;
+		}
+		address += size;
+	}
+
+	// Everything found has been written
+	for (key = 0; key < EESTORE_MAX_KEYS; key++) {
+		saved_record[key] = current_record[key];
+		saved_length[key] = current_length[key];
+	}
+	next_sequence = newest_sequence + 1;
+}
+
+uint8_t eestore_read(uint8_t key, uint8_t* version, void* data, uint8_t max_length) {
+	uint16_t address;
+	uint8_t length;
+
+	if (key >= EESTORE_MAX_KEYS || current_record[key] == NO_RECORD) {
+		return 0;
+	}
+	eestore_flush();
+	address = current_record[key];
+	*version = eeprom_read_byte((const uint8_t*)(address + HEADER_VERSION));
+	length = eeprom_read_byte((const uint8_t*)(address + HEADER_LENGTH));
+	eeprom_read_block(data, (const void*)(address + HEADER_SIZE),
+			length < max_length ? length : max_length);
+	return length;
+}
+
+uint8_t eestore_write(uint8_t key, uint8_t version, const void* data, uint8_t length,
+		EestoreCallback callback) {
+	uint8_t header[HEADER_SIZE];
+	uint8_t crc_bytes[CRC_SIZE];
+	uint16_t crc = 0xFFFF;
+	uint16_t size = get_record_size(length);
+	uint8_t x;
+
+	if (locked || key >= EESTORE_MAX_KEYS || length > EESTORE_MAX_LENGTH) {
+		return 0;
+	}
+
+	// Make sure the data hasn't been corrupted by the stack before it's
+	// saved (this halts if it could have been)
+	check_stack();
+
+	// Don't wear out the EEPROM rewriting what's already there. (We can
+	// only check this if nothing is waiting to be written, as reading
+	// would otherwise have to wait.)
+	if (current_record[key] != NO_RECORD && !eestore_busy() &&
+			is_same_record(current_record[key], version, (const uint8_t*)data, length)) {
+		if (callback) {
+			callback(key);
+		}
+		return 1;
+	}
+
+	// Carry on gathering the free space together (if we are)
+	compact_step();
+
+	if (!find_space(size)) {
+		// There may be enough space, but in gaps too small for this. Start
+		// gathering it together; the record can be saved once it has been.
+		if (compact_address == NO_RECORD) {
+			compact_address = EESTORE_START;
+			compact_step();
+		}
+		return 0;
+	}
+
+	header[HEADER_KEY] = key;
+	header[HEADER_VERSION] = version;
+	header[HEADER_SEQUENCE] = next_sequence & 0xFF;
+	header[HEADER_SEQUENCE+1] = next_sequence >> 8;
+	header[HEADER_LENGTH] = length;
+	for (x = 0; x < HEADER_SIZE; x++) {
+		crc = _crc16_update(crc, header[x]);
+	}
+	for (x = 0; x < length; x++) {
+		crc = _crc16_update(crc, ((const uint8_t*)data)[x]);
+	}
+
+	crc_bytes[0] = crc & 0xFF;
+	crc_bytes[1] = crc >> 8;
+
+	// Wait for room in the queue (only if lots is already waiting). A
+	// record being moved can take up most of the buffer, so rather than
+	// wait for one of those to be written we leave this until later.
+	while (((jobs_head + 1) & (EESTORE_JOBS - 1)) == jobs_tail ||
+			get_buffer_free() < HEADER_SIZE + length + CRC_SIZE) {
+		if (compact_address != NO_RECORD) {
+			return 0;
+		}
+		wait_for_writes();
+	}
+
+	// Queue the record, leaving the CRC until last so that it is only
+	// valid once everything else is there
+	buffer_bytes(header, HEADER_SIZE);
+	buffer_bytes((const uint8_t*)data, length);
+	buffer_bytes(crc_bytes, CRC_SIZE);
+	queue_job(key, write_address, length, callback);
+	write_address += size;
+	next_sequence++;
+	return 1;
+}
+
+void eestore_update(void) {
+	compact_step();
+}
+
+uint8_t eestore_busy(void) {
+	return jobs_head != jobs_tail;
+}
+
+void eestore_flush(void) {
+	while (eestore_busy()) {
+		wait_for_writes();
+	}
+	eeprom_busy_wait();
+}
+
+void eestore_lock(void) {
+	locked = 1;
+	eestore_flush();
+}
+
+
+/* HELPER FUNCTIONS */
+// Size taken up by a record with the given payload length
+static uint16_t get_record_size(uint8_t length) {
+	return EESTORE_RECORD_SIZE((uint16_t)length);
+}
+
+// Checks whether there is a valid record at the given address. If so,
+// returns its size and fills in its key and sequence number; otherwise
+// returns 0.
+static uint16_t check_record(uint16_t address, uint8_t* key, uint16_t* sequence) {
+	uint8_t header[HEADER_SIZE];
+	uint16_t crc = 0xFFFF;
+	uint16_t size, x;
+
+	if (address + HEADER_SIZE + CRC_SIZE > EESTORE_END) {
+		return 0;
+	}
+	eeprom_read_block(header, (const void*)address, HEADER_SIZE);
+	if (header[HEADER_KEY] >= EESTORE_MAX_KEYS || header[HEADER_LENGTH] > EESTORE_MAX_LENGTH) {
+		return 0;
+	}
+	size = get_record_size(header[HEADER_LENGTH]);
+	if (address + size > EESTORE_END) {
+		return 0;
+	}
+
+	for (x = 0; x < HEADER_SIZE; x++) {
+		crc = _crc16_update(crc, header[x]);
+	}
+	for (x = address + HEADER_SIZE; x < address + HEADER_SIZE + header[HEADER_LENGTH]; x++) {
+		crc = _crc16_update(crc, eeprom_read_byte((const uint8_t*)x));
+	}
+	if (crc != eeprom_read_word((const uint16_t*)x)) {
+		return 0;
+	}
+
+	*key = header[HEADER_KEY];
+	*sequence = header[HEADER_SEQUENCE] | (header[HEADER_SEQUENCE+1] << 8);
+	return size;
+}
+
+// Whether one sequence number is after another, allowing for them
+// wrapping around
+static uint8_t is_newer(uint16_t sequence, uint16_t than) {
+	return (int16_t)(sequence - than) > 0;
+}
+
+// Whether the record at the given address already holds this data
+static uint8_t is_same_record(uint16_t address, uint8_t version, const uint8_t* data, uint8_t length) {
+	uint8_t x;
+	if (eeprom_read_byte((const uint8_t*)(address + HEADER_VERSION)) != version ||
+			eeprom_read_byte((const uint8_t*)(address + HEADER_LENGTH)) != length) {
+		return 0;
+	}
+	for (x = 0; x < length; x++) {
+		if (eeprom_read_byte((const uint8_t*)(address + HEADER_SIZE + x)) != data[x]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Move write_address on until there are size bytes free from it which
+// don't overlap any current or saved record. Returns 0 if there is no
+// such space.
+static uint8_t find_space(uint16_t size) {
+	uint8_t wraps = 0;
+	uint8_t key, moved, length;
+	uint16_t start;
+
+	do {
+		// Wrap around to the start if we'd run off the end
+		if (write_address + size > EESTORE_END) {
+			if (++wraps > 1) {
+				return 0;
+			}
+			write_address = EESTORE_START;
+		}
+
+		// Skip past any record in the way
+		moved = 0;
+		for (key = 0; key < EESTORE_MAX_KEYS; key++) {
+			moved |= is_in_the_way(current_record[key], current_length[key], size);
+
+			// (The interrupt could update this half way through reading it)
+			uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+			cli();
+			start = saved_record[key];
+			length = saved_length[key];
+			if(interruptsOn) {
+				sei();
+			}
+			moved |= is_in_the_way(start, length, size);
+		}
+	} while (moved || write_address + size > EESTORE_END);
+	return 1;
+}
+
+// If the record at start (if any) overlaps the size bytes from
+// write_address, moves write_address to just after it and returns 1
+static uint8_t is_in_the_way(uint16_t start, uint8_t length, uint16_t size) {
+	uint16_t end;
+	if (start == NO_RECORD) {
+		return 0;
+	}
+	end = start + get_record_size(length);
+	if (start < write_address + size && write_address < end) {
+		write_address = end;
+		return 1;
+	}
+	return 0;
+}
+
+// Gather the free space together by moving records into the gaps before
+// them. Going up through the EEPROM from compact_address, each gap is
+// filled with the biggest record after it which fits (which can't
+// overlap where it is now), and gaps which nothing fits are left. One
+// record is moved each time this is called, once nothing is waiting to
+// be written (so every record is completely written, and the one before
+// has been moved).
+static void compact_step(void) {
+	uint16_t gap_end, start, size, best_size;
+	uint8_t key, next_key, best_key;
+
+	if (compact_address == NO_RECORD || locked || eestore_busy()) {
+		return;
+	}
+	while (1) {
+		// Find the end of the gap (the next record)
+		next_key = NO_KEY;
+		gap_end = EESTORE_END;
+		for (key = 0; key < EESTORE_MAX_KEYS; key++) {
+			start = current_record[key];
+			if (start != NO_RECORD && start >= compact_address && start < gap_end) {
+				gap_end = start;
+				next_key = key;
+			}
+		}
+		if (next_key == NO_KEY) {
+			// Everything after here is free
+			write_address = compact_address;
+			compact_address = NO_RECORD;
+			return;
+		}
+
+		best_key = NO_KEY;
+		best_size = 0;
+		for (key = 0; key < EESTORE_MAX_KEYS; key++) {
+			start = current_record[key];
+			size = get_record_size(current_length[key]);
+			if (start != NO_RECORD && start >= gap_end &&
+					size <= gap_end - compact_address && size > best_size) {
+				best_key = key;
+				best_size = size;
+			}
+		}
+		if (best_key == NO_KEY) {
+			// Nothing fits, so carry on after the record at the end
+			compact_address = gap_end + get_record_size(current_length[next_key]);
+		} else {
+			move_record(best_key, compact_address);
+			compact_address += best_size;
+			return;
+		}
+	}
+}
+
+// Queue a copy of the record for the given key, as it is, at an address
+// which doesn't overlap it. Nothing must be waiting to be written (so
+// the record is all there and the buffer has room for it).
+static void move_record(uint8_t key, uint16_t address) {
+	uint16_t from = current_record[key];
+	uint8_t length = current_length[key];
+	uint8_t x, data;
+
+	for (x = 0; x < HEADER_SIZE + length + CRC_SIZE; x++) {
+		data = eeprom_read_byte((const uint8_t*)(from + x));
+		buffer_bytes(&data, 1);
+	}
+	queue_job(key, address, length, 0);
+}
+
+// Queue the record just put in the write buffer, at the given address
+static void queue_job(uint8_t key, uint16_t address, uint8_t length, EestoreCallback callback) {
+	jobs[jobs_head].address = address;
+	jobs[jobs_head].length = HEADER_SIZE + length + CRC_SIZE;
+	jobs[jobs_head].key = key;
+	jobs[jobs_head].record = address;
+	jobs[jobs_head].record_length = length;
+	jobs[jobs_head].callback = callback;
+	jobs_head = (jobs_head + 1) & (EESTORE_JOBS - 1);
+
+	// Start writing when the EEPROM is ready
+	EECR |= (1<<EERIE);
+
+	// From now on this is the record which is read back, but the saved
+	// record is kept until the interrupt has written this one
+	current_record[key] = address;
+	current_length[key] = length;
+}
+
+// Free space in the write buffer. One byte is always left empty so
+// that a full buffer can be told apart from an empty one.
+static uint8_t get_buffer_free(void) {
+	uint8_t tail = buffer_tail;
+	if (tail > buffer_head) {
+		return tail - buffer_head - 1;
+	}
+	return WRITE_BUFFER_SIZE - 1 - (buffer_head - tail);
+}
+
+// Add bytes to the write buffer, which must have room for them
+static void buffer_bytes(const uint8_t* data, uint8_t length) {
+	uint8_t head = buffer_head;
+	while (length--) {
+		write_buffer[head] = *data++;
+		if (++head == WRITE_BUFFER_SIZE) {
+			head = 0;
+		}
+	}
+	buffer_head = head;
+}
+
+// Called while waiting for queued writes. If interrupts are off (e.g.
+// while starting up) the queue is worked through here instead.
+static void wait_for_writes(void) {
+	if (!bit_is_set(SREG, SREG_I) && !(EECR & (1<<EEPE))) {
+		write_next_byte();
+	}
+}
+
+// Write the next queued byte. The EEPROM must not be busy.
+static void write_next_byte(void) {
+	if (jobs_tail == jobs_head) {
+		EECR &= ~(1<<EERIE);
+		return;
+	}
+	volatile WriteJob* job = &jobs[jobs_tail];
+	uint8_t data = write_buffer[buffer_tail];
+	if (++buffer_tail == WRITE_BUFFER_SIZE) {
+		buffer_tail = 0;
+	}
+
+	// Only write bytes which have changed, to save wear
+	EEAR = job->address;
+	EECR |= (1<<EERE);
+	if (EEDR != data) {
+		EEDR = data;
+		EECR |= (1<<EEMPE);
+		EECR |= (1<<EEPE);
+	}
+	job->address++;
+
+	// Once the record is all there, it replaces the saved one (whose
+	// space can then be reused) and whoever saved it is told
+	if (--job->length == 0) {
+		EestoreCallback callback = job->callback;
+		uint8_t key = job->key;
+		saved_record[key] = job->record;
+		saved_length[key] = job->record_length;
+		jobs_tail = (jobs_tail + 1) & (EESTORE_JOBS - 1);
+		if (callback) {
+			callback(key);
+		}
+	}
+}
+
+ISR(EE_READY_vect) {
+	BENCH_BEGIN(BENCH_ISR_EEPROM);
+	// This interrupt fires whenever the EEPROM isn't busy, so we write
+	// one byte each time (and turn it off once there's nothing left).
+	write_next_byte();
+	BENCH_END(BENCH_ISR_EEPROM);
+}
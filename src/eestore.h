@@ -0,0 +1,113 @@
+/*
+ * eestore.h
+ *
+ * Author: Sean Manson
+ *
+ * A log-structured record store in the EEPROM.
+ *
+ * Rather than keeping each piece of data at a fixed address (which
+ * wears out the same few bytes and leaves half-written data behind if
+ * the power goes off mid-write), every save appends a new record to a
+ * log which wraps around the whole EEPROM. Each record holds:
+ *    - 1 byte key (what the record is, e.g. the highscores)
+ *    - 1 byte version (of the layout of the payload)
+ *    - 2 byte sequence number
+ *    - 1 byte payload length
+ *    - the payload
+ *    - 2 byte CRC-16 of all of the above
+ * and is padded out to a multiple of EESTORE_BLOCK bytes.
+ *
+ * When starting up, the EEPROM is scanned and the valid record with
+ * the highest sequence number for each key is taken as its current
+ * value. A record only becomes valid once its CRC has been written, so
+ * if the power goes off while saving we simply fall back to the last
+ * good record. The current record for each key is never overwritten,
+ * and nor is the last one completely written until the record replacing
+ * it has been; new records are written after the most recent one,
+ * skipping over any of these in the way.
+ *
+ * Records are written in the background, a byte at a time, from the
+ * EEPROM ready interrupt, so saving never holds up the game (each byte
+ * takes ~3.4ms to write). eestore_flush() waits for everything queued
+ * to be written; it must be called before the EEPROM is used directly,
+ * or before anything which could stop the interrupt from running (e.g.
+ * sleeping or halting). eestore_read() does this itself.
+ *
+ * As records are replaced, the free space ends up in gaps between the
+ * current records. If no gap is big enough for a new record, the records
+ * are moved into the gaps before them so that the free space is all
+ * together. Each is copied somewhere it doesn't overlap, so there is
+ * always a good copy. This is done in the background too, one record
+ * at a time from eestore_write() and eestore_update(); until it is
+ * done, records which don't fit aren't saved (eestore_write() returns 0
+ * and they should be saved again later).
+ *
+ * Bytes 8 to 151 held the old fixed layout, so a new store starts
+ * writing after these to allow that data to be imported first.
+ */
+
+#ifndef EESTORE_H_
+#define EESTORE_H_
+
+#include <stdint.h>
+
+// Number of different keys which can be stored
+#define EESTORE_MAX_KEYS 40
+
+// Longest payload which can be stored
+#define EESTORE_MAX_LENGTH 128
+
+// Records are aligned to blocks of this many bytes
+#define EESTORE_BLOCK 4
+
+// EEPROM taken up by a record with the given payload length (including
+// its 7 bytes of header and CRC)
+#define EESTORE_RECORD_SIZE(length) (((length) + 7 + EESTORE_BLOCK - 1) & ~(EESTORE_BLOCK - 1))
+
+// Called (from the EEPROM interrupt handler, or straight away if
+// nothing needs writing) once a record with the given key has been
+// completely written
+typedef void (*EestoreCallback)(uint8_t key);
+
+/* Scan the EEPROM for the current record of each key. Must be called
+ * before any of the functions below.
+ */
+void init_eestore(void);
+
+/* Copy the current record for the given key into data (at most
+ * max_length bytes of it) and its version into version. Returns the
+ * length of the stored payload, or 0 if there is no record.
+ */
+uint8_t eestore_read(uint8_t key, uint8_t* version, void* data, uint8_t max_length);
+
+/* Save a new record for the given key. The record is queued and
+ * written in the background; callback (if not NULL) is called once it
+ * has been. Nothing is written if it is the same as the current record.
+ * If the queue is full this waits for room (only if lots is already
+ * waiting). Returns 1 if successful, or 0 if there is no room for it in
+ * the EEPROM (yet - it may be once the free space has been gathered
+ * together, see above).
+ */
+uint8_t eestore_write(uint8_t key, uint8_t version, const void* data, uint8_t length,
+		EestoreCallback callback);
+
+/* Carry on gathering the free space together, if needed (see above).
+ * Should be called regularly, e.g. each time around the game loop.
+ */
+void eestore_update(void);
+
+/* Returns whether there are records still waiting to be written.
+ */
+uint8_t eestore_busy(void);
+
+/* Wait until all queued records have been written.
+ */
+void eestore_flush(void);
+
+/* Wait until all queued records have been written, then refuse any
+ * more: eestore_write() returns 0 from then on. Used when the data in
+ * memory can no longer be trusted (e.g. the stack has overflowed).
+ */
+void eestore_lock(void);
+
+#endif /* EESTORE_H_ */
@@ -9,37 +9,58 @@
 #include "ledmatrix.h"
 #include "pixel_colour.h"
 #include "sound.h"
+#include "latency.h"
+#include "bench.h"
+#include "patterns.h"
 #include <stdint.h>
 #include <stdlib.h>
 
 ///////////////////////////////// Global variables //////////////////////
-// frog_row and frog_column store the current position of the frog. Row 
-// numbers are from 0 to 7; column numbers are from 0 to 15. 
-static int8_t frog_row;
-static int8_t frog_column;
+// Number of frogs (one per player) on the field
+static uint8_t num_frogs = 1;
 
-// Boolean flag to indicate whether the frog is alive or not
-static uint8_t frog_alive;
+// game_frog_row and frog_column store the current position of each frog. Row 
+// numbers are from 0 to GAME_NUM_ROWS-1; column numbers are from 0 to
+// GAME_NUM_COLUMNS-1. 
+// (game_frog_row and game_frog_alive are declared in game.h.)
+int8_t game_frog_row[MAX_FROGS];
+static int8_t frog_column[MAX_FROGS];
+
+// Boolean flag to indicate whether each frog is alive or not
+uint8_t game_frog_alive[MAX_FROGS];
 
 // Vehicle data - 32 bits in each lane which we loop continuously. A 1
 // indicates the presence of a vehicle, 0 is empty.
-// Index 0 to 2 corresponds to lanes 1 to 3 respectively. Lanes 1 and 3
-// will move to the right; lane 2 will move to the left.
-#define LANE_DATA_WIDTH 32	// must be power of 2
-static uint32_t lane_data[3] = {
-		0b11000011000110001100000110011000,
-		0b00110000011000011000001100001100,
+// Index 0 to NUM_LANES-1 corresponds to rows 1 upwards. Lanes 1 and 3
+// will move to the right; lane 2 will move to the left (and so on).
+// These are the patterns until generate_game_patterns() is called. (The
+// long field has the same ones again.)
+#define LANE_DATA_WIDTH PATTERN_WIDTH	// must be power of 2
+#define DEFAULT_LANES \
+		0b11000011000110001100000110011000, \
+		0b00110000011000011000001100001100, \
 		0b00001111000011110000111100001111
+static uint32_t lane_data[NUM_LANES] = {
+		DEFAULT_LANES,
+#if NUM_LANES > 3
+		DEFAULT_LANES
+#endif
 };
 		
 // Log data - 32 bits for each log channel which we loop continuously.
 // A 1 indicates the presence of a log, 0 is empty.
-// Index 0 to 1 corresponds to rows 5 and 6 respectively. Row 5 will move
-// to the left; row 6 will move to the right
-#define LOG_DATA_WIDTH 32 // must be power of 2
-static uint32_t log_data[2] = {
-		0b11110001100111000111100011111000,
+// Index 0 to NUM_LOG_CHANNELS-1 corresponds to the rows above the halfway
+// row. The first will move to the left; the next to the right (and so on).
+#define LOG_DATA_WIDTH PATTERN_WIDTH // must be power of 2
+#define DEFAULT_LOGS \
+		0b11110001100111000111100011111000, \
 		0b11100110111101100001110110011100
+static uint32_t log_data[NUM_LOG_CHANNELS] = {
+		DEFAULT_LOGS,
+#if NUM_LOG_CHANNELS > 2
+		DEFAULT_LOGS, DEFAULT_LOGS,
+		0b11110001100111000111100011111000
+#endif
 };
 
 // Lane positions. The bit position (0 to 31) of the lane_data above that is
@@ -47,82 +68,139 @@ static uint32_t log_data[2] = {
 // 0 is the least significant bit.) For a lane position of N, the display
 // will show bits N to N+15 from left to right (wrapping around if N+15 
 // exceeds 31). 
-static int8_t lane_position[3];
+static int8_t lane_position[NUM_LANES];
 
 // Log positions. Same principle as lane positions.
-static int8_t log_position[2];
+static int8_t log_position[NUM_LOG_CHANNELS];
+
+// Time each lane and log channel takes to move one column at a speed
+// factor of 1, in hundredths of seconds. (Used again in turn on the long
+// field.)
+static const uint8_t lane_base_speeds[3] = { 80, 60, 120 };
+static const uint8_t log_base_speeds[2] = { 100, 75 };
 
 // Colours
 #define COLOUR_FROG 0xFF // bright yellow
 #define COLOUR_DEAD_FROG 0x33 // dim yellow
+#define COLOUR_FROG_2 0xF8 // bright lime - the second player's frog
+#define COLOUR_DEAD_FROG_2 0x32 // dim lime
 #define COLOUR_EDGES 0x12 // light orange - for roadside and riverbank
 #define COLOUR_WATER 0x00 // black
 #define COLOUR_ROAD 0x00 // black
 #define COLOUR_LOGS 0x3C // orange
-PixelColour vehicle_colours[3] = { COLOUR_RED, COLOUR_GREEN, COLOUR_RED }; // by lane
+PixelColour vehicle_colours[3] = { COLOUR_RED, COLOUR_GREEN, COLOUR_RED }; // by lane (in turn)
+static const PixelColour frog_colours[MAX_FROGS] = { COLOUR_FROG, COLOUR_FROG_2 };
+static const PixelColour dead_frog_colours[MAX_FROGS] = { COLOUR_DEAD_FROG, COLOUR_DEAD_FROG_2 };
 
 // Rows
 #define START_ROW 0	// row position where the frog starts
 #define FIRST_VEHICLE_ROW 1
-#define SECOND_VEHICLE_ROW 2
-#define THIRD_VEHICLE_ROW 3
-#define HALFWAY_ROW 4 // row position where the frog can rest
-#define FIRST_RIVER_ROW 5
-#define SECOND_RIVER_ROW 6
-#define RIVERBANK_ROW 7 // row position where the frog finishes
+#define HALFWAY_ROW (FIRST_VEHICLE_ROW + NUM_LANES) // row position where the frog can rest
+#define FIRST_RIVER_ROW (HALFWAY_ROW + 1)
+#define RIVERBANK_ROW (FIRST_RIVER_ROW + NUM_LOG_CHANNELS) // row position where the frog finishes
+#if RIVERBANK_ROW != GAME_NUM_ROWS - 1
+#error "The rows of the field don't add up"
+#endif
+
+// A bit for each column of the field
+#if GAME_NUM_COLUMNS > 32
+#error "The field can be at most 32 columns wide"
+#elif GAME_NUM_COLUMNS > 16
+typedef uint32_t RowBits;
+#else
+typedef uint16_t RowBits;
+#endif
+#define ALL_COLUMNS ((RowBits)((1ULL << GAME_NUM_COLUMNS) - 1))
 
 // River bank pattern. Note that the least significant bit in this
-// pattern (RHS) corresponds to column 0 on the display (LHS).
-#define RIVERBANK 0b1011011011011011
-static uint16_t riverbank;
+// pattern (RHS) corresponds to column 0 on the display (LHS). There is a
+// hole in every third column (columns 2, 5, 8 and so on).
+static RowBits riverbank;
 // riverbank_status is a bit pattern similar to riverbank but will
 // only have zeroes where there are unoccupied holes. When this is all 1's
 // then the game/level is complete
-static uint16_t riverbank_status;
+static RowBits riverbank_status;
 
 
 /////////////////////////////// Function Prototypes for Helper Functions ///////
 // These functions are defined after the public functions. Comments are with the
 // definitions.
 static uint8_t frog_alive_at(uint8_t row, uint8_t column);
+static void move_frog_to(uint8_t frog, int8_t row, int8_t column);
 static void redraw_whole_display(void);
-static void redraw_row(uint8_t row);
+static void redraw_row(uint8_t row, uint8_t except_frog);
 static void redraw_roadside(uint8_t row);
 static void redraw_traffic_lane(uint8_t lane);
 static void redraw_river_channel(uint8_t channel);
 static void redraw_riverbank(void);
-static void redraw_frog(void);
+static void redraw_frog(uint8_t frog);
+#if GAME_NUM_ROWS > MATRIX_NUM_ROWS
+static void follow_frogs(void);
+#else
+// The whole field is always shown
+#define follow_frogs() ((void)0)
+#endif
 		
 /////////////////////////////// Public Functions ///////////////////////////////
 // These functions are defined in the same order as declared in game.h
 
 // Reset the game
 void init_game(void) {
+	uint8_t i;
+	
 	// Initial lane and log positions
-	lane_position[0] = rand() % LANE_DATA_WIDTH;
-	lane_position[1] = rand() % LANE_DATA_WIDTH;
-	lane_position[2] = rand() % LANE_DATA_WIDTH;
-	log_position[0] = rand() % LANE_DATA_WIDTH;
-	log_position[1] = rand() % LANE_DATA_WIDTH;
+	for(i=0; i<NUM_LANES; i++) {
+		lane_position[i] = rand() % LANE_DATA_WIDTH;
+	}
+	for(i=0; i<NUM_LOG_CHANNELS; i++) {
+		log_position[i] = rand() % LOG_DATA_WIDTH;
+	}
 	
 	// Initial riverbank pattern
-	riverbank = RIVERBANK;
-	riverbank_status = RIVERBANK;
+	riverbank = ALL_COLUMNS;
+	for(i=2; i<GAME_NUM_COLUMNS; i+=3) {
+		riverbank &= ~((RowBits)1 << i);
+	}
+	riverbank_status = riverbank;
 	
+	// No frogs are out until put_frog_at_start() is called. (A row of -1
+	// keeps them off the field.)
+	for(uint8_t frog=0; frog<MAX_FROGS; frog++) {
+		game_frog_row[frog] = -1;
+		game_frog_alive[frog] = 0;
+	}
+	
+	// Start at the bottom of the field
+	ledmatrix_set_viewport(0);
 	redraw_whole_display();
 }
 
+void generate_game_patterns(uint16_t seed, uint8_t level) {
+	generate_patterns(seed, level, lane_data, NUM_LANES, log_data, NUM_LOG_CHANNELS);
+}
+
+void set_number_of_frogs(uint8_t number) {
+	if(number >= 1 && number <= MAX_PLAYERS) {
+		num_frogs = number;
+	}
+}
+
+uint8_t get_number_of_frogs(void) {
+	return num_frogs;
+}
+
 // Add a frog to the game
-void put_frog_at_start(void) {
+void put_frog_at_start(uint8_t frog) {
 	// Initial starting position of frog (8,0)
-	frog_row = 0;
-	frog_column = rand() % 16;
+	game_frog_row[frog] = 0;
+	frog_column[frog] = rand() % GAME_NUM_COLUMNS;
 	
 	// Frog is initially alive
-	frog_alive = 1;
+	game_frog_alive[frog] = 1;
 	
 	// Show the frog
-	redraw_frog();
+	redraw_frog(frog);
+	follow_frogs();
 }
 
 void remove_dead_frogs(void) {
@@ -131,235 +209,149 @@ void remove_dead_frogs(void) {
 	redraw_roadside(HALFWAY_ROW);
 
 	// Redraw traffic lanes
-	for(uint8_t lane=0; lane<=2; lane++) {
+	for(uint8_t lane=0; lane<NUM_LANES; lane++) {
 		redraw_traffic_lane(lane);
 	}
 	// Redraw river
-	for(uint8_t channel=0; channel<=1; channel++) {
+	for(uint8_t channel=0; channel<NUM_LOG_CHANNELS; channel++) {
 		redraw_river_channel(channel);
 	}
 	// Redraw riverbank
 	redraw_riverbank();
+	
+	// Put back any frogs which are still crossing
+	for(uint8_t frog=0; frog<num_frogs; frog++) {
+		if(game_frog_alive[frog] && game_frog_row[frog] != RIVERBANK_ROW) {
+			redraw_frog(frog);
+		}
+	}
 }
 
-// This function assumes that the frog is not in row 7 (the top row). A frog in row 7 is out
-// of the game.
-void move_frog_forward(void) {
+// Frogs in the top row are out of the game, so don't move any further.
+void move_frog_forward(uint8_t frog) {
 	// Ignore up commands on the last row (to stop bugs)
-	if (frog_row != RIVERBANK_ROW) {
-		// Redraw the row the frog is currently on (this will remove the frog)
-		redraw_row(frog_row);
-	
-		// Check whether this move will cause the frog to die or not
-		frog_alive = frog_alive_at(frog_row+1, frog_column);
-	
-		// Move the frog position forward and show the frog. 
-		// We do this whether the frog is alive or not. 
-		frog_row++;
-		
-		// Play movement sound
-		play_quiet_sound(FREQ_C5, 2);
-		redraw_frog();
-	
-		// If the frog has ended up successfully in row 7 - add it to the riverbank_status flag
-		if(frog_alive && frog_row == RIVERBANK_ROW) {
-			riverbank_status |= (1<<frog_column);
-		}
+	if (game_frog_row[frog] != RIVERBANK_ROW) {
+		move_frog_to(frog, game_frog_row[frog]+1, frog_column[frog]);
 	}
 }
 
-// This function assumes that the frog is not in row 7 (the top row). A frog in row 7 is out
-// of the game. Frogs are also not allowed to move down while in row 0.
-void move_frog_backward(void) {
+// Frogs are not allowed to move down while in row 0.
+void move_frog_backward(uint8_t frog) {
 	// Ignore down commands while on the first row
-	if (frog_row != START_ROW) {
-		// Redraw the row the frog is currently on (this will remove the frog)
-		redraw_row(frog_row);
-		
-		// Check whether this move will cause the frog to die or not
-		frog_alive = frog_alive_at(frog_row-1, frog_column);
-		
-		// Move the frog position backward and show the frog.
-		// We do this whether the frog is alive or not.
-		frog_row--;
-		play_quiet_sound(FREQ_C5, 2);
-		redraw_frog();
+	if (game_frog_row[frog] != START_ROW) {
+		move_frog_to(frog, game_frog_row[frog]-1, frog_column[frog]);
 	}
 }
 
-void move_frog_left(void) {
+void move_frog_left(uint8_t frog) {
 	// If the frog is already at the left hand side then do nothing (can't move further)
-	if (frog_column != 0) {
-		// Redraw the row the frog is currently on (this will remove the frog)
-		redraw_row(frog_row);
-		
-		// Check whether this move will cause the frog to die or not
-		frog_alive = frog_alive_at(frog_row, frog_column-1);
-		
-		// Move the frog position left and show the frog.
-		// We do this whether the frog is alive or not.
-		frog_column--;
-		
-		// Play movement sound
-		play_quiet_sound(FREQ_C5, 2);
-		redraw_frog();
+	if (frog_column[frog] != 0) {
+		move_frog_to(frog, game_frog_row[frog], frog_column[frog]-1);
 	}
 }
 
-void move_frog_right(void) {
+void move_frog_right(uint8_t frog) {
 	// If the frog is already at the right hand side then do nothing (can't move further)
-	if (frog_column != 15) {
-		// Redraw the row the frog is currently on (this will remove the frog)
-		redraw_row(frog_row);
-		
-		// Check whether this move will cause the frog to die or not
-		frog_alive = frog_alive_at(frog_row, frog_column+1);
-		
-		// Move the frog position right and show the frog.
-		// We do this whether the frog is alive or not.
-		frog_column++;
-		
-		// Play movement sound
-		play_quiet_sound(FREQ_C5, 2);
-		redraw_frog();
+	if (frog_column[frog] != GAME_NUM_COLUMNS-1) {
+		move_frog_to(frog, game_frog_row[frog], frog_column[frog]+1);
 	}
 }
 
-void move_frog_forward_left() {
+void move_frog_forward_left(uint8_t frog) {
 	// No moving at top or left.
-	if (frog_row != RIVERBANK_ROW && frog_column != 0) {
-		// Redraw the row the frog is currently on (this will remove the frog)
-		redraw_row(frog_row);
-		
-		// Check whether this move will cause the frog to die or not
-		frog_alive = frog_alive_at(frog_row+1, frog_column-1);
-		
-		// Move the frog position forward-left and show the frog.
-		// We do this whether the frog is alive or not.
-		frog_row++;
-		frog_column--;
-		
-		// Play movement sound
-		play_quiet_sound(FREQ_C5, 2);
-		redraw_frog();
-		
-		// If the frog has ended up successfully in row 7 - add it to the riverbank_status flag
-		if(frog_alive && frog_row == RIVERBANK_ROW) {
-			riverbank_status |= (1<<frog_column);
-		}
-	} else if (frog_column == 0) {
+	if (game_frog_row[frog] != RIVERBANK_ROW && frog_column[frog] != 0) {
+		move_frog_to(frog, game_frog_row[frog]+1, frog_column[frog]-1);
+	} else if (frog_column[frog] == 0) {
 		// Move forward if backed against the wall
-		move_frog_forward();
+		move_frog_forward(frog);
 	}
 }
 
-void move_frog_forward_right() {
+void move_frog_forward_right(uint8_t frog) {
 	// No moving at top or right.
-	if (frog_row != RIVERBANK_ROW && frog_column != 15) {
-		// Redraw the row the frog is currently on (this will remove the frog)
-		redraw_row(frog_row);
-		
-		// Check whether this move will cause the frog to die or not
-		frog_alive = frog_alive_at(frog_row+1, frog_column+1);
-		
-		// Move the frog position forward-right and show the frog.
-		// We do this whether the frog is alive or not.
-		frog_row++;
-		frog_column++;
-		
-		// Play movement sound
-		play_quiet_sound(FREQ_C5, 2);
-		redraw_frog();
-		
-		// If the frog has ended up successfully in row 7 - add it to the riverbank_status flag
-		if(frog_alive && frog_row == RIVERBANK_ROW) {
-			riverbank_status |= (1<<frog_column);
-		}
-	} else if (frog_column == 15) {
+	if (game_frog_row[frog] != RIVERBANK_ROW && frog_column[frog] != GAME_NUM_COLUMNS-1) {
+		move_frog_to(frog, game_frog_row[frog]+1, frog_column[frog]+1);
+	} else if (frog_column[frog] == GAME_NUM_COLUMNS-1) {
 		// Move forward if backed against the wall
-		move_frog_forward();
+		move_frog_forward(frog);
 	}
 }
 
-void move_frog_backward_left() {
+void move_frog_backward_left(uint8_t frog) {
 	// No moving at bottom or left.
-	if (frog_row != START_ROW && frog_column != 0) {
-		// Redraw the row the frog is currently on (this will remove the frog)
-		redraw_row(frog_row);
-		
-		// Check whether this move will cause the frog to die or not
-		frog_alive = frog_alive_at(frog_row-1, frog_column-1);
-		
-		// Move the frog position back-left and show the frog.
-		// We do this whether the frog is alive or not.
-		frog_row--;
-		frog_column--;
-		
-		// Play movement sound
-		play_quiet_sound(FREQ_C5, 2);
-		redraw_frog();
-	} else if (frog_column == 0) {
+	if (game_frog_row[frog] != START_ROW && frog_column[frog] != 0) {
+		move_frog_to(frog, game_frog_row[frog]-1, frog_column[frog]-1);
+	} else if (frog_column[frog] == 0) {
 		// Move backward if backed against the wall
-		move_frog_backward();
-	} else if (frog_row == START_ROW) {
+		move_frog_backward(frog);
+	} else if (game_frog_row[frog] == START_ROW) {
 		// Move left if backed against the bottom
-		move_frog_left();
+		move_frog_left(frog);
 	}
 }
 
-void move_frog_backward_right() {
+void move_frog_backward_right(uint8_t frog) {
 	// No moving at bottom or right.
-	if (frog_row != START_ROW && frog_column != 15) {
-		// Redraw the row the frog is currently on (this will remove the frog)
-		redraw_row(frog_row);
-		
-		// Check whether this move will cause the frog to die or not
-		frog_alive = frog_alive_at(frog_row-1, frog_column+1);
-		
-		// Move the frog position back-left and show the frog.
-		// We do this whether the frog is alive or not.
-		frog_row--;
-		frog_column++;
-		
-		// Play movement sound
-		play_quiet_sound(FREQ_C5, 2);
-		redraw_frog();
-	} else if (frog_column == 15) {
+	if (game_frog_row[frog] != START_ROW && frog_column[frog] != GAME_NUM_COLUMNS-1) {
+		move_frog_to(frog, game_frog_row[frog]-1, frog_column[frog]+1);
+	} else if (frog_column[frog] == GAME_NUM_COLUMNS-1) {
 		// Move backward if backed against the wall
-		move_frog_backward();
-	} else if (frog_row == START_ROW) {
+		move_frog_backward(frog);
+	} else if (game_frog_row[frog] == START_ROW) {
 		// Move right if backed against the bottom
-		move_frog_right();
+		move_frog_right(frog);
 	}
 }
 
-uint8_t get_frog_row(void) {
-	return frog_row;
+uint8_t get_frog_column(uint8_t frog) {
+	return frog_column[frog];
 }
 
-uint8_t get_frog_column(void) {
-	return frog_column;
+uint8_t is_riverbank_full(void) {
+	return (riverbank_status == ALL_COLUMNS);
 }
 
-uint8_t is_riverbank_full(void) {
-	return (riverbank_status == 0xFFFF);
+uint8_t frog_has_reached_riverbank(uint8_t frog) {
+	return (game_frog_row[frog] == RIVERBANK_ROW);
 }
 
-uint8_t frog_has_reached_riverbank(void) {
-	return (frog_row == RIVERBANK_ROW);
+uint8_t are_all_frogs_crossing(void) {
+	for(uint8_t frog=0; frog<num_frogs; frog++) {
+		if(!game_frog_alive[frog] || game_frog_row[frog] == RIVERBANK_ROW) {
+			return 0;
+		}
+	}
+	return 1;
 }
 
-uint8_t is_frog_alive(void) {
-	return frog_alive;
+void kill_frog(uint8_t frog) {
+	game_frog_alive[frog] = 0;
 }
 
-void kill_frog(void) {
-	frog_alive = 0;
+uint8_t get_moving_row_base_speed(uint8_t moving_row) {
+	if(moving_row < NUM_LANES) {
+		return lane_base_speeds[moving_row % 3];
+	} else {
+		return log_base_speeds[(moving_row - NUM_LANES) % 2];
+	}
 }
 
-// Scroll the given lane of traffic. (lane value must be 0 to 2)
+// Lanes 0, 2, ... and log channels 1, 3, ... go in the level's direction
+void scroll_moving_row(uint8_t moving_row, int8_t level_direction) {
+	uint8_t channel;
+	if(moving_row < NUM_LANES) {
+		scroll_lane(moving_row, (moving_row & 1) ? -level_direction : level_direction);
+	} else {
+		channel = moving_row - NUM_LANES;
+		scroll_log_channel(channel, (channel & 1) ? level_direction : -level_direction);
+	}
+}
+
+// Scroll the given lane of traffic. (lane value must be 0 to NUM_LANES-1)
 void scroll_lane(uint8_t lane, int8_t direction) {
-	uint8_t frog_is_in_this_row = (frog_row == lane + FIRST_VEHICLE_ROW);
+	BENCH_BEGIN(BENCH_SCROLL_LANE);
+	uint8_t row = lane + FIRST_VEHICLE_ROW;
+	uint8_t frog;
 	
 	// Work out the new lane position.
 	// Wrap numbers around if they go out of range
@@ -371,34 +363,42 @@ void scroll_lane(uint8_t lane, int8_t direction) {
 	} else if(lane_position[lane] >= LANE_DATA_WIDTH) {
 		lane_position[lane] = 0;
 	}
-	// Update whether the frog will be alive or not. (The frog hasn't moved but
-	// it may have been hit by a vehicle.)
-	frog_alive = frog_alive_at(frog_row, frog_column);
 	
 	// Show the lane on the display
 	redraw_traffic_lane(lane);
 	
-	// If the frog is in this row, show it
-	if(frog_is_in_this_row) {
-		redraw_frog();
+	// Update whether each frog in this row is still alive (they haven't moved
+	// but may have been hit by a vehicle) and show them
+	for(frog=0; frog<num_frogs; frog++) {
+		if(game_frog_row[frog] == row) {
+			if(game_frog_alive[frog]) {
+				game_frog_alive[frog] = frog_alive_at(row, frog_column[frog]);
+			}
+			redraw_frog(frog);
+		}
 	}
+	BENCH_END(BENCH_SCROLL_LANE);
 }
 
 
 void scroll_log_channel(uint8_t channel, int8_t direction) {
-	uint8_t frog_is_in_this_row = (frog_row == channel + FIRST_RIVER_ROW);
-	// Note, if the frog is in this row then it will be on a log
+	BENCH_BEGIN(BENCH_SCROLL_LOG_CHANNEL);
+	uint8_t row = channel + FIRST_RIVER_ROW;
+	uint8_t frog;
 	
-	if(frog_is_in_this_row) {
-		// Check if they're going to hit the edge - don't let the frog
-		// go beyond the edge
-		if(direction == 1 && frog_column == 15) {
-			frog_alive = 0; // hit right edge
-		} else if(direction == -1 && frog_column == 0) {
-			frog_alive = 0; // hit left edge
-		} else {
-			// Move the frog with the log - they're not going to hit the edge
-			frog_column += direction;
+	// Any frogs in this row will be on a log, so move them with it
+	for(frog=0; frog<num_frogs; frog++) {
+		if(game_frog_row[frog] == row) {
+			// Check if they're going to hit the edge - don't let the frog
+			// go beyond the edge
+			if(direction == 1 && frog_column[frog] == GAME_NUM_COLUMNS-1) {
+				game_frog_alive[frog] = 0; // hit right edge
+			} else if(direction == -1 && frog_column[frog] == 0) {
+				game_frog_alive[frog] = 0; // hit left edge
+			} else {
+				// Move the frog with the log - they're not going to hit the edge
+				frog_column[frog] += direction;
+			}
 		}
 	}
 		
@@ -414,10 +414,13 @@ void scroll_log_channel(uint8_t channel, int8_t direction) {
 	// Work out the log data to send to the display
 	redraw_river_channel(channel);
 		
-	// If the frog is in this row, put them on the log
-	if(frog_is_in_this_row) {
-		redraw_frog();
+	// Put the frogs in this row back on their logs
+	for(frog=0; frog<num_frogs; frog++) {
+		if(game_frog_row[frog] == row) {
+			redraw_frog(frog);
+		}
 	}
+	BENCH_END(BENCH_SCROLL_LOG_CHANNEL);
 }
 
 
@@ -429,40 +432,61 @@ void scroll_log_channel(uint8_t channel, int8_t direction) {
 // riverbank then that space is free.
 static uint8_t frog_alive_at(uint8_t row, uint8_t column) {
 	uint8_t lane, channel, bit_position;
-	switch(row) {
-		case 0: // always safe
-		case 4: // always safe
-			return 1;
-			break;
-		case 1:
-		case 2:
-		case 3:
-			lane = row - 1;
-			bit_position = lane_position[lane] + column;
-			if(bit_position >= LANE_DATA_WIDTH) {
-				bit_position -= LANE_DATA_WIDTH;
-			}
-			return !((lane_data[lane] >> bit_position) & 1);
-			break;
-		case 5:
-		case 6:
-			channel = row - 5;
-			bit_position = log_position[channel] + column;
-			if(bit_position >= LOG_DATA_WIDTH) {
-				bit_position -= LOG_DATA_WIDTH;
-			}
-			return (log_data[channel] >> bit_position) & 1;
-			break;
-		case 7:
-			return !((riverbank_status >> column) & 1);
-			break;	
+	if(row == START_ROW || row == HALFWAY_ROW) {
+		// always safe
+		return 1;
+	} else if(row < HALFWAY_ROW) {
+		lane = row - FIRST_VEHICLE_ROW;
+		bit_position = lane_position[lane] + column;
+		if(bit_position >= LANE_DATA_WIDTH) {
+			bit_position -= LANE_DATA_WIDTH;
+		}
+		return !((lane_data[lane] >> bit_position) & 1);
+	} else if(row < RIVERBANK_ROW) {
+		channel = row - FIRST_RIVER_ROW;
+		bit_position = log_position[channel] + column;
+		if(bit_position >= LOG_DATA_WIDTH) {
+			bit_position -= LOG_DATA_WIDTH;
+		}
+		return (log_data[channel] >> bit_position) & 1;
+	} else if(row == RIVERBANK_ROW) {
+		return !((riverbank_status >> column) & 1);
 	}
 	// Should never get here (unless row invalid)
 	return 0;	
 }
 
+// Move the given frog to the given position, which must be on the game field
+// and next to where it is now. The frog dies if it isn't safe there (this is
+// shown on the display). If it lands in a hole in the riverbank, the hole is
+// filled.
+static void move_frog_to(uint8_t frog, int8_t row, int8_t column) {
+	int8_t old_row = game_frog_row[frog];
+	
+	// Check whether this move will cause the frog to die or not
+	game_frog_alive[frog] = frog_alive_at(row, column);
+	
+	// Move the frog. We do this whether the frog is alive or not. 
+	game_frog_row[frog] = row;
+	frog_column[frog] = column;
+	
+	// Redraw the row the frog was on (this will remove the frog, but keep
+	// any other frogs there) and show the frog in its new position
+	redraw_row(old_row, frog);
+	play_quiet_sound(FREQ_C5, 2);
+	redraw_frog(frog);
+	
+	// If the frog has ended up successfully in the top row - add it to the riverbank_status flag
+	if(game_frog_alive[frog] && row == RIVERBANK_ROW) {
+		riverbank_status |= ((RowBits)1 << column);
+	}
+	
+	follow_frogs();
+}
+
 // Redraw the rows on the game field. The frog is not redrawn.
 static void redraw_whole_display(void) {
+	BENCH_BEGIN(BENCH_REDRAW_WHOLE_DISPLAY);
 	// Clear the display
 	ledmatrix_clear();
 	
@@ -471,64 +495,69 @@ static void redraw_whole_display(void) {
 	redraw_roadside(HALFWAY_ROW);
 
 	// Redraw traffic lanes
-	for(uint8_t lane=0; lane<=2; lane++) {
+	for(uint8_t lane=0; lane<NUM_LANES; lane++) {
 		redraw_traffic_lane(lane);
 	}
 	// Redraw river
-	for(uint8_t channel=0; channel<=1; channel++) {
+	for(uint8_t channel=0; channel<NUM_LOG_CHANNELS; channel++) {
 		redraw_river_channel(channel);
 	}
 	// Redraw riverbank
 	redraw_riverbank();
+	BENCH_END(BENCH_REDRAW_WHOLE_DISPLAY);
 }
 
-// Redraw the row with the given number (0 to 7). The frog is not redrawn.
-static void redraw_row(uint8_t row) {	
+// Redraw the row with the given number (0 to GAME_NUM_ROWS-1), and any frogs in it apart
+// from except_frog (MAX_FROGS to redraw them all).
+static void redraw_row(uint8_t row, uint8_t except_frog) {	
 	// Remove frog from current position (we need to update the display
 	// so it shows the right colour pixel in its place). We know the frog
 	// must be either on a road edge, on the road or on a log.
-	switch(row) {
-		case START_ROW:
-		case HALFWAY_ROW:
-			redraw_roadside(row);
-			break;
-		case FIRST_VEHICLE_ROW:
-		case SECOND_VEHICLE_ROW:
-		case THIRD_VEHICLE_ROW:
-			redraw_traffic_lane(row-1);
-			break;
-		case FIRST_RIVER_ROW:
-		case SECOND_RIVER_ROW:
-			redraw_river_channel(row-5);
-			break;
-		case RIVERBANK_ROW:
-			redraw_riverbank();
-			break;
-		default:
-			// Invalid row - ignore
-			break;
-	}
-}
-
-
-// Redraw the given roadside row (0 or 4). The frog is not redrawn.
+	if(row == START_ROW || row == HALFWAY_ROW) {
+		redraw_roadside(row);
+	} else if(row < HALFWAY_ROW) {
+		redraw_traffic_lane(row-FIRST_VEHICLE_ROW);
+	} else if(row < RIVERBANK_ROW) {
+		redraw_river_channel(row-FIRST_RIVER_ROW);
+	} else if(row == RIVERBANK_ROW) {
+		redraw_riverbank();
+	} else {
+		// Invalid row - ignore
+		return;
+	}
+	
+	// Frogs which made it to the riverbank are part of that row
+	if(row != RIVERBANK_ROW) {
+		for(uint8_t frog=0; frog<num_frogs; frog++) {
+			if(frog != except_frog && game_frog_row[frog] == row) {
+				redraw_frog(frog);
+			}
+		}
+	}
+}
+
+
+// Redraw the given roadside row (start or halfway). The frog is not redrawn.
 static void redraw_roadside(uint8_t row) {
+	BENCH_BEGIN(BENCH_REDRAW_ROADSIDE);
 	MatrixRow row_display_data;
 	uint8_t i;
-	for(i=0;i<=15;i++) {
+	for(i=0;i<GAME_NUM_COLUMNS;i++) {
 		row_display_data[i] = COLOUR_EDGES;
 	}
 	ledmatrix_update_row(row, row_display_data);
+	BENCH_END(BENCH_REDRAW_ROADSIDE);
 }
 
-// Redraw the given traffic lane (0, 1, 2). The frog is not redrawn.
+// Redraw the given traffic lane (0 to NUM_LANES-1). The frog is not redrawn.
 static void redraw_traffic_lane(uint8_t lane) {
+	BENCH_BEGIN(BENCH_REDRAW_TRAFFIC_LANE);
 	MatrixRow row_display_data;
 	uint8_t i;
 	uint8_t bit_position = lane_position[lane];
-	for(i=0; i<=15; i++) {
+	for(i=0; i<GAME_NUM_COLUMNS; i++) {
 		if((lane_data[lane] >> bit_position) & 1) {
-			row_display_data[i] = vehicle_colours[lane];
+			row_display_data[i] = vehicle_colours[lane % 3];
 			} else {
 			row_display_data[i] = COLOUR_ROAD;
 		}
@@ -539,14 +568,16 @@ static void redraw_traffic_lane(uint8_t lane) {
 		}
 	}
 	ledmatrix_update_row(lane+FIRST_VEHICLE_ROW, row_display_data);
+	BENCH_END(BENCH_REDRAW_TRAFFIC_LANE);
 }
 
-// Redraw the given river channel (0 or 1). The frog is not redrawn.
+// Redraw the given river channel (0 to NUM_LOG_CHANNELS-1). The frog is not redrawn.
 static void redraw_river_channel(uint8_t channel) {
+	BENCH_BEGIN(BENCH_REDRAW_RIVER_CHANNEL);
 	MatrixRow row_display_data;
 	uint8_t i;
 	uint8_t bit_position = log_position[channel];
-	for(i=0; i<=15; i++) {
+	for(i=0; i<GAME_NUM_COLUMNS; i++) {
 		if((log_data[channel] >> bit_position) & 1) {
 			row_display_data[i] = COLOUR_LOGS;
 			} else {
@@ -558,15 +589,17 @@ static void redraw_river_channel(uint8_t channel) {
 		}
 	}
 	ledmatrix_update_row(channel+FIRST_RIVER_ROW, row_display_data);
+	BENCH_END(BENCH_REDRAW_RIVER_CHANNEL);
 }
 
 // Redraw the riverbank (top row). Previous frogs which have made it to a hole
 // at the top are shown.
 static void redraw_riverbank(void) {
+	BENCH_BEGIN(BENCH_REDRAW_RIVERBANK);
 	MatrixRow row_display_data;
 	uint8_t i;
 	// Blank out spaces in our rowdata where there are holes in the riverbank
-	for(i=0; i<= 15; i++) {
+	for(i=0; i<GAME_NUM_COLUMNS; i++) {
 		if((riverbank >> i) & 1) {
 			// Riverbank edge
 			row_display_data[i] = COLOUR_EDGES;
@@ -580,13 +613,53 @@ static void redraw_riverbank(void) {
 	}
 	// Output our riverbank to the display
 	ledmatrix_update_row(RIVERBANK_ROW, row_display_data);
+	BENCH_END(BENCH_REDRAW_RIVERBANK);
 }
 
-// Redraw the frog in its current position.
-static void redraw_frog(void) {
-	if(frog_alive) {
-		ledmatrix_update_pixel(frog_column, frog_row, COLOUR_FROG);
+// Redraw the given frog in its current position.
+static void redraw_frog(uint8_t frog) {
+	BENCH_BEGIN(BENCH_REDRAW_FROG);
+	if(game_frog_alive[frog]) {
+		ledmatrix_update_pixel(frog_column[frog], game_frog_row[frog], frog_colours[frog]);
 	} else {
-		ledmatrix_update_pixel(frog_column, frog_row, COLOUR_DEAD_FROG);
+		ledmatrix_update_pixel(frog_column[frog], game_frog_row[frog], dead_frog_colours[frog]);
 	}
-}
\ No newline at end of file
+	// The SPI transfer is complete once we get here
+	latency_frog_drawn();
+	BENCH_END(BENCH_REDRAW_FROG);
+}
+
+#if GAME_NUM_ROWS > MATRIX_NUM_ROWS
+// Move the viewport so that the frog is shown, with two rows below it
+// where possible, and redraw the display if it moved. (There is only
+// one player on a field this long, but any other frogs are put back
+// too.)
+static void follow_frogs(void) {
+	int8_t lowest_row = RIVERBANK_ROW;
+	int8_t first_row;
+	uint8_t frog;
+	
+	for(frog=0; frog<num_frogs; frog++) {
+		if(game_frog_row[frog] >= 0 && game_frog_row[frog] < lowest_row) {
+			lowest_row = game_frog_row[frog];
+		}
+	}
+	first_row = lowest_row - 2;
+	if(first_row < 0) {
+		first_row = 0;
+	} else if(first_row > GAME_NUM_ROWS - MATRIX_NUM_ROWS) {
+		first_row = GAME_NUM_ROWS - MATRIX_NUM_ROWS;
+	}
+	if(first_row == ledmatrix_get_viewport()) {
+		return;
+	}
+	
+	ledmatrix_set_viewport(first_row);
+	redraw_whole_display();
+	for(frog=0; frog<num_frogs; frog++) {
+		if(game_frog_row[frog] >= 0 && game_frog_row[frog] != RIVERBANK_ROW) {
+			redraw_frog(frog);
+		}
+	}
+}
+#endif
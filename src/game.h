@@ -14,23 +14,76 @@
  *
  * The functions in this module will update the LED matrix
  * display as required. 
+ *
+ * A longer field can be played on a display made up of several panels
+ * (see ledmatrix.h) - this is used when the display has at least 16
+ * rows, or when GAME_LONG_FIELD is defined. It has 16 rows: 6 lanes of
+ * traffic (rows 1 to 6), the halfway row (7), 7 log channels (rows 8
+ * to 14) and the riverbank (row 15). The field is as wide as the
+ * display. If the display is shorter than the field, it shows the part
+ * of the field around the frog (see ledmatrix_set_viewport()); only one
+ * player can play then, as two frogs can be further apart than the
+ * display is tall.
+ *
+ * Up to MAX_FROGS frogs (one for each player) can be crossing at
+ * once. Each has its own colour; the functions which act on a frog
+ * take the number of the frog (0 to MAX_FROGS-1).
  */ 
 
 #ifndef GAME_H_
 #define GAME_H_
 
 #include <stdint.h>
-
-// Reset the game. Get the road and river ready and place a frog
-// on the roadside (bottom row)
+#include "ledmatrix.h"
+
+// Most frogs (players) in a game
+#define MAX_FROGS 2
+
+// Size of the field
+#if defined(GAME_LONG_FIELD) || MATRIX_NUM_ROWS >= 16
+#define GAME_NUM_ROWS 16
+#define NUM_LANES 6
+#define NUM_LOG_CHANNELS 7
+#else
+#define GAME_NUM_ROWS 8
+#define NUM_LANES 3
+#define NUM_LOG_CHANNELS 2
+#endif
+#define GAME_NUM_COLUMNS MATRIX_NUM_COLUMNS
+
+// Most players in a game on this display (see above)
+#if GAME_NUM_ROWS > MATRIX_NUM_ROWS
+#define MAX_PLAYERS 1
+#else
+#define MAX_PLAYERS MAX_FROGS
+#endif
+
+// The lanes and log channels are the moving rows. They are numbered
+// with the lanes first (0 to NUM_LANES-1) then the log channels.
+#define NUM_MOVING_ROWS (NUM_LANES + NUM_LOG_CHANNELS)
+
+// Reset the game. Get the road and river ready. No frogs are on the
+// field until put_frog_at_start() is called.
 void init_game(void);
 
-// Add a frog to the game in the starting (bottom) row
+// Replace the traffic and log patterns with ones generated for the given
+// level from the given seed (see patterns.h). The same seed and level
+// always give the same patterns. init_game() should be called afterwards.
+void generate_game_patterns(uint16_t seed, uint8_t level);
+
+// Set the number of frogs (1 to MAX_PLAYERS) in the following games.
+// Other numbers are ignored.
+// init_game() should be called afterwards.
+void set_number_of_frogs(uint8_t number);
+uint8_t get_number_of_frogs(void);
+
+// Add the given frog to the game in the starting (bottom) row
 // (This would typically be called after a frog has made it 
 // successfully to the other side.)
-void put_frog_at_start(void);
+void put_frog_at_start(uint8_t frog);
 
-// Refreshes the display to get rid of all frogs
+// Refreshes the display to get rid of all dead frogs (and those which
+// have reached the riverbank, apart from in their holes)
 void remove_dead_frogs(void);
 
 /////////////////////////////////// MOVE FUNCTIONS /////////////////////////
@@ -38,63 +91,88 @@ void remove_dead_frogs(void);
 // if the move succeeded or not
 
 // Move the frog one row forward.
-// This function must NOT be called if the frog is in row 7 (i.e. home).
+// This function must NOT be called if the frog is in the top row (i.e. home).
 // Failure may occur if the frog jumps into a vehicle or jumps in the water 
 // or jumps into the riverbank. 
-void move_frog_forward(void);
+void move_frog_forward(uint8_t frog);
 
 // Move the frog one row backward, if possible.
-void move_frog_backward(void);
+void move_frog_backward(uint8_t frog);
 
 // Move the frog one column left. 
 // Failure may occur if the frog jumps into a vehicle or jumps off a log
 // into the river. Attempts to jump off the game field are ignored.
-void move_frog_left(void);
+void move_frog_left(uint8_t frog);
 
 // Move the frog one column right.
 // Failure may occur if the frog jumps into a vehicle or jumps off a log
 // into the river. Attempts to jump off the game field are ignored. 
-void move_frog_right(void);
+void move_frog_right(uint8_t frog);
 
 // Diagonal movement.
 // If the player is against a wall, these move vertically/horizontally as expected.
-void move_frog_forward_left();
-void move_frog_forward_right();
-void move_frog_backward_left();
-void move_frog_backward_right();
+void move_frog_forward_left(uint8_t frog);
+void move_frog_forward_right(uint8_t frog);
+void move_frog_backward_left(uint8_t frog);
+void move_frog_backward_right(uint8_t frog);
 
 /////////////////////// FROG / GAME STATUS ///////////////////////////////////
-// Return the position of the frog. The row ranges from 0 (bottom) to 7 (top).
-// The column ranges from 0 (left hand side) to 1 (right hand side)
-uint8_t get_frog_row(void);
-uint8_t get_frog_column(void);
+// Each frog's row and whether it is alive. Only to be changed by game.c.
+// These (like lives_remaining and level_difficulty) are exported only so
+// that their accessors, which are called on every pass of the game loop,
+// can be inlined; everything else should use the accessors.
+extern int8_t game_frog_row[MAX_FROGS];
+extern uint8_t game_frog_alive[MAX_FROGS];
+
+// Return the position of the given frog. The row ranges from 0 (bottom) to
+// GAME_NUM_ROWS-1 (top). The column ranges from 0 (left hand side) to
+// GAME_NUM_COLUMNS-1 (right hand side)
+static inline uint8_t get_frog_row(uint8_t frog) {
+	return game_frog_row[frog];
+}
+uint8_t get_frog_column(uint8_t frog);
 
 // Check whether the destination riverbank is full (i.e. there are frogs 
 // in all the holes).
 uint8_t is_riverbank_full(void);
 
-// Check whether the frog has reached the riverbank (the other side).
+// Check whether the given frog has reached the riverbank (the other side).
 // (If this returns true, the frog should not be moved any further.)
-uint8_t frog_has_reached_riverbank(void);
+uint8_t frog_has_reached_riverbank(uint8_t frog);
+
+// Check whether the given frog is alive or not
+static inline uint8_t is_frog_alive(uint8_t frog) {
+	return game_frog_alive[frog];
+}
 
-// Check whether the frog is alive or not
-uint8_t is_frog_alive(void);
+// Check whether every frog is alive and still crossing (i.e. none has died
+// or reached the riverbank)
+uint8_t are_all_frogs_crossing(void);
 
-// Manually kills the frog
-void kill_frog(void);
+// Manually kills the given frog
+void kill_frog(uint8_t frog);
 
 /////////////////////// UPDATE FUNCTIONS /////////////////////////////////////
+// Return the time the given moving row takes to move one column at a
+// speed factor of 1, in hundredths of seconds.
+uint8_t get_moving_row_base_speed(uint8_t moving_row);
+
+// Scroll the given moving row. Neighbouring rows go in opposite directions;
+// level_direction (-1 or 1) swaps them all over.
+void scroll_moving_row(uint8_t moving_row, int8_t level_direction);
+
 // Scroll the given lane of traffic in the given direction. 
-// Check is_frog_alive() to determine whether the frog was killed or not.
-// lane argument is 0, 1 or 2 corresponding to rows 1, 2 and 3 on the display.
+// Check is_frog_alive() to determine whether any frogs were killed or not.
+// lane argument is 0 to NUM_LANES-1 corresponding to rows 1 upwards.
 // direction argument is -1 for left, 1 for right, 0 for no scroll (just redraw)
 void scroll_lane(uint8_t lane, int8_t direction);
 
-// Scroll the given log channel (and the frog if the frog is on a log) in
+// Scroll the given log channel (and any frogs on its logs) in
 // the given direction.
-// Check is_frog_alive() to determine whether the frog was killed or not.
+// Check is_frog_alive() to determine whether any frogs were killed or not.
 // (Frog dies if it hits the edge of the game field whilst on a log.)
-// log argument is 0 or 1 (corresponding to rows 5 and 6 on the display).
+// channel argument is 0 to NUM_LOG_CHANNELS-1 corresponding to the rows
+// above the halfway row.
 // direction argument is -1 for left, 1 for right, 0 for no scroll (just redraw)
 void scroll_log_channel (uint8_t channel, int8_t direction);
 
@@ -2,100 +2,229 @@
  * joystick.c
  *
  * Author: Sean Manson
- */ 
+ */
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <stdio.h>
 #include "joystick.h"
 #include "timer0.h"
+#include "latency.h"
+#include "bench.h"
 
-static volatile uint16_t last_x; // The last x value of the joystick
-static volatile uint16_t last_y; // The last y value of the joystick
-static volatile uint8_t x_or_y; // Whether or not the last value calculated was for x or y
+static volatile uint16_t last_x; // The last (filtered) x value of the joystick
+static volatile uint16_t last_y; // The last (filtered) y value of the joystick
 static uint8_t last_joystick_zone; // The last zone the joystick was in
-static uint32_t last_joystick_time; // The last time (clock tick) the joystick incurred movement
-									// A value of 0 implies the joystick should not be repeating
 static uint8_t movement_value; // The last direction the joystick wanted to move in
 
-// The delay between joystick movement repetitions
-#define REPEAT_DELAY 250
+// Time (ms) until the next repeated movement. Counted down by
+// joystick_timer_tick(); a value of 0 means we are not repeating.
+static uint16_t repeat_countdown;
+
+// Set by joystick_timer_tick() when it is time to repeat the movement
+// being held. This is a flag rather than a queued event, so if the game
+// is too busy to take repeats as they come, only one is waiting when it
+// gets back to us (rather than a burst of them).
+static volatile uint8_t repeat_pending;
+
+// How far the joystick is pushed along each axis, and overall (the
+// larger of the two). 0 is the centre and 255 is the edge of the
+// calibrated range.
+static uint8_t axis_deflection[2];
+static uint8_t deflection;
+
+// Scale factors for converting a distance from the centre into a
+// deflection, for the low and high side of each axis. These are
+// 65536/(distance from centre to edge), so that
+// (distance * scale) >> 8 gives 256 at the edge.
+static uint16_t deflection_scale_low[2];
+static uint16_t deflection_scale_high[2];
+
+// Minimum delay before the first repeat, so that a single push doesn't
+// turn into two movements
+#define INITIAL_REPEAT_DELAY 200
+
+// Repeat delay (ms) for each 1/16th of the joystick's range. The harder
+// the joystick is pushed, the quicker we move.
+static const uint16_t repeat_curve[16] PROGMEM = {
+	300, 300, 290, 275, 260, 240, 220, 200,
+	180, 160, 145, 130, 115, 100, 90, 80
+};
+
+// Oversampling state, only used within the interrupt handler.
+// sample_axis is the axis (0 = x, 1 = y) that the conversion which has
+// just completed belongs to.
+static uint8_t sample_axis;
+static uint8_t samples_taken;
+static uint16_t sample_sum;
+static uint16_t sample_min;
+static uint16_t sample_max;
+
+// Filtered values for each axis, as a sum of JOYSTICK_OVERSAMPLE samples
+// (i.e. with JOYSTICK_OVERSAMPLE_SHIFT fractional bits)
+static uint16_t filtered[2];
+
+// Filtered peak-to-peak noise for each axis, in 1/16ths of a count
+static volatile uint16_t noise[2];
+
+// Zone the interrupt handler last saw the joystick in
+static uint8_t isr_zone;
+
+// Queue of zone changes. The interrupt handler adds to the head and
+// should_joystick_move() removes from the tail. Must be a power of 2.
+// If it fills up, later changes are dropped (rather than any already
+// queued) and zone_queue_overflowed is set.
+#define ZONE_QUEUE_SIZE 8
+static volatile uint8_t zone_queue[ZONE_QUEUE_SIZE];
+static volatile uint8_t zone_queue_head;
+static volatile uint8_t zone_queue_tail;
+static volatile uint8_t zone_queue_overflowed;
+
+// The calibration currently in use
+static JoystickCalibration current_calibration;
+
+// Zone lookup. Each axis is split into 5 bands:
+//   0: beyond the dead zone on the low side
+//   1: beyond the diagonal dead zone (but not the dead zone) on the low side
+//   2: centre
+//   3, 4: as for 1, 0 but on the high side
+// axis_bands gives the band for every 8 counts of an axis, two bands
+// packed into each byte (low nibble first). zone_table then gives the
+// zone for each combination of bands.
+#define BAND_SHIFT 3
+#define NUM_BANDS 5
+#define BAND_ENTRIES ((WIDTH >> BAND_SHIFT) / 2)
+static uint8_t axis_bands[2][BAND_ENTRIES];
+
+static const uint8_t zone_table[NUM_BANDS][NUM_BANDS] PROGMEM = {
+	// Columns are x bands, rows are y bands
+	{TOPLEFT,    TOPLEFT,    TOP,    TOPRIGHT,    TOPRIGHT},
+	{TOPLEFT,    TOPLEFT,    CENTRE, TOPRIGHT,    TOPRIGHT},
+	{LEFT,       CENTRE,     CENTRE, CENTRE,      RIGHT},
+	{BOTTOMLEFT, BOTTOMLEFT, CENTRE, BOTTOMRIGHT, BOTTOMRIGHT},
+	{BOTTOMLEFT, BOTTOMLEFT, BOTTOM, BOTTOMRIGHT, BOTTOMRIGHT}
+};
+
+static void build_axis_bands(uint8_t axis, uint16_t centre, uint16_t min, uint16_t max, uint8_t dead_zone);
+static uint8_t get_axis_band(uint8_t axis, uint16_t value);
+static void update_deflection(uint8_t axis, uint16_t value);
+static uint16_t get_repeat_delay(void);
+static void queue_zone_event(uint8_t zone);
+
+// Sample counting for the sample rate statistic. The samples are
+// counted over each second (timed by joystick_timer_tick()) and the
+// count for the last whole second kept, so the count can't overflow
+// however long it is between looking at it.
+#define RATE_PERIOD_MS 1000
+static volatile uint16_t sample_count;
+static volatile uint16_t sample_rate;
+static uint16_t rate_time_left;
 
 void init_joystick(void) {
 	// Disable interrupts so we can be sure that the interrupt
 	// doesn't fire halfway through.
 	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
 	cli();
-	
+
 	// Set up ADC - AVCC reference, right adjust
 	// We set our input selection for X on A6
 	ADMUX = (1<<REFS0)|(1<<MUX2)|(1<<MUX1);
-	
-	// Turn on the ADC (but don't start a conversion yet).
+
+	// Turn off the digital input buffers on A6/A7 - they are only
+	// used as analog inputs and this reduces noise
+	DIDR0 |= (1<<ADC6D)|(1<<ADC7D);
+
+	// Free-running mode - a new conversion starts as soon as the
+	// last one is complete.
+	ADCSRB = 0;
+
+	// Turn on the ADC with auto-triggering (but don't start a conversion yet).
 	// Set up the conversion complete interrupt.
-	// Choose a clock divider of 64.
-	ADCSRA = (1<<ADEN)|(1<<ADIE)|(1<<ADPS2)|(1<<ADPS1);
-	
+	// Choose a clock divider of 128, giving ~4800 samples a second.
+	ADCSRA = (1<<ADEN)|(1<<ADATE)|(1<<ADIE)|(1<<ADPS2)|(1<<ADPS1)|(1<<ADPS0);
+
 	// Set starting values for this joystick
 	last_x = 512;
 	last_y = 512;
-	x_or_y = 0; //x
+	filtered[0] = 512 << JOYSTICK_OVERSAMPLE_SHIFT;
+	filtered[1] = 512 << JOYSTICK_OVERSAMPLE_SHIFT;
+	noise[0] = 0;
+	noise[1] = 0;
+	sample_axis = 0; //x
+	samples_taken = 0;
+	sample_sum = 0;
+	sample_min = 0xFFFF;
+	sample_max = 0;
+	isr_zone = CENTRE;
+	zone_queue_head = 0;
+	zone_queue_tail = 0;
+	zone_queue_overflowed = 0;
+	sample_count = 0;
+	sample_rate = 0;
+	rate_time_left = RATE_PERIOD_MS;
 	last_joystick_zone = CENTRE;
-	last_joystick_time = 0;
 	movement_value = CENTRE;
-	
+	repeat_countdown = 0;
+	repeat_pending = 0;
+	axis_deflection[0] = 0;
+	axis_deflection[1] = 0;
+	deflection = 0;
+
+	// Use the default calibration until we're told otherwise
+	JoystickCalibration calibration;
+	get_default_joystick_calibration(&calibration);
+	set_joystick_calibration(&calibration);
+
 	// Reenable interrupts
 	if(interruptsOn) {
 		sei();
 	}
-	
-	// Start the ADC conversion
+
+	// Start the first ADC conversion - the rest follow automatically
 	ADCSRA |= (1<<ADSC);
 }
 
 uint8_t should_joystick_move(void) {
-	// Disable interrupts so we can be sure that the interrupt
-	// doesn't fire halfway through.
-	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
-	cli();
-	
 	// By default we want to remain where we are
 	movement_value = CENTRE;
-	
-	// Get what zone the joystick is in
-	uint8_t current_zone = get_current_zone();
-	
-	if ((last_joystick_time != 0) && (get_clock_ticks() > last_joystick_time + REPEAT_DELAY)) {
-		// If we are currently repeating joystick movement, and
-		// it is past the time to repeat movement:
-		if (current_zone == CENTRE) {
-			// If we are currently in the centre,
-			// do nothing, and reset our joystick repeat.
-			last_joystick_time = 0;
-		} else {
-			// Otherwise,
-			// move, and get ready to repeat next time.
-			movement_value = current_zone;
-			last_joystick_time = get_clock_ticks();
-		}
-	} else if (last_joystick_time == 0) {
-		// If we are not currently repeating:
-		if (last_joystick_zone == CENTRE && current_zone != CENTRE) {
+
+	// Work through any zone changes reported by the ADC handler. Only
+	// the handler changes the head, and only we change the tail, so we
+	// don't need to turn off interrupts.
+	while (zone_queue_tail != zone_queue_head) {
+		uint8_t zone = zone_queue[zone_queue_tail];
+		zone_queue_tail = (zone_queue_tail + 1) & (ZONE_QUEUE_SIZE - 1);
+
+		if (last_joystick_zone == CENTRE) {
 			// If we are moving out of the centre,
-			// move in our desired direction and start the repeat timer
-			movement_value = current_zone;
-			last_joystick_time = get_clock_ticks();
+			// move in our desired direction
+			movement_value = zone;
+		}
+		last_joystick_zone = zone;
+
+		if (movement_value != CENTRE) {
+			// Leave any later events for next time
+			return 1;
 		}
 	}
-	
-	// Update our previous zone value
-	last_joystick_zone = current_zone;
-	
-	// Reenable interrupts
-	if(interruptsOn) {
-		sei();
+
+	// If changes were dropped, catch up with where the joystick is now
+	if (zone_queue_overflowed) {
+		zone_queue_overflowed = 0;
+		last_joystick_zone = isr_zone;
+	}
+
+	// Then repeat the movement we are holding, if it's time to
+	if (repeat_pending) {
+		repeat_pending = 0;
+		if (last_joystick_zone != CENTRE) {
+			movement_value = last_joystick_zone;
+			return 1;
+		}
 	}
-	return (movement_value != CENTRE); // True if we are not staying where we are
+
+	return 0; // Stay where we are
 }
 
 uint8_t get_last_joystick_movement_value(void) {
@@ -103,65 +232,338 @@ uint8_t get_last_joystick_movement_value(void) {
 	return movement_value;
 }
 
+void clear_joystick_events(void) {
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	zone_queue_tail = zone_queue_head;
+	zone_queue_overflowed = 0;
+	repeat_pending = 0;
+	last_joystick_zone = isr_zone;
+	if(interruptsOn) {
+		sei();
+	}
+	movement_value = CENTRE;
+}
+
+uint8_t get_joystick_deflection(void) {
+	return deflection;
+}
+
+void joystick_timer_tick(void) {
+	if (--rate_time_left == 0) {
+		sample_rate = sample_count;
+		sample_count = 0;
+		rate_time_left = RATE_PERIOD_MS;
+	}
+
+	if (repeat_countdown == 0) {
+		return;
+	}
+	repeat_countdown--;
+	if (repeat_countdown == 0 && isr_zone != CENTRE) {
+		// Repeat the movement, and work out when to do so again based
+		// on how hard the joystick is being pushed now
+		repeat_pending = 1;
+		repeat_countdown = get_repeat_delay();
+	}
+}
+
+void get_default_joystick_calibration(JoystickCalibration* calibration) {
+	calibration->centre_x = CENTRE_MID_X;
+	calibration->centre_y = CENTRE_MID_Y;
+	calibration->min_x = 0;
+	calibration->max_x = WIDTH - 1;
+	calibration->min_y = 0;
+	calibration->max_y = HEIGHT - 1;
+}
+
+uint8_t is_joystick_calibration_valid(const JoystickCalibration* calibration) {
+	return (calibration->max_x < WIDTH && calibration->max_y <= HEIGHT &&
+			calibration->centre_x >= calibration->min_x + CALIBRATION_MIN_EXTENT &&
+			calibration->centre_x + CALIBRATION_MIN_EXTENT <= calibration->max_x &&
+			calibration->centre_y >= calibration->min_y + CALIBRATION_MIN_EXTENT &&
+			calibration->centre_y + CALIBRATION_MIN_EXTENT <= calibration->max_y);
+}
+
+void set_joystick_calibration(const JoystickCalibration* calibration) {
+	// The ADC handler uses the tables, so it mustn't run while they
+	// are half built
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+
+	current_calibration = *calibration;
+	build_axis_bands(0, calibration->centre_x, calibration->min_x, calibration->max_x, DEAD_ZONE_X);
+	build_axis_bands(1, calibration->centre_y, calibration->min_y, calibration->max_y, DEAD_ZONE_Y);
+	deflection_scale_low[0] = 0xFFFFUL / (calibration->centre_x - calibration->min_x);
+	deflection_scale_high[0] = 0xFFFFUL / (calibration->max_x - calibration->centre_x);
+	deflection_scale_low[1] = 0xFFFFUL / (calibration->centre_y - calibration->min_y);
+	deflection_scale_high[1] = 0xFFFFUL / (calibration->max_y - calibration->centre_y);
+
+	if(interruptsOn) {
+		sei();
+	}
+}
+
+void get_joystick_calibration(JoystickCalibration* calibration) {
+	*calibration = current_calibration;
+}
+
+void calibrate_joystick_centre(JoystickCalibration* calibration) {
+	uint32_t sum_x = 0;
+	uint32_t sum_y = 0;
+	uint16_t samples = 0;
+	uint32_t last_time = get_clock_ticks();
+	uint32_t end_time = last_time + CALIBRATION_CENTRE_TIME;
+
+	// Take one reading each millisecond
+	while (last_time < end_time) {
+		if (get_clock_ticks() != last_time) {
+			last_time = get_clock_ticks();
+			sum_x += get_last_x();
+			sum_y += get_last_y();
+			samples++;
+		}
+	}
+
+	calibration->centre_x = sum_x / samples;
+	calibration->centre_y = sum_y / samples;
+	calibration->min_x = calibration->centre_x;
+	calibration->max_x = calibration->centre_x;
+	calibration->min_y = calibration->centre_y;
+	calibration->max_y = calibration->centre_y;
+}
+
+void calibrate_joystick_extents(JoystickCalibration* calibration) {
+	uint16_t x = get_last_x();
+	uint16_t y = get_last_y();
+	if (x < calibration->min_x) {
+		calibration->min_x = x;
+	}
+	if (x > calibration->max_x) {
+		calibration->max_x = x;
+	}
+	if (y < calibration->min_y) {
+		calibration->min_y = y;
+	}
+	if (y > calibration->max_y) {
+		calibration->max_y = y;
+	}
+}
+
+uint16_t get_joystick_sample_rate(void) {
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	uint16_t rate = sample_rate;
+	if(interruptsOn) {
+		sei();
+	}
+	return rate;
+}
+
+uint16_t get_joystick_noise_x(void) {
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	uint16_t value = noise[0];
+	if(interruptsOn) {
+		sei();
+	}
+	return value;
+}
+
+uint16_t get_joystick_noise_y(void) {
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	uint16_t value = noise[1];
+	if(interruptsOn) {
+		sei();
+	}
+	return value;
+}
+
 uint16_t get_last_x(void) {
-	return last_x;
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	uint16_t value = last_x;
+	if(interruptsOn) {
+		sei();
+	}
+	return value;
 }
 
 uint16_t get_last_y(void) {
-	return last_y;
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	uint16_t value = last_y;
+	if(interruptsOn) {
+		sei();
+	}
+	return value;
 }
 
 
 /* HELPER FUNCTIONS */
+// Note that this is called from the ADC interrupt handler
 uint8_t get_current_zone(void) {
-	// Go systematically through each zone, starting from the corners
-	if (last_x < (CENTRE_MID_X - DEAD_ZONE_DIAG) && last_y < (CENTRE_MID_Y - DEAD_ZONE_DIAG)) {
-		return TOPLEFT;
-	}
-	if (last_x > (CENTRE_MID_X + DEAD_ZONE_DIAG) && last_y < (CENTRE_MID_Y - DEAD_ZONE_DIAG)) {
-		return TOPRIGHT;
-	}
-	if (last_x < (CENTRE_MID_X - DEAD_ZONE_DIAG) && last_y > (CENTRE_MID_Y + DEAD_ZONE_DIAG)) {
-		return BOTTOMLEFT;
-	}
-	if (last_x > (CENTRE_MID_X + DEAD_ZONE_DIAG) && last_y > (CENTRE_MID_Y + DEAD_ZONE_DIAG)) {
-		return BOTTOMRIGHT;
+	uint8_t band_x = get_axis_band(0, last_x);
+	uint8_t band_y = get_axis_band(1, last_y);
+	return pgm_read_byte(&zone_table[band_y][band_x]);
+}
+
+// Fill in the band lookup for one axis. Each side of the centre has
+// its dead zones scaled to its own range, so a joystick which is
+// off-centre still needs the same relative push in each direction.
+static void build_axis_bands(uint8_t axis, uint16_t centre, uint16_t min, uint16_t max, uint8_t dead_zone) {
+	uint16_t low_dead = centre - ((uint32_t)(centre - min) * dead_zone >> 8);
+	uint16_t low_diag = centre - ((uint32_t)(centre - min) * DEAD_ZONE_DIAG >> 8);
+	uint16_t high_diag = centre + ((uint32_t)(max - centre) * DEAD_ZONE_DIAG >> 8);
+	uint16_t high_dead = centre + ((uint32_t)(max - centre) * dead_zone >> 8);
+	uint8_t entry, half, band;
+
+	for (entry = 0; entry < BAND_ENTRIES; entry++) {
+		axis_bands[axis][entry] = 0;
+		for (half = 0; half < 2; half++) {
+			// Use the middle of the range of values this entry covers
+			uint16_t value = (((entry << 1) | half) << BAND_SHIFT) + (1 << (BAND_SHIFT - 1));
+			if (value < low_dead) {
+				band = 0;
+			} else if (value < low_diag) {
+				band = 1;
+			} else if (value <= high_diag) {
+				band = 2;
+			} else if (value <= high_dead) {
+				band = 3;
+			} else {
+				band = 4;
+			}
+			axis_bands[axis][entry] |= band << (half * 4);
+		}
 	}
-	if (last_y < (CENTRE_MID_Y - DEAD_ZONE_Y)) {
-		return TOP;
+}
+
+// Returns which band (0 to 4) the given value of an axis lies in
+static uint8_t get_axis_band(uint8_t axis, uint16_t value) {
+	uint8_t index = value >> BAND_SHIFT;
+	if (index >= BAND_ENTRIES * 2) {
+		// Only possible for y, which is flipped to range from 1 to 1024
+		index = BAND_ENTRIES * 2 - 1;
 	}
-	if (last_y > (CENTRE_MID_Y + DEAD_ZONE_Y)) {
-		return BOTTOM;
+	uint8_t bands = axis_bands[axis][index >> 1];
+	if (index & 1) {
+		return bands >> 4;
 	}
-	if (last_x < (CENTRE_MID_X - DEAD_ZONE_X)) {
-		return LEFT;
+	return bands & 0x0F;
+}
+
+// Work out how far along the given axis the joystick is pushed.
+// Called from the ADC interrupt handler.
+static void update_deflection(uint8_t axis, uint16_t value) {
+	uint16_t centre = (axis == 0) ? current_calibration.centre_x : current_calibration.centre_y;
+	uint32_t scaled;
+	if (value < centre) {
+		scaled = ((uint32_t)(centre - value) * deflection_scale_low[axis]) >> 8;
+	} else {
+		scaled = ((uint32_t)(value - centre) * deflection_scale_high[axis]) >> 8;
 	}
-	if (last_x > (CENTRE_MID_X + DEAD_ZONE_X)) {
-		return RIGHT;
+	axis_deflection[axis] = (scaled > 255) ? 255 : scaled;
+	deflection = (axis_deflection[0] > axis_deflection[1]) ? axis_deflection[0] : axis_deflection[1];
+}
+
+// Returns the repeat delay for the current deflection
+static uint16_t get_repeat_delay(void) {
+	return pgm_read_word(&repeat_curve[deflection >> 4]);
+}
+
+// Add a zone change to the queue. Only called from the ADC interrupt
+// handler.
+static void queue_zone_event(uint8_t zone) {
+	uint8_t next_head = (zone_queue_head + 1) & (ZONE_QUEUE_SIZE - 1);
+	if (next_head != zone_queue_tail) {
+		zone_queue[zone_queue_head] = zone;
+		zone_queue_head = next_head;
+	} else {
+		// The queue is full. Each change already there could be a
+		// movement, so drop this one instead; should_joystick_move()
+		// catches up with the current zone once it has been through
+		// the others.
+		zone_queue_overflowed = 1;
 	}
-	return CENTRE;
 }
 
 // Interrupt handler for a conversion complete
 ISR(ADC_vect) {
+	BENCH_BEGIN(BENCH_ISR_ADC);
 	// Take the value out of the converter
 	uint16_t value = ADC;
-	
-	// Update x/y values
-	if (x_or_y == 0) {
-		last_x = value;
-	} else {
-		last_y = HEIGHT - value; // Flip this to go up->down rather than down->up
-	}
-	
-	// Change conversion to other pin
-	x_or_y = 1 - x_or_y;
-	if (x_or_y == 0) { //y->x
-		ADMUX &= ~1;
-	} else { //x->y
-		ADMUX |= 1;
-	}
-		
-	//Start the ADC conversion once more
-	ADCSRA |= (1<<ADSC);
-}
\ No newline at end of file
+
+	sample_count++;
+
+	// Add this sample to the current group
+	sample_sum += value;
+	if (value < sample_min) {
+		sample_min = value;
+	}
+	if (value > sample_max) {
+		sample_max = value;
+	}
+	samples_taken++;
+
+	// The ADC is free-running, so by the time we get here the next
+	// conversion has already started using the current input selection.
+	// We change the input one sample early so that the conversion after
+	// that is from the other axis.
+	if (samples_taken == JOYSTICK_OVERSAMPLE - 1) {
+		ADMUX ^= 1; // A6 <-> A7
+	}
+
+	if (samples_taken == JOYSTICK_OVERSAMPLE) {
+		// We have a full group - filter it in. The sum has
+		// JOYSTICK_OVERSAMPLE_SHIFT fractional bits, as does the
+		// filtered value.
+		int16_t difference = (int16_t)sample_sum - (int16_t)filtered[sample_axis];
+		filtered[sample_axis] += difference >> JOYSTICK_FILTER_SHIFT;
+
+		// Track noise as a filtered peak-to-peak value (x16)
+		int16_t noise_difference = (int16_t)((sample_max - sample_min) << 4) - (int16_t)noise[sample_axis];
+		noise[sample_axis] += noise_difference >> 4;
+
+		// Update x/y values
+		value = filtered[sample_axis] >> JOYSTICK_OVERSAMPLE_SHIFT;
+		if (sample_axis == 0) {
+			last_x = value;
+		} else {
+			value = HEIGHT - value; // Flip this to go up->down rather than down->up
+			last_y = value;
+		}
+		update_deflection(sample_axis, value);
+
+		// Start the next group on the other axis
+		sample_axis ^= 1;
+		samples_taken = 0;
+		sample_sum = 0;
+		sample_min = 0xFFFF;
+		sample_max = 0;
+
+		// Report any change in zone
+		uint8_t zone = get_current_zone();
+		if (zone != isr_zone) {
+			if (zone == CENTRE) {
+				// Stop repeating
+				repeat_countdown = 0;
+				repeat_pending = 0;
+			} else if (isr_zone == CENTRE) {
+				// Start repeating after a delay. (If we're moving between
+				// outer zones we just carry on with the current delay.)
+				repeat_countdown = get_repeat_delay();
+				if (repeat_countdown < INITIAL_REPEAT_DELAY) {
+					repeat_countdown = INITIAL_REPEAT_DELAY;
+				}
+			}
+			isr_zone = zone;
+			queue_zone_event(zone);
+
+			// Timestamp this input for latency measurement
+			latency_input_isr(LATENCY_SOURCE_JOYSTICK);
+		}
+	}
+	BENCH_END(BENCH_ISR_ADC);
+}
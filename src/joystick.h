@@ -23,6 +23,12 @@
  *|_____|__7__|_____|
  *
  * This allows for diagonal movement to be more easily activated.
+ *
+ * The ADC runs continuously, taking JOYSTICK_OVERSAMPLE samples of one
+ * axis before switching to the other. Each group of samples is summed
+ * and then smoothed with a simple IIR filter (all in fixed point) so
+ * that a single noisy reading can't flick the joystick into another
+ * zone.
  */ 
 
 
@@ -46,19 +52,52 @@
 #define WIDTH 1024
 #define HEIGHT 1024
 
-// Center position
+// Default center position, used until the joystick has been calibrated.
 // This is calibrated for my joystick; I dunno if this is the same for all of them.
 #define CENTRE_MID_X 515
 #define CENTRE_MID_Y 545
 
-// Dead zone values
-// Given by the distances between the center and the edges (or the diagonal corner for corner zones)
-#define DEAD_ZONE_X 40
-#define DEAD_ZONE_Y 50
-#define DEAD_ZONE_DIAG 31
+// Dead zone sizes, as a fraction (out of 256) of the distance from the
+// centre to the edge of the joystick's range on that side. These give
+// the distances between the center and the edges (or the diagonal
+// corner for corner zones) - roughly 40, 50 and 31 for the default
+// calibration.
+#define DEAD_ZONE_X 20
+#define DEAD_ZONE_Y 25
+#define DEAD_ZONE_DIAG 16
+
+// Time spent averaging the centre position when calibrating (ms)
+#define CALIBRATION_CENTRE_TIME 500
+
+// Smallest distance from the centre to each edge which is accepted as
+// a valid calibration
+#define CALIBRATION_MIN_EXTENT 128
+
+// The measured range of a joystick. All values are in the same units
+// as get_last_x()/get_last_y().
+typedef struct {
+	uint16_t centre_x;
+	uint16_t centre_y;
+	uint16_t min_x;
+	uint16_t max_x;
+	uint16_t min_y;
+	uint16_t max_y;
+} JoystickCalibration;
 
-/* Initialises the joystick hardware and sets it up to start converting joystick analog values
- * to digital ones.
+// Number of ADC samples summed for each filtered reading of an axis.
+// Must be a power of two no greater than 64.
+#define JOYSTICK_OVERSAMPLE 8
+#define JOYSTICK_OVERSAMPLE_SHIFT 3
+
+// Strength of the IIR filter applied to each oversampled reading. Each
+// new reading moves the filtered value 1/(2^JOYSTICK_FILTER_SHIFT) of
+// the way towards it.
+#define JOYSTICK_FILTER_SHIFT 2
+
+/* Initialises the joystick hardware and starts the ADC free-running,
+ * alternating between the X and Y axes. Samples are oversampled and
+ * filtered in the ADC interrupt, and any change in zone is queued as
+ * an event.
  */
 void init_joystick(void);
 
@@ -66,6 +105,12 @@ void init_joystick(void);
  * To be more specific, a joystick movement happens when the player either moves
  * from the center to one of the outside areas, or if they've been around the
  * outside for longer than an internal delay value.
+ *
+ * Zone changes are taken from the queue filled by the ADC interrupt, so
+ * movements out of the centre are not missed if this isn't called for a
+ * while. Repeats are signalled by the timer; the harder the joystick is
+ * pushed, the quicker they come. Repeats which come while this isn't
+ * being called aren't saved up - at most one is waiting.
  */
 uint8_t should_joystick_move(void);
 
@@ -74,12 +119,73 @@ uint8_t should_joystick_move(void);
  */
 uint8_t get_last_joystick_movement_value(void);
 
+/* Discards any queued zone changes and stops any repeating movement.
+ * Should be called when returning to gameplay after the joystick has
+ * been ignored for a while.
+ */
+void clear_joystick_events(void);
+
+/* Returns how far the joystick is pushed, from 0 (centre) to 255 (the
+ * edge of its range), along whichever axis it is pushed furthest.
+ */
+uint8_t get_joystick_deflection(void);
+
+/* Counts down to the next repeated movement, and times the sample rate
+ * statistic. Called from the timer 0 interrupt handler every millisecond.
+ */
+void joystick_timer_tick(void);
+
+/* CALIBRATION */
+/* Fills in the default calibration, based on the values above.
+ */
+void get_default_joystick_calibration(JoystickCalibration* calibration);
+
+/* Returns whether the given calibration is sensible (i.e. the centre lies
+ * within the range and each edge is far enough from it).
+ */
+uint8_t is_joystick_calibration_valid(const JoystickCalibration* calibration);
+
+/* Use the given calibration from now on. This builds the lookup tables
+ * used to find which zone the joystick is in.
+ */
+void set_joystick_calibration(const JoystickCalibration* calibration);
+
+/* Copies the calibration currently in use.
+ */
+void get_joystick_calibration(JoystickCalibration* calibration);
+
+/* Measures the centre position by averaging the joystick's position over
+ * CALIBRATION_CENTRE_TIME milliseconds, and resets the range to match.
+ * The joystick must be left untouched while this runs. Interrupts must be
+ * enabled.
+ */
+void calibrate_joystick_centre(JoystickCalibration* calibration);
+
+/* Widens the range of the calibration to include the joystick's current
+ * position. Should be called repeatedly while the joystick is moved
+ * around its full range.
+ */
+void calibrate_joystick_extents(JoystickCalibration* calibration);
+
+/* STATISTICS */
+/* Returns the number of ADC samples taken in the last whole second (0
+ * during the first second after initialisation).
+ */
+uint16_t get_joystick_sample_rate(void);
+
+/* Returns the average peak-to-peak noise seen within each group of
+ * oversampled readings of the x/y axis, in 1/16ths of an ADC count.
+ */
+uint16_t get_joystick_noise_x(void);
+uint16_t get_joystick_noise_y(void);
+
 /* HELPER FUNCTIONS */
-// Returns the last x/y value of the joystick
+// Returns the last (filtered) x/y value of the joystick
 uint16_t get_last_x(void);
 uint16_t get_last_y(void);
 
-// Finds the current zone the joystick is in
+// Finds the current zone the joystick is in, by looking up which band of
+// the calibrated range each axis is in
 uint8_t get_current_zone(void);
 
 #endif /* JOYSTICK_H_ */
\ No newline at end of file
@@ -0,0 +1,188 @@
+/*
+ * latency.c
+ *
+ * Written by Sean Manson
+ *
+ * Input-to-display latency measurement. Only built when
+ * LATENCY_PROFILE is defined.
+ */
+
+#include "latency.h"
+
+#ifdef LATENCY_PROFILE
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+
+#include "timer0.h"
+#include "terminalio.h"
+
+// Stages we keep histograms for
+#define STAGE_QUEUE 0
+#define STAGE_RENDER 1
+#define STAGE_TOTAL 2
+#define NUM_STAGES 3
+
+// Histogram buckets. Values are kept in units of 8us (one count of
+// timer 0). The first 8 buckets are 8us wide; after that each power
+// of two is split into 4 buckets, so the bucket width doubles every
+// 4 buckets. 48 buckets covers up to ~65ms; anything longer ends up
+// in the last bucket.
+#define NUM_BUCKETS 48
+
+static uint16_t histogram[NUM_STAGES][NUM_BUCKETS];
+static uint16_t num_samples;
+static uint16_t max_latency[NUM_STAGES];
+
+// Time of the last interrupt from each input source
+static volatile uint32_t isr_time[LATENCY_NUM_SOURCES];
+
+// The input which is currently making its way to the display.
+// A zero value for pending_active means there is no such input.
+static uint8_t pending_active;
+static uint32_t pending_isr_time;
+static uint32_t pending_decode_time;
+
+static void record(uint8_t stage, uint32_t micros);
+static uint8_t get_bucket(uint16_t value);
+static uint16_t get_bucket_limit(uint8_t bucket);
+static uint16_t get_percentile(uint8_t stage, uint8_t percent);
+
+void init_latency(void) {
+	uint8_t stage, bucket;
+	for (stage = 0; stage < NUM_STAGES; stage++) {
+		for (bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+			histogram[stage][bucket] = 0;
+		}
+		max_latency[stage] = 0;
+	}
+	num_samples = 0;
+	pending_active = 0;
+}
+
+void latency_input_isr(uint8_t source) {
+	isr_time[source] = get_clock_micros();
+}
+
+void latency_input_decoded(uint8_t source) {
+	// The timestamp is written by an interrupt handler, so we turn
+	// interrupts off while copying it
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	pending_isr_time = isr_time[source];
+	if(interruptsOn) {
+		sei();
+	}
+	pending_decode_time = get_clock_micros();
+	pending_active = 1;
+}
+
+void latency_frog_drawn(void) {
+	if (!pending_active) {
+		return;
+	}
+	uint32_t now = get_clock_micros();
+	record(STAGE_QUEUE, pending_decode_time - pending_isr_time);
+	record(STAGE_RENDER, now - pending_decode_time);
+	record(STAGE_TOTAL, now - pending_isr_time);
+	if (num_samples < 0xFFFF) {
+		num_samples++;
+	}
+	pending_active = 0;
+}
+
+void latency_input_done(void) {
+	pending_active = 0;
+}
+
+void latency_report(uint8_t screen_x, uint8_t screen_y) {
+	static const char stage_names[NUM_STAGES][7] PROGMEM = {"Queue", "Render", "Total"};
+	uint8_t stage;
+
+	move_cursor(SCREENSPACE(screen_x, screen_y));
+	printf_P(PSTR("Latency (us), %u inputs:"), num_samples);
+	move_cursor(SCREENSPACE(screen_x, screen_y+1));
+	printf_P(PSTR("         p50    p90    p99    max"));
+	for (stage = 0; stage < NUM_STAGES; stage++) {
+		move_cursor(SCREENSPACE(screen_x, screen_y+2+stage));
+		printf_P(PSTR("%-7S%6u %6u %6u %6u"), stage_names[stage],
+				get_percentile(stage, 50), get_percentile(stage, 90),
+				get_percentile(stage, 99), max_latency[stage]);
+	}
+}
+
+
+/* HELPER FUNCTIONS */
+// Add a measurement (in microseconds) to the given stage's histogram
+static void record(uint8_t stage, uint32_t micros) {
+	uint16_t value;
+	if (micros > 0xFFFF) {
+		value = 0xFFFF;
+	} else {
+		value = micros;
+	}
+	if (value > max_latency[stage]) {
+		max_latency[stage] = value;
+	}
+	uint8_t bucket = get_bucket(value >> 3);
+	if (histogram[stage][bucket] < 0xFFFF) {
+		histogram[stage][bucket]++;
+	}
+}
+
+// Returns the bucket a value (in 8us units) belongs in
+static uint8_t get_bucket(uint16_t value) {
+	uint8_t msb = 3;
+	uint8_t bucket;
+
+	if (value < 8) {
+		return value;
+	}
+	// Find the most significant bit, then use the two bits below it
+	// to choose one of four buckets for this power of two
+	while (value >> (msb+1)) {
+		msb++;
+	}
+	bucket = 8 + (msb-3)*4 + ((value >> (msb-2)) & 3);
+	if (bucket >= NUM_BUCKETS) {
+		bucket = NUM_BUCKETS-1;
+	}
+	return bucket;
+}
+
+// Returns the (exclusive) upper limit of a bucket, in microseconds
+static uint16_t get_bucket_limit(uint8_t bucket) {
+	if (bucket < 8) {
+		return (bucket+1)*8;
+	}
+	uint8_t msb = 3 + (bucket-8)/4;
+	uint8_t sub = (bucket-8)%4;
+	uint32_t limit = ((uint32_t)(5+sub) << (msb-2))*8;
+	if (limit > 0xFFFF) {
+		return 0xFFFF;
+	}
+	return limit;
+}
+
+// Returns the given percentile of a stage, in microseconds, to the
+// resolution of the histogram
+static uint16_t get_percentile(uint8_t stage, uint8_t percent) {
+	uint32_t target = ((uint32_t)num_samples*percent + 99)/100;
+	uint32_t seen = 0;
+	uint8_t bucket;
+
+	if (num_samples == 0) {
+		return 0;
+	}
+	for (bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+		seen += histogram[stage][bucket];
+		if (seen >= target) {
+			return get_bucket_limit(bucket);
+		}
+	}
+	return max_latency[stage];
+}
+
+#endif /* LATENCY_PROFILE */
@@ -0,0 +1,79 @@
+/*
+ * latency.h
+ *
+ * Author: Sean Manson
+ *
+ * Input-to-display latency measurement.
+ *
+ * When the firmware is built with LATENCY_PROFILE defined, each input
+ * is timestamped in its interrupt handler (timer 0 for the buttons,
+ * USART RX for serial and ADC for the joystick). When the main loop
+ * decodes that input into a frog movement the timestamp is picked up
+ * and carried through move_frog_*(), and the measurement is closed off
+ * once the SPI update drawing the frog in its new position has been
+ * sent to the LED matrix.
+ *
+ * Each measurement is split into two stages:
+ *    - queue:  interrupt -> input decoded in the main loop
+ *    - render: input decoded -> frog pixel sent over SPI
+ * and a histogram is kept of each stage and of the total. The
+ * 50th/90th/99th percentiles can then be printed over serial.
+ *
+ * Without LATENCY_PROFILE all of these functions are empty and compile
+ * away to nothing.
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+
+// Input sources
+#define LATENCY_SOURCE_BUTTON 0
+#define LATENCY_SOURCE_SERIAL 1
+#define LATENCY_SOURCE_JOYSTICK 2
+#define LATENCY_NUM_SOURCES 3
+
+#ifdef LATENCY_PROFILE
+
+/* Clears all recorded measurements.
+ */
+void init_latency(void);
+
+/* Record that an input has just arrived from the given source.
+ * Should be called from that source's interrupt handler.
+ */
+void latency_input_isr(uint8_t source);
+
+/* Record that the last input from the given source has been decoded
+ * into a movement, which is about to be carried out.
+ */
+void latency_input_decoded(uint8_t source);
+
+/* Record that the frog has just been drawn. If a decoded input is
+ * waiting on this then its measurement is completed.
+ */
+void latency_frog_drawn(void);
+
+/* Discard any decoded input that never resulted in the frog being
+ * drawn (e.g. a movement into a wall).
+ */
+void latency_input_done(void);
+
+/* Print the recorded percentiles to the terminal, starting at the
+ * given screen position.
+ */
+void latency_report(uint8_t screen_x, uint8_t screen_y);
+
+#else
+
+static inline void init_latency(void) {}
+static inline void latency_input_isr(uint8_t source) {}
+static inline void latency_input_decoded(uint8_t source) {}
+static inline void latency_frog_drawn(void) {}
+static inline void latency_input_done(void) {}
+static inline void latency_report(uint8_t screen_x, uint8_t screen_y) {}
+
+#endif /* LATENCY_PROFILE */
+
+#endif /* LATENCY_H_ */
@@ -2,13 +2,18 @@
  * ledmatrix.c
  *
  * Author: Peter Sutton
+ * Edited: Sean Manson
  * 
  * See the LED matrix Reference for details of the SPI commands used.
+ * Each panel has its own controller, which only knows about its own
+ * 16x8 pixels, so coordinates are turned into a panel number and a
+ * position within that panel here.
  */ 
 
 #include <avr/io.h>
 #include "ledmatrix.h"
 #include "spi.h"
+#include "bench.h"
 
 #define CMD_UPDATE_ALL 0x00
 #define CMD_UPDATE_PIXEL 0x01
@@ -17,63 +22,184 @@
 #define CMD_SHIFT_DISPLAY 0x04
 #define CMD_CLEAR_SCREEN 0x0F
 
+// Number of the panel which shows pixel (x, y) of the display
+#define PANEL_AT(x, y) (((y) / PANEL_NUM_ROWS) * MATRIX_PANELS_ACROSS + \
+		(x) / PANEL_NUM_COLUMNS)
+
+// First row shown by the pixel and row functions
+static uint8_t viewport = 0;
+
+#if MATRIX_NUM_PANELS > 1
+// The panel the SPI bytes are going to
+static uint8_t selected_panel;
+
+// Send the following bytes to the given panel. Must only be called
+// between commands.
+static void select_panel(uint8_t panel) {
+	if(panel != selected_panel) {
+		spi_select_slave(panel);
+		selected_panel = panel;
+	}
+}
+#else
+// There is only one panel, and it is always selected
+#define select_panel(panel) ((void)0)
+#endif
+
 void ledmatrix_setup(void) {
 	// Setup SPI - we divide the clock by 128.
 	// (This speed guarantees the SPI buffer will never overflow.)
+	// This selects panel 0.
 	spi_setup_master(128);
+#if MATRIX_NUM_PANELS > 1
+	spi_setup_slave_selects(MATRIX_NUM_PANELS);
+	selected_panel = 0;
+#endif
+}
+
+void ledmatrix_set_viewport(uint8_t first_row) {
+	viewport = first_row;
+}
+
+uint8_t ledmatrix_get_viewport(void) {
+	return viewport;
 }
 
 void ledmatrix_update_all(MatrixData data) {
-	(void)spi_send_byte(CMD_UPDATE_ALL);
-	for(uint8_t y=0; y<MATRIX_NUM_ROWS; y++) {
-		for(uint8_t x=0; x<MATRIX_NUM_COLUMNS; x++) {
-			(void)spi_send_byte(data[x][y]);
+	BENCH_BEGIN(BENCH_SPI_BURST);
+	for(uint8_t panel=0; panel<MATRIX_NUM_PANELS; panel++) {
+		uint8_t left = (panel % MATRIX_PANELS_ACROSS) * PANEL_NUM_COLUMNS;
+		uint8_t bottom = (panel / MATRIX_PANELS_ACROSS) * PANEL_NUM_ROWS;
+		select_panel(panel);
+		(void)spi_send_byte(CMD_UPDATE_ALL);
+		for(uint8_t y=0; y<PANEL_NUM_ROWS; y++) {
+			for(uint8_t x=0; x<PANEL_NUM_COLUMNS; x++) {
+				(void)spi_send_byte(data[left+x][bottom+y]);
+			}
+		}
+	}
+	BENCH_END(BENCH_SPI_BURST);
+}
+
+// Show the same picture on every panel
+void ledmatrix_update_all_panels(PanelData data) {
+	BENCH_BEGIN(BENCH_SPI_BURST);
+	for(uint8_t panel=0; panel<MATRIX_NUM_PANELS; panel++) {
+		select_panel(panel);
+		(void)spi_send_byte(CMD_UPDATE_ALL);
+		for(uint8_t y=0; y<PANEL_NUM_ROWS; y++) {
+			for(uint8_t x=0; x<PANEL_NUM_COLUMNS; x++) {
+				(void)spi_send_byte(data[x][y]);
+			}
 		}
 	}
+	BENCH_END(BENCH_SPI_BURST);
 }
 
 void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel) {
+	// Rows below the viewport wrap around to large numbers, so are
+	// skipped along with those above it
+	y -= viewport;
+	if(x >= MATRIX_NUM_COLUMNS || y >= MATRIX_NUM_ROWS) {
+		return;
+	}
+	BENCH_BEGIN(BENCH_SPI_BURST);
+	select_panel(PANEL_AT(x, y));
 	(void)spi_send_byte(CMD_UPDATE_PIXEL);
 	(void)spi_send_byte( ((y & 0x07)<<4) | (x & 0x0F));
 	(void)spi_send_byte(pixel);
+	BENCH_END(BENCH_SPI_BURST);
 }
 
+// Update a whole row of the display: each panel across is sent its
+// part of the row in turn
 void ledmatrix_update_row(uint8_t y, MatrixRow row) {
-	(void)spi_send_byte(CMD_UPDATE_ROW);
-	(void)spi_send_byte(y & 0x07);	// row number
-	for(uint8_t x = 0; x<MATRIX_NUM_COLUMNS; x++) {
-		(void)spi_send_byte(row[x]);
+	y -= viewport;
+	if(y >= MATRIX_NUM_ROWS) {
+		return;
+	}
+	BENCH_BEGIN(BENCH_SPI_BURST);
+	for(uint8_t across=0; across<MATRIX_PANELS_ACROSS; across++) {
+		select_panel(PANEL_AT(across * PANEL_NUM_COLUMNS, y));
+		(void)spi_send_byte(CMD_UPDATE_ROW);
+		(void)spi_send_byte(y & 0x07);	// row number
+		for(uint8_t x = 0; x<PANEL_NUM_COLUMNS; x++) {
+			(void)spi_send_byte(row[across * PANEL_NUM_COLUMNS + x]);
+		}
 	}
+	BENCH_END(BENCH_SPI_BURST);
 }
 
+// Update a whole column of the display: each panel up is sent its part
+// of the column in turn
 void ledmatrix_update_column(uint8_t x, MatrixColumn col) {
+	if(x >= MATRIX_NUM_COLUMNS) {
+		return;
+	}
+	BENCH_BEGIN(BENCH_SPI_BURST);
+	for(uint8_t up=0; up<MATRIX_PANELS_UP; up++) {
+		select_panel(PANEL_AT(x, up * PANEL_NUM_ROWS));
+		(void)spi_send_byte(CMD_UPDATE_COL);
+		(void)spi_send_byte(x & 0x0F); // column number
+		for(uint8_t y = 0; y<PANEL_NUM_ROWS; y++) {
+			(void)spi_send_byte(col[up * PANEL_NUM_ROWS + y]);
+		}
+	}
+	BENCH_END(BENCH_SPI_BURST);
+}
+
+// Update a column from a bit mask (bit 7 for row 7 down to bit 0 for
+// row 0), showing set bits in the given colour and clearing the rest.
+// (Only the bottom row of panels is changed.)
+void ledmatrix_update_column_mask(uint8_t x, uint8_t mask, PixelColour pixel) {
+	if(x >= MATRIX_NUM_COLUMNS) {
+		return;
+	}
+	BENCH_BEGIN(BENCH_SPI_BURST);
+	select_panel(PANEL_AT(x, 0));
 	(void)spi_send_byte(CMD_UPDATE_COL);
 	(void)spi_send_byte(x & 0x0F); // column number
-	for(uint8_t y = 0; y<MATRIX_NUM_ROWS; y++) {
-		(void)spi_send_byte(col[y]);
+	for(uint8_t y = 0; y<PANEL_NUM_ROWS; y++) {
+		(void)spi_send_byte((mask & 1) ? pixel : 0);
+		mask >>= 1;
+	}
+	BENCH_END(BENCH_SPI_BURST);
+}
+
+// The shift and clear commands are sent to every panel. Each panel's
+// picture is shifted on its own - pixels don't move from one panel to
+// the next, and the column or row shifted in to each panel is blank.
+static void send_shift(uint8_t directions) {
+	BENCH_BEGIN(BENCH_SPI_BURST);
+	for(uint8_t panel=0; panel<MATRIX_NUM_PANELS; panel++) {
+		select_panel(panel);
+		(void)spi_send_byte(CMD_SHIFT_DISPLAY);
+		(void)spi_send_byte(directions);
 	}
+	BENCH_END(BENCH_SPI_BURST);
 }
 
 void ledmatrix_shift_display_left(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x02);
+	send_shift(0x02);
 }
 
 void ledmatrix_shift_display_right(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x01);
+	send_shift(0x01);
 }
 
 void ledmatrix_shift_display_up(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x08);
+	send_shift(0x08);
 }
 
 void ledmatrix_shift_display_down(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x04);
+	send_shift(0x04);
 }
 
 void ledmatrix_clear(void) {
-	(void)spi_send_byte(CMD_CLEAR_SCREEN);
+	BENCH_BEGIN(BENCH_SPI_BURST);
+	for(uint8_t panel=0; panel<MATRIX_NUM_PANELS; panel++) {
+		select_panel(panel);
+		(void)spi_send_byte(CMD_CLEAR_SCREEN);
+	}
+	BENCH_END(BENCH_SPI_BURST);
 }
\ No newline at end of file
@@ -2,7 +2,24 @@
  * ledmatrix.h
  *
  * Author: Peter Sutton
- */ 
+ * Edited: Sean Manson
+ *
+ * The display can be made up of several LED matrix panels, each 16
+ * columns by 8 rows, sharing the SPI bus (each with its own slave
+ * select line - see spi.h). There are MATRIX_PANELS_ACROSS panels side
+ * by side and MATRIX_PANELS_UP of those rows of panels stacked up
+ * (both 1 unless defined otherwise when building, e.g. with
+ * -DMATRIX_PANELS_ACROSS=2 -DMATRIX_PANELS_UP=2 for a 32x16 display).
+ * Panel 0 is at the bottom left, then they go across and up. The
+ * functions below treat them as one display and send each panel only
+ * the commands for its part, so the cost of updating a row or the
+ * whole display goes up in proportion to the number of panels.
+ *
+ * The pixel and row functions take a row number relative to the
+ * viewport (see ledmatrix_set_viewport()), so the display can show
+ * part of something taller than itself. Anything outside the viewport
+ * isn't sent. The other functions act on the display as it is.
+ */
 
 
 #ifndef LEDMATRIX_H_
@@ -11,28 +28,49 @@
 #include <stdint.h>
 #include "pixel_colour.h"
 
-// The matrix has 16 columns (x ranges from 0 to 15, left to right) and 
+// Each panel has 16 columns (x ranges from 0 to 15, left to right) and
 // 8 rows (y ranges from 0 to 7, bottom to top)
-#define MATRIX_NUM_COLUMNS 16
-#define MATRIX_NUM_ROWS 8
+#define PANEL_NUM_COLUMNS 16
+#define PANEL_NUM_ROWS 8
+
+#ifndef MATRIX_PANELS_ACROSS
+#define MATRIX_PANELS_ACROSS 1
+#endif
+#ifndef MATRIX_PANELS_UP
+#define MATRIX_PANELS_UP 1
+#endif
+#define MATRIX_NUM_PANELS (MATRIX_PANELS_ACROSS * MATRIX_PANELS_UP)
+
+// The whole display
+#define MATRIX_NUM_COLUMNS (PANEL_NUM_COLUMNS * MATRIX_PANELS_ACROSS)
+#define MATRIX_NUM_ROWS (PANEL_NUM_ROWS * MATRIX_PANELS_UP)
 
 // Data types which can be used to store display information
 typedef PixelColour MatrixData[MATRIX_NUM_COLUMNS][MATRIX_NUM_ROWS];
 typedef PixelColour MatrixRow[MATRIX_NUM_COLUMNS];
 typedef PixelColour MatrixColumn[MATRIX_NUM_ROWS];
+typedef PixelColour PanelData[PANEL_NUM_COLUMNS][PANEL_NUM_ROWS];
 
 // Setup SPI communication with the LED matrix
 void ledmatrix_setup(void);
 
+// Set the first row shown (at the bottom of the display) by the pixel
+// and row functions. Row y given to them is shown in row y-first_row of
+// the display. (0 to start with.)
+void ledmatrix_set_viewport(uint8_t first_row);
+uint8_t ledmatrix_get_viewport(void);
+
 // Functions to update the display
 void ledmatrix_update_all(MatrixData data);
+void ledmatrix_update_all_panels(PanelData data);
 void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel);
 void ledmatrix_update_row(uint8_t y, MatrixRow row);
 void ledmatrix_update_column(uint8_t x, MatrixColumn col);
+void ledmatrix_update_column_mask(uint8_t x, uint8_t mask, PixelColour pixel);
 void ledmatrix_shift_display_left(void);
 void ledmatrix_shift_display_right(void);
 void ledmatrix_shift_display_up(void);
 void ledmatrix_shift_display_down(void);
 void ledmatrix_clear(void);
 
-#endif /* LEDMATRIX_H_ */
\ No newline at end of file
+#endif /* LEDMATRIX_H_ */
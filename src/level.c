@@ -24,14 +24,14 @@
 #define DIRECTION_REVERSE -1
 
 uint8_t level; // Current level
-uint16_t difficulty; // Current difficulty
+uint16_t level_difficulty; // Current difficulty
 int8_t direction; // Direction lanes on this level should be going.
 
 
 // Set the level to the starting level
 void init_level(void) {
 	level = STARTING_LEVEL;
-	difficulty = STARTING_DIFFICULTY;
+	level_difficulty = STARTING_DIFFICULTY;
 	direction = DIRECTION_STANDARD;
 }
 
@@ -39,7 +39,7 @@ void init_level(void) {
 void increment_level(void) {
 	if (level < MAX_LEVEL) {
 		level++;
-		difficulty += get_current_ramp_up();
+		level_difficulty += get_current_ramp_up();
 	}
 }
 
@@ -56,28 +56,23 @@ int8_t get_level_direction(void) {
 	return direction;
 }
 
-// Return the current difficulty
-uint16_t get_difficulty(void) {
-	return difficulty;
-}
-
 // Get the factor values for displaying the current speed
 uint8_t get_factor_ones(void) {
-	return difficulty/100;
+	return level_difficulty/100;
 }
 uint8_t get_factor_tenthshundreths(void) {
-	return difficulty%100;
+	return level_difficulty%100;
 }
 
 /* Helper functions */
 uint16_t get_current_ramp_up(void) {
-	if (difficulty >= 500) {
+	if (level_difficulty >= 500) {
 		return RAMP_UP_FACTOR_500;
-	} else if (difficulty >= 400) {
+	} else if (level_difficulty >= 400) {
 		return RAMP_UP_FACTOR_400;
-	} else if (difficulty >= 300) {
+	} else if (level_difficulty >= 300) {
 		return RAMP_UP_FACTOR_300;
-	} else if (difficulty >= 200) {
+	} else if (level_difficulty >= 200) {
 		return RAMP_UP_FACTOR_200;
 	} else {
 		return RAMP_UP_FACTOR_100;
@@ -38,9 +38,15 @@ void flip_level_direction(void);
  */
 int8_t get_level_direction(void);
 
+/* The current difficulty. Only to be changed by level.c.
+ */
+extern uint16_t level_difficulty;
+
 /* Returns the current difficulty, as a value ready to be divided by 1000.
  */
-uint16_t get_difficulty(void);
+static inline uint16_t get_difficulty(void) {
+	return level_difficulty;
+}
 
 /* Returns the ones place of the speed factor.
  * The speed factor is the current speed of the game, and is equal to
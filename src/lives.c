@@ -9,7 +9,7 @@
 #define BASE_STARTING_LIVES 4
 #define MAX_LIVES 5
 
-uint8_t lives = 0; //display nothing by default
+uint8_t lives_remaining = 0; //display nothing by default
 
 // Set up the registers to display lives to LEDs
 void init_lives_display(void) {
@@ -20,40 +20,34 @@ void init_lives_display(void) {
 
 // Reset lives to the starting value
 void init_lives(void) {
-	lives = BASE_STARTING_LIVES;
+	lives_remaining = BASE_STARTING_LIVES;
 	update_lives_display();
 }
 
 // Detract a life and update display
 void lose_life(void) {
-	if (lives > 0) {
-		lives--;
+	if (lives_remaining > 0) {
+		lives_remaining--;
 	}
 	update_lives_display();
 }
 
 // Add a life and update display
 void gain_life(void) {
-	if (lives < MAX_LIVES) {
-		lives++;
+	if (lives_remaining < MAX_LIVES) {
+		lives_remaining++;
 	}
 	update_lives_display();
 }
 
-// Get the number of lifes
-// Given as the internal number of lives - 1
-uint8_t get_lives(void) {
-	return (lives - 1);
-}
-
 // Returns whether we are at our maximum lives.
 uint8_t get_at_max_lives(void) {
-	return (lives == MAX_LIVES);
+	return (lives_remaining == MAX_LIVES);
 }
 
 // Returns true if the player is out of lives
 uint8_t player_has_lost(void) {
-	return (lives == 0);
+	return (lives_remaining == 0);
 }
 
 /* PRIVATE FUNCTIONS */
@@ -62,7 +56,7 @@ uint8_t player_has_lost(void) {
 void update_lives_display(void) {
 	PORTA &= 0xF0; //clear lives
 	uint8_t i;
-	for(i=0;i<(lives-1);i++) {
+	for(i=0;i<(lives_remaining-1);i++) {
 		PORTA |= (1 << i);
 	}
 }
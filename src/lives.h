@@ -27,10 +27,18 @@
 
 void init_lives_display(void);
 
+// Internal number of lives (see above). Only to be changed by lives.c.
+extern uint8_t lives_remaining;
+
 void init_lives(void);
 void lose_life(void);
 void gain_life(void);
-uint8_t get_lives(void);
+
+// Get the number of lives
+// Given as the internal number of lives - 1
+static inline uint8_t get_lives(void) {
+	return (lives_remaining - 1);
+}
 uint8_t get_at_max_lives(void);
 uint8_t player_has_lost(void);
 
@@ -0,0 +1,141 @@
+/*
+ * patterns.c
+ *
+ * Written by Sean Manson
+ */
+
+#include "patterns.h"
+
+// Limits on one pattern
+typedef struct {
+	uint8_t min_run; // length of each vehicle/log
+	uint8_t max_run;
+	uint8_t min_gap; // space between them
+	uint8_t max_gap;
+} PatternRule;
+
+// Limits at level 1. Lane 3 is the trucks. (With more lanes or
+// channels than this, the rules are used again in turn.)
+#define NUM_LANE_RULES 3
+#define NUM_LOG_RULES 2
+static const PatternRule lane_rules[NUM_LANE_RULES] = {
+		{ 2, 2, PATTERN_MIN_LANE_GAP, 8 },
+		{ 2, 3, PATTERN_MIN_LANE_GAP, 8 },
+		{ 3, 4, PATTERN_MIN_LANE_GAP, 7 }
+};
+static const PatternRule log_rules[NUM_LOG_RULES] = {
+		{ 3, 5, 2, PATTERN_MAX_LOG_GAP },
+		{ PATTERN_MIN_LOG_LENGTH, 4, 2, PATTERN_MAX_LOG_GAP }
+};
+
+// State of the random number generator
+static uint16_t random_state;
+
+static uint32_t generate_pattern(const PatternRule* rule);
+static uint16_t next_random(void);
+static uint8_t random_between(uint8_t low, uint8_t high);
+
+// Generate the patterns for a level
+void generate_patterns(uint16_t seed, uint8_t level,
+		uint32_t lanes[], uint8_t num_lanes, uint32_t logs[], uint8_t num_channels) {
+	PatternRule rule;
+	uint8_t i;
+
+	// Different patterns for each level of a game (but never a state
+	// of 0, which the generator would stay stuck at)
+	random_state = seed ^ (level * 0x9E37);
+	if (random_state == 0) {
+		random_state = 0xACE1;
+	}
+
+	for (i = 0; i < num_lanes; i++) {
+		// Less space between vehicles, and longer ones from level 20
+		rule = lane_rules[i % NUM_LANE_RULES];
+		rule.max_gap -= level / 25;
+		if (level >= 20) {
+			rule.max_run++;
+		}
+		lanes[i] = generate_pattern(&rule);
+	}
+	for (i = 0; i < num_channels; i++) {
+		// Shorter logs
+		rule = log_rules[i % NUM_LOG_RULES];
+		if (rule.max_run - level / 40 >= rule.min_run) {
+			rule.max_run -= level / 40;
+		} else {
+			rule.max_run = rule.min_run;
+		}
+		logs[i] = generate_pattern(&rule);
+	}
+}
+
+/* HELPER FUNCTIONS */
+// Generate one pattern which follows the given rule. The pattern starts
+// with a run at bit 0 and ends with the gap which wraps around to it.
+// (The rules above all allow a pattern to be made - the host tests
+// check this for every level.)
+static uint32_t generate_pattern(const PatternRule* rule) {
+	// can_finish[n] is whether n bits left over after a run can be
+	// filled with gaps and runs which follow the rule
+	uint8_t can_finish[PATTERN_WIDTH+1];
+	uint8_t runs = rule->max_run - rule->min_run + 1;
+	uint8_t options = (rule->max_gap - rule->min_gap + 1) * runs;
+	uint8_t left, option, tried, gap, run;
+	uint8_t position;
+	uint32_t pattern;
+
+	for (left = 0; left <= PATTERN_WIDTH; left++) {
+		can_finish[left] = (left >= rule->min_gap && left <= rule->max_gap);
+		for (gap = rule->min_gap; gap <= rule->max_gap && !can_finish[left]; gap++) {
+			for (run = rule->min_run; run <= rule->max_run && gap + run <= left; run++) {
+				if (can_finish[left - gap - run]) {
+					can_finish[left] = 1;
+					break;
+				}
+			}
+		}
+	}
+
+	// First run, starting from a random length and trying each in turn
+	run = random_between(rule->min_run, rule->max_run);
+	for (tried = 0; tried < runs && !can_finish[PATTERN_WIDTH - run]; tried++) {
+		run = (run == rule->max_run) ? rule->min_run : run + 1;
+	}
+	pattern = (1UL << run) - 1;
+	position = run;
+
+	// Then a gap and a run at a time, for as long as there's room for
+	// them and for the pattern to be finished afterwards
+	while (1) {
+		left = PATTERN_WIDTH - position;
+		option = next_random() % options;
+		for (tried = 0; tried < options; tried++) {
+			gap = rule->min_gap + option / runs;
+			run = rule->min_run + option % runs;
+			if (gap + run <= left && can_finish[left - gap - run]) {
+				break;
+			}
+			option = (option + 1 == options) ? 0 : option + 1;
+		}
+		if (tried == options) {
+			// Only the gap at the end is left
+			return pattern;
+		}
+		position += gap;
+		pattern |= ((1UL << run) - 1) << position;
+		position += run;
+	}
+}
+
+// Return the next number from a 16 bit xorshift generator
+static uint16_t next_random(void) {
+	random_state ^= random_state << 7;
+	random_state ^= random_state >> 9;
+	random_state ^= random_state << 8;
+	return random_state;
+}
+
+// Return a random number from low to high inclusive
+static uint8_t random_between(uint8_t low, uint8_t high) {
+	return low + next_random() % (high - low + 1);
+}
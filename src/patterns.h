@@ -0,0 +1,54 @@
+/*
+ * patterns.h
+ *
+ * Author: Sean Manson
+ *
+ * Generates the traffic and log patterns for each level.
+ *
+ * Each lane of traffic and each log channel is a PATTERN_WIDTH bit
+ * pattern which loops around continuously (see game.c). The patterns
+ * are made up of runs of 1s (vehicles or logs) separated by gaps of
+ * 0s, with the lengths of each chosen at random within limits for that
+ * lane or channel. The limits tighten as the level goes up (longer
+ * trucks, shorter logs, less room between vehicles).
+ *
+ * The patterns are built up one vehicle or log at a time, and each one
+ * is only placed if the rest of the pattern (including the gap where
+ * it wraps around) can still be finished within the limits. So every
+ * pattern generated can be crossed:
+ *    - every gap in the traffic is at least PATTERN_MIN_LANE_GAP wide,
+ *      so there is room for the frog to step into it and still be clear
+ *      after the next move
+ *    - every log is at least PATTERN_MIN_LOG_LENGTH long and no gap
+ *      between logs is wider than PATTERN_MAX_LOG_GAP, so there is
+ *      always a log on the display to jump to. (The two channels move
+ *      in opposite directions, so every log in one will line up with
+ *      every log in the other sooner or later.)
+ *
+ * The same seed and level always give the same patterns. The generator
+ * has its own random numbers so this doesn't depend on how rand() has
+ * been used. Generating the patterns for a level takes a few milliseconds, so
+ * it can be done as each level starts.
+ */
+
+#ifndef PATTERNS_H_
+#define PATTERNS_H_
+
+#include <stdint.h>
+
+// Number of bits in each pattern
+#define PATTERN_WIDTH 32
+
+// Limits which hold for every level (see above)
+#define PATTERN_MIN_LANE_GAP 3
+#define PATTERN_MIN_LOG_LENGTH 2
+#define PATTERN_MAX_LOG_GAP 4
+
+/* Generate the traffic patterns for num_lanes lanes (in lanes) and the
+ * log patterns for num_channels log channels (in logs) for the given
+ * level (1 to 99) from the given seed.
+ */
+void generate_patterns(uint16_t seed, uint8_t level,
+		uint32_t lanes[], uint8_t num_lanes, uint32_t logs[], uint8_t num_channels);
+
+#endif /* PATTERNS_H_ */
@@ -19,16 +19,21 @@
 #include "eeprom.h"
 #include "ledmatrix.h"
 #include "scrolling_char_display.h"
+#include "animation.h"
 #include "buttons.h"
 #include "joystick.h"
 #include "serialio.h"
 #include "terminalio.h"
 #include "sound.h"
+#include "synth.h"
 #include "score.h"
 #include "lives.h"
 #include "level.h"
 #include "timer0.h"
 #include "game.h"
+#include "latency.h"
+#include "stackcheck.h"
+#include "bench.h"
 
 // Delay settings
 #define F_CPU 8000000L
@@ -37,7 +42,11 @@
 // Function prototypes - these are defined below (after main()) in the order
 // given here
 void initialise_hardware(void);
+void initialise_joystick_calibration(void);
 void splash_screen(void);
+void draw_splash_screen(void);
+void draw_highscores(int8_t gap);
+void calibrate_joystick(void);
 void new_game(void);
 void play_game(void);
 void new_level(void);
@@ -49,7 +58,10 @@ void handle_out_of_time(void);
 void handle_lose_life(void);
 void update_status_screen(void);
 void confirmation_screen_pause(void);
+void keep_score_scrolling(void);
 void get_user_typing(char string_to_get[], uint8_t screen_x, uint8_t screen_y);
+uint8_t get_button_direction(const ButtonEvent* event);
+void move_frog_in_direction(uint8_t frog, uint8_t direction);
 uint8_t new_game_pressed(void);
 uint8_t enter_pressed(void);
 uint8_t new_game_or_enter_pressed(void);
@@ -59,20 +71,38 @@ uint8_t pause_pressed(void);
 #define ESCAPE_CHAR 27
 #define DELETE_CHAR 127
 
-// Move times for each row, given as hundredths of seconds
-#define BASE_SPEED_TRAFFIC_1 80
-#define BASE_SPEED_TRAFFIC_2 60
-#define BASE_SPEED_TRAFFIC_3 120
-#define BASE_SPEED_LOGS_1 100
-#define BASE_SPEED_LOGS_2 75
+// Each lane's position between columns (its phase) is kept as a fixed
+// point number of columns with PHASE_BITS bits after the point. It is
+// moved on by the lane's velocity (in the same units, per millisecond)
+// every millisecond, and the lane scrolls a column each time it gets to
+// PHASE_ONE_COLUMN.
+#define PHASE_BITS 24
+#define PHASE_ONE_COLUMN (1UL << PHASE_BITS)
 
 // Time permitted to get across to the other side
 #define BASE_TIME_PER_FROG 25
 
+// Speeds (pixels per second) of the scrolling messages on the LED matrix
+#define SPLASH_SCROLL_SPEED 7
+#define LEVEL_UP_SCROLL_SPEED 10
+
 // Flag for starting a new game 
 // Needed in order for the game process to run correctly
 static uint8_t new_game_flag = 0;
 
+// Number of players (frogs) in each game, chosen on the splash screen.
+// With two players, the first uses the buttons and the second the
+// joystick and the terminal.
+static uint8_t num_players = 1;
+
+// Seed for the traffic and log patterns of each level in this game
+static uint16_t game_seed;
+
+// The score shown on the LED matrix after a game, and whether it is
+// being scrolled (because it was too wide to show still)
+static char score_text[6];
+static uint8_t score_scrolling = 0;
+
 
 /////////////////////////////// main //////////////////////////////////
 int main(void) {
@@ -80,6 +110,10 @@ int main(void) {
 	// interrupts.
 	initialise_hardware();
 	
+	// Load the joystick calibration, or measure the centre if there
+	// isn't one. (This needs interrupts on.)
+	initialise_joystick_calibration();
+	
 	// Show the splash screen message. Returns when display
 	// is complete
 	play_tune_startup();
@@ -108,7 +142,7 @@ void initialise_hardware(void) {
 	load_highscores_eeprom();
 	
 	ledmatrix_setup();
-	init_button_interrupts();
+	init_buttons();
 	// Setup serial port for 19200 baud communication with no echo
 	// of incoming characters
 	init_serial_stdio(19200,0);
@@ -125,13 +159,78 @@ void initialise_hardware(void) {
 	// Setup joystick
 	init_joystick();
 	
+	// Clear latency measurements (only used when profiling)
+	init_latency();
+	
 	// Turn on global interrupts
 	sei();
 }
 
+// Use the joystick calibration saved in the EEPROM. If there isn't one,
+// assume the joystick is untouched and measure its centre, keeping
+// the default range.
+void initialise_joystick_calibration(void) {
+	JoystickCalibration calibration;
+	if (!load_calibration_eeprom(&calibration)) {
+		JoystickCalibration measured;
+		get_default_joystick_calibration(&calibration);
+		calibrate_joystick_centre(&measured);
+		calibration.centre_x = measured.centre_x;
+		calibration.centre_y = measured.centre_y;
+		if (!is_joystick_calibration_valid(&calibration)) {
+			// Someone was pushing the joystick - stick with the defaults
+			get_default_joystick_calibration(&calibration);
+		}
+	}
+	set_joystick_calibration(&calibration);
+}
+
 // Opening splash screen
-// Press button, 'n' or enter to continue
+// Press button, 'n' or enter to continue, '2' for a two player game (when
+// the whole field fits on the display - see MAX_PLAYERS),
+// or 'c' to calibrate the joystick
 void splash_screen(void) {
+	char serial_input;
+	
+	draw_splash_screen();
+	while(1) {
+		set_scrolling_display_text("42846413 - Sean Manson - Frogger");
+		// Scroll the message until it has scrolled off the 
+		// display or a button is pushed or 'n' or enter is received
+		while(update_scrolling_display()) {
+			check_stack();
+			update_eeprom();
+			if(button_pushed() != -1) {
+				// Seed the random number generator based upon the time taken
+				srand(get_clock_ticks());
+				num_players = 1;
+				return;
+			}
+			if(serial_input_available()) {
+				serial_input = fgetc(stdin);
+				if(serial_input == 'n' || serial_input == 'N' || serial_input == '\n' || serial_input == '\r') {
+					srand(get_clock_ticks());
+					num_players = 1;
+					return;
+				} else if(serial_input == '2' && MAX_PLAYERS >= 2) {
+					srand(get_clock_ticks());
+					num_players = 2;
+					return;
+				} else if(serial_input == 'c' || serial_input == 'C') {
+					// Calibrate, then start the splash screen again
+					calibrate_joystick();
+					init_scrolling_display();
+					draw_splash_screen();
+					break;
+				}
+			}
+		}
+	}
+}
+
+// Draw the splash screen on the terminal and get the LED matrix
+// ready for the scrolling message
+void draw_splash_screen(void) {
 	// Clear terminal screen
 	redraw_screen();
 	
@@ -140,6 +239,36 @@ void splash_screen(void) {
 	set_display_attribute(GREEN_TEXT);
 	move_cursor(SCREENSPACE(5,3));
 	printf_P(PSTR("CSSE2010 project by Sean Manson (SID: 42846413)"));
+	draw_highscores(-1);
+	
+	// Show how many games have been played on this board
+	GameSettings settings;
+	load_settings_eeprom(&settings);
+	move_cursor(SCREENSPACE(6, 17));
+	printf_P(PSTR("Games played: %u"), settings.games_played);
+	move_cursor(SCREENSPACE(5,18));
+	printf_P(PSTR("Press enter, 'n', or any button on the IO Board to"));
+	move_cursor(SCREENSPACE(5,19));
+#if MAX_PLAYERS >= 2
+	printf_P(PSTR("begin! (Press '2' for two players, or 'c' to"));
+	move_cursor(SCREENSPACE(5,20));
+	printf_P(PSTR("calibrate the joystick.)"));
+#else
+	printf_P(PSTR("begin! (Press 'c' to calibrate the joystick.)"));
+#endif
+	
+	// Get ready to output the scrolling message to the LED matrix
+	ledmatrix_clear();
+	set_text_colour(COLOUR_YELLOW);
+	set_scroll_speed(SPLASH_SCROLL_SPEED);
+}
+
+// Draw the top highscores on the terminal. If gap isn't -1, that rank
+// is left empty (for a new score to be typed in) and the scores below
+// it are moved down a place.
+void draw_highscores(int8_t gap) {
+	uint8_t x, rank;
+	
 	move_cursor(SCREENSPACE(20, 5));
 	printf_P(PSTR("HIGHSCORES"));
 	move_cursor(SCREENSPACE(6, 6));
@@ -150,44 +279,84 @@ void splash_screen(void) {
 	printf_P(PSTR("SCORE"));
 	move_cursor(SCREENSPACE(39, 6));
 	printf_P(PSTR("LEVEL"));
-	uint8_t x;
-	for (x = 0; x < HIGHSCORES_TO_STORE; x++) {
+	for (x = 0; x < HIGHSCORES_TO_SHOW; x++) {
 		move_cursor(SCREENSPACE(7, x+7));
 		printf("%d", x+1);
+		if (x == gap) {
+			continue;
+		}
+		rank = (gap != -1 && x > gap) ? x-1 : x;
 		move_cursor(SCREENSPACE(11, x+7));
-		printf(get_highscore_name(x));
+		printf("%s", get_highscore_name(rank));
 		move_cursor(SCREENSPACE(34, x+7));
-		printf("%d", get_highscore_score(x));
+		printf("%d", get_highscore_score(rank));
 		move_cursor(SCREENSPACE(41, x+7));
-		printf("%d", get_highscore_level(x));
+		printf("%d", get_highscore_level(rank));
 	}
-	move_cursor(SCREENSPACE(5,18));
-	printf_P(PSTR("Press enter, 'n', or any button on the IO Board to"));
-	move_cursor(SCREENSPACE(5,19));
-	printf_P(PSTR("begin!"));
+}
+
+// Walk the player through calibrating the joystick, then save the
+// result to the EEPROM
+void calibrate_joystick(void) {
+	JoystickCalibration calibration;
 	
-	// Output the scrolling message to the LED matrix
-	// and wait for a push button, 'n' or enter to be pushed.
-	ledmatrix_clear();
-	set_text_colour(COLOUR_YELLOW);
-	while(1) {
-		set_scrolling_display_text("42846413 - Sean Manson - Frogger");
-		// Scroll the message until it has scrolled off the 
-		// display or a button is pushed or 'n' or enter is received
-		while(scroll_display()) {
-			_delay_ms(150);
-			if(button_pushed() != -1 || new_game_or_enter_pressed()) {
-				// Seed the random number generator based upon the time taken
-				srand(get_clock_ticks());
-				return;
-			}
-		}
+	redraw_screen();
+	set_display_attribute(GREEN_TEXT);
+	move_cursor(SCREENSPACE(10, 7));
+	printf_P(PSTR("JOYSTICK CALIBRATION"));
+	move_cursor(SCREENSPACE(5, 9));
+	printf_P(PSTR("Let go of the joystick, then press enter"));
+	move_cursor(SCREENSPACE(5, 10));
+	printf_P(PSTR("or any button on the IO Board."));
+	while(button_pushed() == -1 && !enter_pressed()) {
+		check_stack();
+	}
+	
+	move_cursor(SCREENSPACE(5, 12));
+	printf_P(PSTR("Measuring centre..."));
+	calibrate_joystick_centre(&calibration);
+	
+	move_cursor(SCREENSPACE(5, 12));
+	printf_P(PSTR("Now move the joystick all the way around"));
+	move_cursor(SCREENSPACE(5, 13));
+	printf_P(PSTR("its edges a few times, then press enter"));
+	move_cursor(SCREENSPACE(5, 14));
+	printf_P(PSTR("or any button on the IO Board."));
+	while(button_pushed() == -1 && !enter_pressed()) {
+		check_stack();
+		calibrate_joystick_extents(&calibration);
+	}
+	
+	move_cursor(SCREENSPACE(5, 16));
+	if (is_joystick_calibration_valid(&calibration)) {
+		set_joystick_calibration(&calibration);
+		save_calibration_eeprom(&calibration);
+		printf_P(PSTR("Done! Centre %u,%u; X %u-%u; Y %u-%u."),
+				calibration.centre_x, calibration.centre_y,
+				calibration.min_x, calibration.max_x,
+				calibration.min_y, calibration.max_y);
+	} else {
+		printf_P(PSTR("That didn't look right - calibration unchanged."));
+	}
+	move_cursor(SCREENSPACE(5, 18));
+	printf_P(PSTR("Press enter or any button on the IO Board"));
+	move_cursor(SCREENSPACE(5, 19));
+	printf_P(PSTR("to continue..."));
+	while(button_pushed() == -1 && !enter_pressed()) {
+		check_stack();
 	}
+	clear_serial_input_buffer();
 }
 
 // Set up a new game from the beginning
 // A single 'game' lasts until the player loses 
 void new_game(void) {
+	// Count this game
+	GameSettings settings;
+	load_settings_eeprom(&settings);
+	settings.games_played++;
+	save_settings_eeprom(&settings);
+	
 	// Initialise the level at 1
 	init_level();
 	
@@ -199,6 +368,12 @@ void new_game(void) {
 	
 	// Initialise the time at 0
 	init_countdown();
+	
+	// One frog for each player
+	set_number_of_frogs(num_players);
+	
+	// Pick the patterns for this game's levels
+	game_seed = rand();
 }
 
 // Play through the game, looping until the player loses
@@ -227,6 +402,9 @@ void play_game(void) {
 // The player has pressed 'new game'
 // The game ends for whatever reason.
 void new_level(void) {
+	// New traffic and logs for this level
+	generate_game_patterns(game_seed, get_level());
+	
 	// Initialise the game and display
 	init_game();
 	
@@ -239,25 +417,40 @@ void new_level(void) {
 	
 	// Clear a button push or serial input if any are waiting
 	// (The cast to void means the return value is ignored.)
-	(void)button_pushed();
+	clear_button_events();
 	clear_serial_input_buffer();
+	clear_joystick_events();
 }
 
 // Play through the level, looping until the player wins/loses
 void play_level(void) {
 	uint32_t current_time; //current time
-	uint32_t last_move_times[5]; //move times for each lane
-	uint16_t base_speed = 1000; //movement speed
-	int8_t button;
+	uint32_t last_time; //time the lanes were last moved on
+	uint32_t lane_phases[NUM_MOVING_ROWS]; //how far between columns each lane is
+	uint32_t lane_velocities[NUM_MOVING_ROWS]; //columns per millisecond
+	ButtonEvent button_event;
+	uint8_t button_direction;
 	char serial_input, escape_sequence_char;
 	uint8_t characters_into_escape_sequence = 0;
+	uint8_t frog;
+	// The frog moved by the joystick and the terminal. (The buttons
+	// always move frog 0.)
+	uint8_t other_frog = get_number_of_frogs() - 1;
+	uint8_t frog_died;
 	
-	// Get the current time and remember this as the last time the vehicles
-	// and logs were moved.
-	current_time = get_ingame_clock_ticks();
+	// Work out how fast each lane and log channel (see game.h) moves on
+	// this level. A lane moves a column every base_speed*10 milliseconds
+	// at a speed factor of 1, and the difficulty is 100 times the speed
+	// factor, so its velocity is
+	// difficulty/(base_speed*1000) columns per millisecond. (Shifting by
+	// PHASE_BITS-3 and dividing by 125 instead keeps this within 32 bits
+	// for any difficulty below 2048.) These are the only divisions; the
+	// loop below only adds and multiplies.
 	uint8_t i;
-	for (i=0;i<5;i++) {
-		last_move_times[i] = current_time;
+	for (i=0;i<NUM_MOVING_ROWS;i++) {
+		lane_phases[i] = 0;
+		lane_velocities[i] = ((uint32_t)get_difficulty() << (PHASE_BITS - 3)) /
+				(get_moving_row_base_speed(i) * 125UL);
 	}
 	
 	// While we still should be playing this level:
@@ -266,84 +459,80 @@ void play_level(void) {
 		update_status_screen();
 		remove_dead_frogs();
 			
-		// Place a new frog at the start to begin this loop
-		put_frog_at_start();
+		// Place a new frog at the start for each player who has died
+		// or made it across (or is just starting) to begin this loop
+		for(frog=0; frog<get_number_of_frogs(); frog++) {
+			if(!is_frog_alive(frog) || frog_has_reached_riverbank(frog)) {
+				put_frog_at_start(frog);
+			}
+		}
 		
 		// Start countdown timer
 		countdown_set(BASE_TIME_PER_FROG);
 		
-		// Repeat as long as frog is alive/has not reached riverbank:
-		while(is_frog_alive() && !frog_has_reached_riverbank()) {
+		// The lanes don't move while the death animation and status
+		// screen are shown, so start timing them from now
+		last_time = get_ingame_clock_ticks();
+		
+		// Repeat as long as every frog is alive/has not reached riverbank:
+		while(are_all_frogs_crossing()) {
+			BENCH_BEGIN(BENCH_PLAY_LEVEL_LOOP);
+			
+			// Halt before anything gets corrupted if the stack has
+			// overflowed
+			check_stack();
+			
+			// Carry on with any saving which had to wait
+			update_eeprom();
+			
 			// Check if they have run out of time
 			if (is_countdown_done()) {
-				kill_frog();
+				for(frog=0; frog<get_number_of_frogs(); frog++) {
+					kill_frog(frog);
+				}
 			}
 			
 			// Scroll lanes and check for death
 			current_time = get_ingame_clock_ticks();
-			if (is_frog_alive() && !frog_has_reached_riverbank()) {
-				//only move things while the frog's alive
-				for (i=0;i<5;i++) {
-					switch (i) {
-						case 0:
-						base_speed = BASE_SPEED_TRAFFIC_1;
-						break;
-						case 1:
-						base_speed = BASE_SPEED_TRAFFIC_2;
-						break;
-						case 2:
-						base_speed = BASE_SPEED_TRAFFIC_3;
-						break;
-						case 3:
-						base_speed = BASE_SPEED_LOGS_1;
-						break;
-						case 4:
-						base_speed = BASE_SPEED_LOGS_2;
-						break;
+			if (are_all_frogs_crossing()) {
+				//only move things while the frogs are alive
+				for (i=0;i<NUM_MOVING_ROWS;i++) {
+					// Move each lane on by how far it goes in the time since
+					// the last pass
+					lane_phases[i] += lane_velocities[i] * (current_time - last_time);
+					if(lane_phases[i] >= 2 * PHASE_ONE_COLUMN) {
+						// Don't let a slow pass build up more than one column
+						// to catch up on
+						lane_phases[i] = 2 * PHASE_ONE_COLUMN - 1;
 					}
-					if(current_time >= last_move_times[i] + (base_speed*(10000/get_difficulty())/10)) {
-						// If it has been base_speed*10 milliseconssecond since the last movement,
-						// move the row associated with this movement time.
-						// We also adjust this 'speed' (actually distance) for the difficulty by multiplying
-						// by 100/difficulty. We first multiply by 1000 then divide by 10 because this provides
-						// greater accuracy when working with integer division on the AVR.
+					if(lane_phases[i] >= PHASE_ONE_COLUMN) {
+						// If the lane has moved a whole column, scroll the row,
+						// keeping what is left over so the speed stays exact.
+						// (If it has moved more than one, the other is scrolled
+						// on the next pass.)
 						// Alternate the direction of movement based upon the current level.
-						
-						switch(i) {
-							case 0:
-							scroll_lane(0, get_level_direction());
-							break;
-							case 1:
-							scroll_lane(1, -get_level_direction());
-							break;
-							case 2:
-							scroll_lane(2, get_level_direction());
-							break;
-							case 3:
-							scroll_log_channel(0, -get_level_direction());
-							break;
-							case 4:
-							scroll_log_channel(1, get_level_direction());
-							break;
-						}
-						last_move_times[i] = current_time;
+						lane_phases[i] -= PHASE_ONE_COLUMN;
+						scroll_moving_row(i, get_level_direction());
 					}
 				}
 			}
+			last_time = current_time;
 			
-			// Check for input - which could be a button push or serial input.
+			// Check for input - which could be a button event or serial input.
 			// Serial input may be part of an escape sequence, e.g. ESC [ D
 			// is a left cursor key press. At most one of the following three
-			// variables will be set to a value other than -1 if input is available.
-			// (We don't initalise button to -1 since button_pushed() will return -1
-			// if no button pushes are waiting to be returned.)
-			// Button pushes take priority over serial input. If there are both then
+			// variables will be set (to a direction other than CENTRE, or a
+			// character other than -1) if input is available.
+			// Button events take priority over serial input. If there are both then
 			// we'll retrieve the serial input the next time through this loop
 			serial_input = -1;
 			escape_sequence_char = -1;
-			button = button_pushed();
+			button_direction = CENTRE;
+			if(get_button_event(&button_event)) {
+				button_direction = get_button_direction(&button_event);
+			}
 		
-			if(button == -1) {
+			if(button_direction == CENTRE) {
 				// No push button was pushed, see if there is any serial input
 				while(serial_input_available()) {
 					// Serial data was available - read the data from standard input
@@ -372,89 +561,81 @@ void play_level(void) {
 				}
 			}
 		
+			// Let the latency profiler follow this input through to
+			// the display (does nothing unless profiling)
+			if(button_direction != CENTRE && button_event.type != BUTTON_EVENT_REPEAT) {
+				latency_input_decoded(LATENCY_SOURCE_BUTTON);
+			} else if(serial_input != (char)-1 || escape_sequence_char != (char)-1) {
+				latency_input_decoded(LATENCY_SOURCE_SERIAL);
+			}
+			
 			// Process the input. 
-			if(button==3 || escape_sequence_char=='D' || serial_input=='L' || serial_input=='l') {
+			if(button_direction != CENTRE) {
+				// Buttons (including chords for diagonals and repeats
+				// of held buttons)
+				move_frog_in_direction(0, button_direction);
+			} else if(escape_sequence_char=='D' || serial_input=='L' || serial_input=='l') {
 				// Attempt to move left
-				move_frog_left();
-			} else if(button==2 || escape_sequence_char=='A' || serial_input=='U' || serial_input=='u') {
+				move_frog_left(other_frog);
+			} else if(escape_sequence_char=='A' || serial_input=='U' || serial_input=='u') {
 				// Attempt to move forward
-				move_frog_forward();
-			} else if(button==1 || escape_sequence_char=='B' || serial_input=='D' || serial_input=='d') {
+				move_frog_forward(other_frog);
+			} else if(escape_sequence_char=='B' || serial_input=='D' || serial_input=='d') {
 				// Attempt to move down
-				move_frog_backward();
-			} else if(button==0 || escape_sequence_char=='C' || serial_input=='R' || serial_input=='r') {
+				move_frog_backward(other_frog);
+			} else if(escape_sequence_char=='C' || serial_input=='R' || serial_input=='r') {
 				// Attempt to move right
-				move_frog_right();
+				move_frog_right(other_frog);
 			} else if(serial_input == 'n' || serial_input == 'N') {
 				// Start new game
 				new_game_flag = 1;
+				latency_input_done();
+				BENCH_END(BENCH_PLAY_LEVEL_LOOP);
 				return; // Quits out of the play_game() function
 			} else if(serial_input == 'p' || serial_input == 'P') {
 				// Pause game
 				pause_game();
+			} else if(serial_input == 's' || serial_input == 'S') {
+				// Print the most stack used so far
+				stack_report(5, 20);
+#ifdef LATENCY_PROFILE
+			} else if(serial_input == 't' || serial_input == 'T') {
+				// Print latency percentiles
+				latency_report(5, 14);
+#endif
 			} else if (should_joystick_move()) {
 				// If the joystick is telling us we should move,
 				// Go through all the movement options and attempt to move accordingly
-				switch (get_last_joystick_movement_value()) {
-					case TOPLEFT:
-					move_frog_forward_left();
-					break;
-					case TOP:
-					move_frog_forward();
-					break;
-					case TOPRIGHT:
-					move_frog_forward_right();
-					break;
-					case LEFT:
-					move_frog_left();
-					break;
-					case RIGHT:
-					move_frog_right();
-					break;
-					case BOTTOMLEFT:
-					move_frog_backward_left();
-					break;
-					case BOTTOM:
-					move_frog_backward();
-					break;
-					case BOTTOMRIGHT:
-					move_frog_backward_right();
-					break;
-				}
-			} else { 
-				// Auto-repeated button inputs
-				switch (should_button_repeat()) {
-					case 3:
-						move_frog_left();
-						break;
-					case 2:
-						move_frog_forward();
-						break;
-					case 1:
-						move_frog_backward();
-						break;
-					case 0:
-						move_frog_right();
-						break;
-				}
+				latency_input_decoded(LATENCY_SOURCE_JOYSTICK);
+				move_frog_in_direction(other_frog, get_last_joystick_movement_value());
 			}
+			latency_input_done();
+			BENCH_END(BENCH_PLAY_LEVEL_LOOP);
 		}
 		
-		// We get here when this frog's time is over
-		// They have either gotten to the other side or died
+		// We get here when a frog's time is over
+		// At least one has either gotten to the other side or died
 		
-		if(is_frog_alive() && frog_has_reached_riverbank()) {
-			// Add to their score for making it to the other side
-			// This score is the base score + the time they have remaining
-			play_tune_success();
-			add_to_score(BASE_SCORE_GET_TO_RIVERBANK + get_countdown_time_remaining());
+		frog_died = 0;
+		for(frog=0; frog<get_number_of_frogs(); frog++) {
+			if(is_frog_alive(frog) && frog_has_reached_riverbank(frog)) {
+				// Add to their score for making it to the other side
+				// This score is the base score + the time they have remaining
+				play_tune_success();
+				add_to_score(BASE_SCORE_GET_TO_RIVERBANK + get_countdown_time_remaining());
+			} else if(!is_frog_alive(frog)) {
+				frog_died = 1;
+			}
+		}
+		
+		if (!frog_died) {
 			countdown_clear();
 		} else if (is_countdown_done()) {
 			// If they have run out of time,
 			// tell them so, and make them lose a life
 			handle_out_of_time();
 		} else {
-			// If the frog is dead,
+			// If a frog is dead,
 			// clear the countdown, tell them so, and make them lose a life
 			countdown_clear();
 			handle_lose_life();
@@ -482,6 +663,18 @@ void level_up() {
 	increment_level();
 	flip_level_direction();
 	
+	// Show the level complete animation on the LED matrix
+	play_animation_level_complete();
+	while(update_animation()) {
+		check_stack();
+		if (new_game_pressed()) {
+			new_game_flag = 1;
+			clear_serial_input_buffer();
+			stop_animation();
+			return;
+		}
+	}
+	
 	// Output the scrolling message to the LED matrix
 	// and wait for a push button to be pushed.
 	ledmatrix_clear();
@@ -502,21 +695,22 @@ void level_up() {
 		gain_life();
 	}
 	
-	// Generate a string for the new level name
-	char level_name[10];
-	snprintf(level_name, 10, "Level %d", get_level());
+	// Generate a string for the new level name, with the number in yellow
+	char level_name[16];
+	snprintf(level_name, 16, "Level " TEXT_YELLOW "%d!", get_level());
 	
 	// Scroll this screen on the LEDs
 	init_scrolling_display();
 	set_text_colour(COLOUR_GREEN);
+	set_scroll_speed(LEVEL_UP_SCROLL_SPEED);
 	set_scrolling_display_text(level_name);
-	while(scroll_display()) {
+	while(update_scrolling_display()) {
+		check_stack();
 		if (new_game_pressed()) {
 			new_game_flag = 1;
 			clear_serial_input_buffer();
 			break;
 		}
-		_delay_ms(100);
 	}
 }
 
@@ -526,7 +720,7 @@ void pause_game() {
 	// Stop the clock from counting
 	stop_ingame_timer();
 	
-	// Deactivate button interrupts
+	// Deactivate buttons
 	deactivate_buttons();
 	
 	// Refresh the terminal and display a message
@@ -541,17 +735,31 @@ void pause_game() {
 	move_cursor(SCREENSPACE(5, 11));
 	printf_P(PSTR("Press 'p' to continue."));
 	
+	// Show how the joystick is behaving
+	uint16_t noise_x = get_joystick_noise_x();
+	uint16_t noise_y = get_joystick_noise_y();
+	move_cursor(SCREENSPACE(5, 13));
+	printf_P(PSTR("Joystick: %u samples/s, noise %u.%u/%u.%u"), get_joystick_sample_rate(),
+			noise_x/16, (noise_x%16)*10/16, noise_y/16, (noise_y%16)*10/16);
+#ifdef SOUND_SYNTH
+	// And how long the synthesiser's sample interrupt takes
+	move_cursor(SCREENSPACE(5, 14));
+	printf_P(PSTR("Synth: %u of %u cycles per sample"), get_synth_max_isr_cycles(),
+			SYNTH_CYCLE_BUDGET);
+#endif
+	
 	// Wait until they press 'p' again
 	while(!pause_pressed()) {
-		; // wait
+		check_stack();
 	}
 	clear_serial_input_buffer();
+	clear_joystick_events();
 	
 	// Redraw game to serial output because it would have been cleared
 	redraw_screen();
 	update_status_screen();
 	
-	// Reactivate button interrupts
+	// Reactivate buttons
 	activate_buttons();
 	
 	// Restart the game clock
@@ -565,6 +773,7 @@ void handle_out_of_time() {
 	// If we aren't dead
 	if (!player_has_lost()) { 
 		play_tune_dead(); // Play death jingle
+		play_animation_death();
 		
 		// Stop the game clock
 		stop_ingame_timer();
@@ -609,6 +818,7 @@ void handle_lose_life() {
 	// If we aren't dead
 	if (!player_has_lost()) {
 		play_tune_dead(); // Play death jingle
+		play_animation_death();
 		
 		// Stop the game clock
 		stop_ingame_timer();
@@ -646,7 +856,7 @@ void handle_lose_life() {
 
 // Confirmation when they lose
 void handle_game_over() {
-	uint8_t x;
+	uint8_t x, type_row;
 	int8_t should_type;
 	char new_highscore_name[HIGHSCORE_NAME_LENGTH+1] = "";
 	// Display an appropriate message
@@ -658,55 +868,58 @@ void handle_game_over() {
 	move_cursor(SCREENSPACE(5, 3));
 	printf_P(PSTR("Your score was %d, and you made it to level %d!"), get_score(), get_level());
 	
-	should_type = get_appropriate_index(get_score());
-	
-	move_cursor(SCREENSPACE(20, 5));
-	printf_P(PSTR("HIGHSCORES"));
-	move_cursor(SCREENSPACE(6, 6));
-	printf_P(PSTR("RANK"));
-	move_cursor(SCREENSPACE(12, 6));
-	printf_P(PSTR("NAME"));
-	move_cursor(SCREENSPACE(32, 6));
-	printf_P(PSTR("SCORE"));
-	move_cursor(SCREENSPACE(39, 6));
-	printf_P(PSTR("LEVEL"));
-	for (x = 0; x < HIGHSCORES_TO_STORE; x++) {
-		move_cursor(SCREENSPACE(7, x+7));
-		printf("%d", x+1);
-		move_cursor(SCREENSPACE(11, x+7));
-		printf(get_highscore_name(x));
-		move_cursor(SCREENSPACE(34, x+7));
-		printf("%d", get_highscore_score(x));
-		move_cursor(SCREENSPACE(41, x+7));
-		printf("%d", get_highscore_level(x));
+	// Show the score on the LED matrix too. If it's too wide, it scrolls
+	// across while they type their name and until they carry on.
+	snprintf(score_text, sizeof(score_text), "%u", get_score());
+	set_text_colour(COLOUR_YELLOW);
+	if(!display_static_text(score_text)) {
+		init_scrolling_display();
+		set_scrolling_display_text(score_text);
+		score_scrolling = 1;
 	}
 	
+	// Leave a gap in the table for their score if it's high enough
+	should_type = get_highscore_rank(get_score());
+	draw_highscores(should_type < HIGHSCORES_TO_SHOW ? should_type : -1);
+	
 	if (should_type != -1) {
+		// Work out where to type their name. If they're not in the top
+		// few, this goes below the table.
+		if (should_type < HIGHSCORES_TO_SHOW) {
+			type_row = should_type+7;
+		} else {
+			type_row = HIGHSCORES_TO_SHOW+7;
+			move_cursor(SCREENSPACE(7, type_row));
+			printf("%d", should_type+1);
+		}
+		
 		move_cursor(SCREENSPACE(5, 18));
 		printf_P(PSTR("You obtained a high score!"));
 		move_cursor(SCREENSPACE(5, 19));
-		printf_P(PSTR("Please type your name (max 20 chars) above."));
+		printf_P(PSTR("Please type your name (max %d chars) above."), HIGHSCORE_NAME_LENGTH);
 		
 		// Get the user's response
-		get_user_typing(new_highscore_name, 11, should_type+7);
+		get_user_typing(new_highscore_name, 11, type_row);
 		
-		// Save to highscores
-		set_highscore(should_type, new_highscore_name, get_score(), get_level());
+		// Now they've confirmed it, add it to the highscores (as long as
+		// the stack hasn't overflowed into the table - this halts if so)
+		check_stack();
+		insert_highscore(new_highscore_name, get_score(), get_level());
 		
 		// Refresh line of highscores
 		set_display_attribute(GREEN_TEXT);
-		move_cursor(SCREENSPACE(11, should_type+7));
+		move_cursor(SCREENSPACE(11, type_row));
 		for (x=0; x<23; x++) {
 			printf(" ");
 		}	
-		move_cursor(SCREENSPACE(11, should_type+7));
-		printf(get_highscore_name(should_type));
-		move_cursor(SCREENSPACE(34, should_type+7));
-		printf("%d", get_highscore_score(should_type));
-		move_cursor(SCREENSPACE(41, should_type+7));
-		printf("%d", get_highscore_level(should_type));
+		move_cursor(SCREENSPACE(11, type_row));
+		printf("%s", new_highscore_name);
+		move_cursor(SCREENSPACE(34, type_row));
+		printf("%d", get_score());
+		move_cursor(SCREENSPACE(41, type_row));
+		printf("%d", get_level());
 		
-		// Save to eeprom
+		// Save to eeprom (only the new score is written)
 		save_highscores_eeprom();
 		
 		// Clear bottom message
@@ -727,6 +940,7 @@ void handle_game_over() {
 	
 	// Wait for them to respond with enter or 'n'
 	confirmation_screen_pause();
+	score_scrolling = 0;
 }
 
 
@@ -744,13 +958,19 @@ void update_status_screen() {
 	printf_P(PSTR("Current Score: %d"), get_score());
 	move_cursor(SCREENSPACE(5, 12));
 	printf_P(PSTR("Current Lives: %d"), get_lives());
+	move_cursor(SCREENSPACE(5, 13));
+	printf_P(PSTR("Players: %d"), get_number_of_frogs());
 }
 
 // Pause and wait until they either push a button, enter or 'n'
 void confirmation_screen_pause() {
 	char serial_input;
-	// Wait for button pushed
+	// Wait for button pushed, carrying on with any animation meanwhile
 	while(button_pushed() == -1) {
+		check_stack();
+		update_eeprom();
+		update_animation();
+		keep_score_scrolling();
 		// If they input something over the terminal:
 		if (serial_input_available()) {
 			serial_input = fgetc(stdin);
@@ -762,9 +982,18 @@ void confirmation_screen_pause() {
 			}
 		}
 	}
+	stop_animation();
 	clear_serial_input_buffer();
 }
 
+// Scroll the score on the LED matrix after a game, if it's being
+// scrolled, starting it again each time it has gone
+void keep_score_scrolling() {
+	if (score_scrolling && !update_scrolling_display()) {
+		set_scrolling_display_text(score_text);
+	}
+}
+
 void get_user_typing(char string_to_get[], uint8_t screen_x, uint8_t screen_y) {
 	// Define our string
 	uint8_t done = 0, current_pos = 0, x;
@@ -785,7 +1014,9 @@ void get_user_typing(char string_to_get[], uint8_t screen_x, uint8_t screen_y) {
 		
 		// Wait for serial input
 		while (!serial_input_available()) {
-			;
+			check_stack();
+			update_eeprom();
+			keep_score_scrolling();
 		}
 		// Break down this input
 		serial_input = fgetc(stdin);
@@ -811,6 +1042,66 @@ void get_user_typing(char string_to_get[], uint8_t screen_x, uint8_t screen_y) {
 	}
 }
 
+// Works out which direction (one of the joystick zones) a button event
+// asks the frog to move in. B3 is left, B2 forward, B1 backward and B0 right;
+// pushing two of these together as a chord moves diagonally. Releases and
+// other combinations are ignored (CENTRE is returned).
+uint8_t get_button_direction(const ButtonEvent* event) {
+	if (event->type == BUTTON_EVENT_RELEASE) {
+		return CENTRE;
+	}
+	switch (event->buttons) {
+		case BUTTON_B3:
+			return LEFT;
+		case BUTTON_B2:
+			return TOP;
+		case BUTTON_B1:
+			return BOTTOM;
+		case BUTTON_B0:
+			return RIGHT;
+		case BUTTON_B2|BUTTON_B3:
+			return TOPLEFT;
+		case BUTTON_B2|BUTTON_B0:
+			return TOPRIGHT;
+		case BUTTON_B1|BUTTON_B3:
+			return BOTTOMLEFT;
+		case BUTTON_B1|BUTTON_B0:
+			return BOTTOMRIGHT;
+	}
+	return CENTRE;
+}
+
+// Go through all the movement options and attempt to move the given frog
+// accordingly. direction is one of the joystick zones.
+void move_frog_in_direction(uint8_t frog, uint8_t direction) {
+	switch (direction) {
+		case TOPLEFT:
+		move_frog_forward_left(frog);
+		break;
+		case TOP:
+		move_frog_forward(frog);
+		break;
+		case TOPRIGHT:
+		move_frog_forward_right(frog);
+		break;
+		case LEFT:
+		move_frog_left(frog);
+		break;
+		case RIGHT:
+		move_frog_right(frog);
+		break;
+		case BOTTOMLEFT:
+		move_frog_backward_left(frog);
+		break;
+		case BOTTOM:
+		move_frog_backward(frog);
+		break;
+		case BOTTOMRIGHT:
+		move_frog_backward_right(frog);
+		break;
+	}
+}
+
 // Returns whether new game button has been pressed last
 uint8_t new_game_pressed() {
 	if (!serial_input_available()) {
@@ -7,10 +7,14 @@
  * This is an example of how the LED display board can be used. 
  * This program scrolls a message from right to left on the
  * board. The font used is defined below and is 7 dots high and
- * varies between 3 and 5 dots wide, depending on the character.
- * Letters and numbers can be handled (though lower case
- * letters are displayed as upper case). All other characters
- * display as a blank column.
+ * varies between 1 and 5 dots wide, depending on the character.
+ * All printable ASCII characters can be handled (though lower
+ * case letters are displayed as upper case). All other characters
+ * display as a blank column, except for the colour codes in
+ * scrolling_char_display.h, which change the colour of the text
+ * after them. Short messages (such as the score) can also be
+ * displayed without scrolling, using narrower digits so that four
+ * of them fit on the display.
  * 
  * The program also demonstrates how data can be stored in the
  * program (flash) memory, without also taking up space in RAM.
@@ -26,13 +30,17 @@
 
 #include "scrolling_char_display.h"
 #include "ledmatrix.h"
+#include "timer0.h"
 #include <avr/pgmspace.h>
 
+/* Number of characters in the font: space to ` and { to ~ */
+#define FONT_CHARACTERS ('`' - ' ' + 1 + '~' - '{' + 1)
+
 /* FONT DEFINITION
  *
  * The following define the columns of data to be displayed
- * for each character (a-z and 0-9). The most significant
- * 7 bits (bit 7 to bit 1) represent the data for rows 7 to 1 
+ * for each character. The most significant 7 bits
+ * (bit 7 to bit 1) represent the data for rows 7 to 1 
  * (top to bottom). The least significant bit is 1 only for
  * the last column of letter data. (This is how the software
  * will know when it has reached the last column for this 
@@ -50,6 +58,31 @@
  * bit 0    *
  */
 
+/* Data for symbols from space to @ (other than the digits) */
+static const uint8_t cols_space[] PROGMEM = {1};
+static const uint8_t cols_exclamation[] PROGMEM = {251};
+static const uint8_t cols_quote[] PROGMEM = {192, 0, 193};
+static const uint8_t cols_hash[] PROGMEM = {72, 252, 72, 252, 73};
+static const uint8_t cols_dollar[] PROGMEM = {36, 84, 254, 84, 73};
+static const uint8_t cols_percent[] PROGMEM = {194, 204, 16, 102, 135};
+static const uint8_t cols_ampersand[] PROGMEM = {108, 146, 170, 68, 11};
+static const uint8_t cols_apostrophe[] PROGMEM = {193};
+static const uint8_t cols_open_paren[] PROGMEM = {124, 131};
+static const uint8_t cols_close_paren[] PROGMEM = {130, 125};
+static const uint8_t cols_asterisk[] PROGMEM = {84, 56, 124, 56, 85};
+static const uint8_t cols_plus[] PROGMEM = {16, 56, 17};
+static const uint8_t cols_comma[] PROGMEM = {2, 5};
+static const uint8_t cols_hyphen[] PROGMEM = {16, 16, 16, 17};
+static const uint8_t cols_full_stop[] PROGMEM = {3};
+static const uint8_t cols_slash[] PROGMEM = {6, 56, 193};
+static const uint8_t cols_colon[] PROGMEM = {37};
+static const uint8_t cols_semicolon[] PROGMEM = {2, 37};
+static const uint8_t cols_less[] PROGMEM = {16, 40, 69};
+static const uint8_t cols_equals[] PROGMEM = {40, 40, 41};
+static const uint8_t cols_greater[] PROGMEM = {68, 40, 17};
+static const uint8_t cols_question[] PROGMEM = {64, 138, 144, 97};
+static const uint8_t cols_at[] PROGMEM = {124, 130, 186, 170, 121};
+
 /* Data for letters A-Z */
 static const uint8_t cols_a[] PROGMEM = {126, 144, 144, 127};
 static const uint8_t cols_b[] PROGMEM = {254, 146, 146, 109};
@@ -89,68 +122,166 @@ static const uint8_t cols_6[] PROGMEM = {124, 146, 146, 77};
 static const uint8_t cols_7[] PROGMEM = {128, 158, 160, 193};
 static const uint8_t cols_8[] PROGMEM = {108, 146, 146, 109};
 static const uint8_t cols_9[] PROGMEM = {100, 146, 146, 125};
-	
-/* Data for hyphen symbol - */
-static const uint8_t cols_hyphen[] PROGMEM = {16, 16, 16, 17};
 
-/* The following three arrays point to the font data above. 
- * We store pointers to the beginning of the column data
- * for each letter, number and symbol.
-*/
-static const uint8_t* const letters[26] PROGMEM = {
-		cols_a, cols_b, cols_c, cols_d, cols_e, cols_f,
-		cols_g, cols_h, cols_i, cols_j, cols_k, cols_l,
-		cols_m, cols_n, cols_o, cols_p, cols_q, cols_r, 
-		cols_s, cols_t, cols_u, cols_v, cols_w, cols_x,
-		cols_y, cols_z };
-		
-static const uint8_t* const numbers[10] PROGMEM = {
-		cols_0, cols_1, cols_2, cols_3, cols_4, 
-		cols_5, cols_6, cols_7, cols_8, cols_9 };
-		
-static const uint8_t* const symbols[1] PROGMEM = {
-		cols_hyphen};
-
-/* Keep track of the pixel colour to be used */
+/* Narrower (3 dot wide) numbers 0 to 9, used for static text */
+static const uint8_t cols_narrow_0[] PROGMEM = {254, 130, 255};
+static const uint8_t cols_narrow_1[] PROGMEM = {66, 254, 3};
+static const uint8_t cols_narrow_2[] PROGMEM = {158, 146, 243};
+static const uint8_t cols_narrow_3[] PROGMEM = {146, 146, 255};
+static const uint8_t cols_narrow_4[] PROGMEM = {240, 16, 255};
+static const uint8_t cols_narrow_5[] PROGMEM = {242, 146, 159};
+static const uint8_t cols_narrow_6[] PROGMEM = {254, 146, 159};
+static const uint8_t cols_narrow_7[] PROGMEM = {128, 158, 225};
+static const uint8_t cols_narrow_8[] PROGMEM = {254, 146, 255};
+static const uint8_t cols_narrow_9[] PROGMEM = {242, 146, 255};
+
+/* Data for the remaining symbols, [ to ` and { to ~ */
+static const uint8_t cols_open_bracket[] PROGMEM = {254, 131};
+static const uint8_t cols_backslash[] PROGMEM = {192, 56, 7};
+static const uint8_t cols_close_bracket[] PROGMEM = {130, 255};
+static const uint8_t cols_caret[] PROGMEM = {64, 128, 65};
+static const uint8_t cols_underscore[] PROGMEM = {2, 2, 2, 3};
+static const uint8_t cols_backtick[] PROGMEM = {128, 65};
+static const uint8_t cols_open_brace[] PROGMEM = {16, 238, 131};
+static const uint8_t cols_bar[] PROGMEM = {255};
+static const uint8_t cols_close_brace[] PROGMEM = {130, 238, 17};
+static const uint8_t cols_tilde[] PROGMEM = {16, 32, 16, 8, 17};
+
+/* The following arrays point to the font data above. We store
+ * pointers to the beginning of the column data for each character,
+ * from space to ` and then { to ~ (lower case letters use the upper
+ * case data), and for each of the narrow numbers.
+ */
+static const uint8_t* const font[FONT_CHARACTERS] PROGMEM = {
+		cols_space, cols_exclamation, cols_quote, cols_hash, cols_dollar, cols_percent,
+		cols_ampersand, cols_apostrophe, cols_open_paren, cols_close_paren, cols_asterisk, cols_plus,
+		cols_comma, cols_hyphen, cols_full_stop, cols_slash, cols_0, cols_1,
+		cols_2, cols_3, cols_4, cols_5, cols_6, cols_7,
+		cols_8, cols_9, cols_colon, cols_semicolon, cols_less, cols_equals,
+		cols_greater, cols_question, cols_at, cols_a, cols_b, cols_c,
+		cols_d, cols_e, cols_f, cols_g, cols_h, cols_i,
+		cols_j, cols_k, cols_l, cols_m, cols_n, cols_o,
+		cols_p, cols_q, cols_r, cols_s, cols_t, cols_u,
+		cols_v, cols_w, cols_x, cols_y, cols_z, cols_open_bracket,
+		cols_backslash, cols_close_bracket, cols_caret, cols_underscore, cols_backtick, cols_open_brace,
+		cols_bar, cols_close_brace, cols_tilde };
+
+static const uint8_t* const narrow_numbers[10] PROGMEM = {
+		cols_narrow_0, cols_narrow_1, cols_narrow_2, cols_narrow_3, cols_narrow_4,
+		cols_narrow_5, cols_narrow_6, cols_narrow_7, cols_narrow_8, cols_narrow_9 };
+
+/* Colours for each of the colour codes (TEXT_RED to TEXT_ORANGE) */
+static const PixelColour code_colours[4] PROGMEM = {
+		COLOUR_RED, COLOUR_GREEN, COLOUR_YELLOW, COLOUR_ORANGE };
+
+/* Keep track of the pixel colour to be used, and the colour the
+ * current message is being displayed in (which colour codes in it
+ * can change)
+ */
 static PixelColour colour = COLOUR_RED;
+static PixelColour current_colour = COLOUR_RED;
 
-/* Keep track of which column of data is next to be displayed. 
- * next_col_ptr points to that column, or is 0 if there is
- * no next column.
+/* A colour code in a message: the colour to change to (or 0 to change
+ * back to the colour set by set_text_colour()) from the given column
  */
-static volatile const uint8_t* next_col_ptr = 0;
+typedef struct {
+	uint8_t column;
+	PixelColour colour;
+} ColourChange;
 
-/* String to be displayed. 
- * next_char_to_display will be used to point to the next
- * character from this string to be displayed.
+/* A message rendered into columns of dots (one byte per column, laid
+ * out like the font data but with bit 0 always clear), along with the
+ * colour changes in it
+ */
+typedef struct {
+	uint8_t* columns;
+	uint8_t max_columns;
+	uint8_t num_columns;
+	ColourChange changes[SCROLLING_DISPLAY_MAX_COLOUR_CHANGES];
+	uint8_t num_changes;
+} RenderedText;
+
+/* The message being scrolled, rendered when it is started. next_column
+ * is the next column to be displayed and next_change the next colour
+ * change to be made. Once all the columns have been displayed,
+ * shift_countdown counts down the blank columns needed to scroll the
+ * message off the display.
+ */
+static uint8_t columns[SCROLLING_DISPLAY_MAX_COLUMNS];
+static RenderedText message = {
+		.columns = columns, .max_columns = SCROLLING_DISPLAY_MAX_COLUMNS };
+static uint8_t next_column;
+static uint8_t next_change;
+static uint8_t shift_countdown;
+
+#if MATRIX_PANELS_ACROSS > 1
+/* Number of columns (of the message, then blank) scrolled onto the
+ * display since the message was started
+ */
+static uint16_t columns_shown;
+#endif
+
+/* String waiting to be displayed after the current one, if any.
  */
 static char* displayString;
 
-static volatile char* next_char_to_display = 0;
+/* Time (in ms) between each scroll of the display, and the clock
+ * tick at which update_scrolling_display() should next scroll it.
+ */
+static uint16_t scroll_interval = 1000 / SCROLLING_DISPLAY_DEFAULT_SPEED;
+static uint32_t next_scroll_time;
+
+static void start_message(const char* string);
+#if MATRIX_PANELS_ACROSS > 1
+static void redraw_message_column(uint8_t x);
+#endif
+static void render_text(RenderedText* text, const char* string, uint8_t narrow);
+static const uint8_t* get_character_columns(char character, uint8_t narrow);
 
 /* Resets all internal values for the display, readying it
  * for use again for different strings and values
  */
 void init_scrolling_display(void) {
-	next_col_ptr = 0;
-	next_char_to_display = 0;
+	message.num_columns = 0;
+	message.num_changes = 0;
+	next_column = 0;
+	next_change = 0;
+	shift_countdown = 0;
 	displayString = 0;
+	next_scroll_time = get_clock_ticks();
 }
 
 /* Set the colour to be used
  */
 void set_text_colour(PixelColour c) {
 	colour = c;
+	current_colour = c;
+}
+
+/* Set the scrolling speed. The time between scrolls is worked out
+ * here so update_scrolling_display() never has to divide.
+ */
+void set_scroll_speed(uint8_t pixels_per_second) {
+	if(pixels_per_second == 0) {
+		pixels_per_second = 1;
+	}
+	scroll_interval = 1000 / pixels_per_second;
 }
 
 /*
- * Set the message to be displayed - we just copy the 
- * pointer not the string it points to, so it is important
- * that the original string not change after this function
- * is called while the string is still being displayed.
+ * Set the message to be displayed. If nothing is being displayed
+ * we render it straight away, otherwise we just copy the pointer
+ * (and render it once the current message is finished), so it is
+ * important that the original string not change after this function
+ * is called while the string is still waiting to be displayed.
  */
 void set_scrolling_display_text(char* string_to_display) {
-	displayString = string_to_display;
+	if(next_column >= message.num_columns && shift_countdown == 0) {
+		start_message(string_to_display);
+		displayString = 0;
+	} else {
+		displayString = string_to_display;
+	}
 }
 
 /*
@@ -159,109 +290,239 @@ void set_scrolling_display_text(char* string_to_display) {
  * Returns 1 if still scrolling display.
  */
 uint8_t scroll_display(void) {
-	static uint8_t shift_countdown = 0;
-	uint8_t i;
-	uint8_t col_data;
-	char next_char;
-	uint8_t finished = 0;
-
-	/* Data to be displayed in the next column - by 
-	 * default we show a blank column. Bit 7 of this
-	 * column data corresponds to row 7 of the display
-	 * etc.
-	 */
-	col_data = 0;
+	uint8_t col_data = 0;
 
-	if(next_col_ptr) {
-		/* We're currently outputting a character and next_col_ptr
-		 * points to the display data for the next column. We
-		 * extract that data from program memory.
+	if(next_column >= message.num_columns && shift_countdown == 0) {
+		/* Nothing left of this message - move on to the string that
+		 * we have stored (if any).
 		 */
-		col_data = pgm_read_byte(next_col_ptr);
+		if(!displayString) {
+			return 0;
+		}
+		start_message(displayString);
+		displayString = 0;
+	}
 
-		if(col_data & 1) {
-			/* Least significant bit is set - this is the last
-			 * column of this character
-			 */
-			next_col_ptr = 0;
-		} else {
-			/* This is not the last column of this character - make
-			 * the pointer point to the data for the next column.
-			 */
-			next_col_ptr++;
+	if(next_column < message.num_columns) {
+		/* Make any colour changes which start at this column */
+		while(next_change < message.num_changes &&
+				message.changes[next_change].column <= next_column) {
+			current_colour = message.changes[next_change].colour;
+			if(!current_colour) {
+				current_colour = colour;
+			}
+			next_change++;
 		}
-	} else if(next_char_to_display) {
-		/* We're not currently outputting a character, but we
-		 * do have more characters to display. We will output
-		 * a blank column this time (col_data value remains 0)
-		 * but we will set up our pointer (next_col_ptr) so that
-		 * it points to the data for the first column of dots for
-		 * the next character. We first get the next character to be 
-		 * displayed and advance our next character pointer 
-		 * (next_char_to_display) so that it points to the character 
-		 * after.
-		 */
-		next_char = *(next_char_to_display++);
-		if(next_char == 0) {
-			/* We reached the null character at the end of the string.
-			 * There is no next character, reset our pointer to 
-			 * the next character and set our countdown until the 
-			 * message disappears from the display.
-			 */
-			next_char_to_display = 0;
-			shift_countdown = 16;
-		} else if (next_char >= 'a' && next_char <= 'z') {
-			/* Character is a lower case letter - the next column to 
-			 * be displayed will be the first column of the letter
-			 * data for that letter
+		col_data = message.columns[next_column++];
+		if(next_column == message.num_columns) {
+			/* That was the last column - blank columns are now needed
+			 * to move the message off the display.
 			 */
-			next_col_ptr = (const uint8_t*)pgm_read_word(&letters[next_char - 'a']);
-		} else if (next_char >= 'A' && next_char <= 'Z') {
-			/* Upper case character */
-			next_col_ptr = (const uint8_t*)pgm_read_word(&letters[next_char - 'A']);
-		} else if (next_char >= '0' && next_char <= '9') {
-			/* Digit */
-			next_col_ptr = (const uint8_t*)pgm_read_word(&numbers[next_char - '0']);
-		} else if (next_char == '-') {
-			/* Hyphen or other symbol */
-			next_col_ptr = (const uint8_t*)pgm_read_word(&symbols[next_char - '-']);
+			shift_countdown = MATRIX_NUM_COLUMNS;
 		}
 	} else {
-		/* We're not outputting a column of dots and there is 
-		 * no next character. Move on to the string that we
-		 * have stored (if any).
-		 */
-		if(!displayString) {
-			/* May be finished - flag this and adjust below if we're still
-			 * showing pixels
-			 */
-			finished = 1;
-		}
-		next_char_to_display = displayString;
-		displayString = 0;
+		shift_countdown--;
 	}
-	
+
 	/* Shift the current display one pixel to the left and insert the 
-	 * new column data at column 15.
-	 * Adjust our "finished" variable if we've finished scrolling the
-	 * message off the display
+	 * new column data at the last column.
 	 */
 	ledmatrix_shift_display_left();
-	MatrixColumn column_colour_data;
-	for(i=7; i>=1; i--) {
-		// If the relevant font bit is set, we make this a red pixel, otherwise blank
-		if(col_data & 0x80) {
-			column_colour_data[i] = colour;
-		} else {
-			column_colour_data[i] = 0;
+	ledmatrix_update_column_mask(MATRIX_NUM_COLUMNS-1, col_data, current_colour);
+#if MATRIX_PANELS_ACROSS > 1
+	/* Each panel is shifted on its own, so the last column of each
+	 * panel but the last has to be sent again.
+	 */
+	columns_shown++;
+	for(uint8_t x = PANEL_NUM_COLUMNS-1; x < MATRIX_NUM_COLUMNS-1; x += PANEL_NUM_COLUMNS) {
+		redraw_message_column(x);
+	}
+#endif
+	return 1;
+}
+
+/*
+ * Scroll the display if its next scroll is due.
+ * Returns 1 if still scrolling display.
+ */
+uint8_t update_scrolling_display(void) {
+	uint32_t current_time = get_clock_ticks();
+	
+	if((int32_t)(current_time - next_scroll_time) < 0) {
+		/* Not time yet - just report whether there's anything left
+		 * to scroll.
+		 */
+		return (next_column < message.num_columns || shift_countdown > 0 ||
+				displayString != 0);
+	}
+	
+	/* Keep to a steady rate by working from when this scroll was
+	 * due rather than from now. If we've fallen more than a whole
+	 * scroll behind (e.g. nothing was scrolling) start again from now
+	 * instead of scrolling several times in a row to catch up.
+	 */
+	next_scroll_time += scroll_interval;
+	if((int32_t)(current_time - next_scroll_time) >= 0) {
+		next_scroll_time = current_time + scroll_interval;
+	}
+	return scroll_display();
+}
+
+/*
+ * Display a short message in the middle of the display without
+ * scrolling it. The message is rendered into just enough columns
+ * to fill the display (plus the blank column before the first
+ * character, which isn't shown), then every column is sent.
+ */
+uint8_t display_static_text(const char* string) {
+	/* Room for the blank column before the text, the display's worth of
+	 * columns and one more (so we can tell if it doesn't fit)
+	 */
+	uint8_t static_columns[MATRIX_NUM_COLUMNS+2];
+	RenderedText text = {
+			.columns = static_columns, .max_columns = MATRIX_NUM_COLUMNS+2 };
+	uint8_t x, start, change = 0;
+	PixelColour text_colour = colour;
+	
+	render_text(&text, string, 1);
+	if(text.num_columns > MATRIX_NUM_COLUMNS+1) {
+		return 0;
+	}
+	
+	/* Centre the text. Our rendered text starts with a blank column
+	 * which isn't shown, so display column x (from start) shows
+	 * rendered column x - start + 1.
+	 */
+	start = 0;
+	if(text.num_columns > 1) {
+		start = (MATRIX_NUM_COLUMNS - (text.num_columns - 1)) / 2;
+	}
+	for(x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		uint8_t col_data = 0;
+		if(x >= start && x - start + 1 < text.num_columns) {
+			while(change < text.num_changes &&
+					text.changes[change].column <= x - start + 1) {
+				text_colour = text.changes[change].colour;
+				if(!text_colour) {
+					text_colour = colour;
+				}
+				change++;
+			}
+			col_data = static_columns[x - start + 1];
 		}
-		col_data <<= 1;
+		ledmatrix_update_column_mask(x, col_data, text_colour);
 	}
-	column_colour_data[0] = 0;
-	ledmatrix_update_column(15, column_colour_data);
-	if(shift_countdown > 0) {
-		shift_countdown--;
+	return 1;
+}
+
+
+/* HELPER FUNCTIONS */
+/* Start scrolling a new message, in the colour set by set_text_colour()
+ */
+static void start_message(const char* string) {
+	render_text(&message, string, 0);
+	next_column = 0;
+	next_change = 0;
+	shift_countdown = 0;
+	current_colour = colour;
+#if MATRIX_PANELS_ACROSS > 1
+	columns_shown = 0;
+#endif
+}
+
+#if MATRIX_PANELS_ACROSS > 1
+/* Send column x of the display again, from the scrolling message. (The
+ * columns before the message are blank.)
+ */
+static void redraw_message_column(uint8_t x) {
+	int16_t column = (int16_t)columns_shown - (MATRIX_NUM_COLUMNS - x);
+	PixelColour column_colour = colour;
+	uint8_t change;
+
+	if(column < 0 || column >= message.num_columns) {
+		ledmatrix_update_column_mask(x, 0, colour);
+		return;
+	}
+	for(change = 0; change < message.num_changes &&
+			message.changes[change].column <= column; change++) {
+		column_colour = message.changes[change].colour;
+		if(!column_colour) {
+			column_colour = colour;
+		}
+	}
+	ledmatrix_update_column_mask(x, message.columns[column], column_colour);
+}
+#endif
+
+/* Render a string into columns. Each character is preceded by a blank
+ * column. Characters we have no font data for are displayed as just
+ * the blank column. If the string is too long to fit then the end of
+ * it is cut off, as are any colour codes past the first
+ * SCROLLING_DISPLAY_MAX_COLOUR_CHANGES. If narrow is 1, the narrow
+ * numbers are used for digits.
+ */
+static void render_text(RenderedText* text, const char* string, uint8_t narrow) {
+	const uint8_t* col_ptr;
+	uint8_t col_data;
+	char character;
+
+	text->num_columns = 0;
+	text->num_changes = 0;
+	while((character = *string++) && text->num_columns < text->max_columns) {
+		if(character >= TEXT_RED[0] && character <= TEXT_DEFAULT[0]) {
+			/* Colour code - the colour changes from the blank column
+			 * before the next character. Later codes for the same
+			 * column replace earlier ones.
+			 */
+			if(text->num_changes > 0 && text->changes[text->num_changes-1].column ==
+					text->num_columns) {
+				text->num_changes--;
+			}
+			if(text->num_changes < SCROLLING_DISPLAY_MAX_COLOUR_CHANGES) {
+				text->changes[text->num_changes].column = text->num_columns;
+				if(character == TEXT_DEFAULT[0]) {
+					text->changes[text->num_changes].colour = 0;
+				} else {
+					text->changes[text->num_changes].colour =
+							pgm_read_byte(&code_colours[character - TEXT_RED[0]]);
+				}
+				text->num_changes++;
+			}
+			continue;
+		}
+		text->columns[text->num_columns++] = 0;
+		col_ptr = get_character_columns(character, narrow);
+		if(!col_ptr) {
+			continue;
+		}
+		/* Copy columns until the one with the least significant
+		 * bit set, which is the last column of the character
+		 */
+		do {
+			col_data = pgm_read_byte(col_ptr++);
+			if(text->num_columns < text->max_columns) {
+				text->columns[text->num_columns++] = col_data & 0xFE;
+			}
+		} while(!(col_data & 1));
+	}
+}
+
+/* Find the font data for a character, or return 0 if there is none.
+ * If narrow is 1, digits use the narrow numbers.
+ */
+static const uint8_t* get_character_columns(char character, uint8_t narrow) {
+	if (narrow && character >= '0' && character <= '9') {
+		/* Narrow digit */
+		return (const uint8_t*)pgm_read_word(&narrow_numbers[character - '0']);
+	} else if (character >= 'a' && character <= 'z') {
+		/* Character is a lower case letter */
+		return (const uint8_t*)pgm_read_word(&font[character - 'a' + 'A' - ' ']);
+	} else if (character >= ' ' && character <= '`') {
+		/* Upper case letter, digit or symbol */
+		return (const uint8_t*)pgm_read_word(&font[character - ' ']);
+	} else if (character >= '{' && character <= '~') {
+		/* Symbol after the lower case letters */
+		return (const uint8_t*)pgm_read_word(&font[character - '{' + '`' - ' ' + 1]);
 	}
-	finished = finished && (shift_countdown == 0);
-	return !finished;
+	return 0;
 }
@@ -11,25 +11,62 @@
 #include <stdint.h>
 #include "pixel_colour.h"
 
+/* Longest message (in columns of dots) which can be displayed. Most
+ * characters take 5 or 6 columns (including the gap before them).
+ * Longer messages are cut off.
+ */
+#define SCROLLING_DISPLAY_MAX_COLUMNS 192
+
+/* Most colour codes which can be used in one message. Any more are
+ * ignored.
+ */
+#define SCROLLING_DISPLAY_MAX_COLOUR_CHANGES 8
+
+/* Colour codes. Putting one of these in a message changes the colour
+ * of the text after it; TEXT_DEFAULT changes back to the colour set
+ * by set_text_colour(). They are strings so that they can be joined
+ * to others, e.g. "LEVEL " TEXT_YELLOW "5". (Keep them as separate
+ * literals - "\x02" followed by a letter in the same literal would be
+ * read as a longer hex escape.)
+ */
+#define TEXT_RED "\x01"
+#define TEXT_GREEN "\x02"
+#define TEXT_YELLOW "\x03"
+#define TEXT_ORANGE "\x04"
+#define TEXT_DEFAULT "\x05"
+
+/* Default scrolling speed, in pixels (columns) per second
+ */
+#define SCROLLING_DISPLAY_DEFAULT_SPEED 8
+
 /* Clears all internal thingys in this display, readying it for a
  * new string to be sent and displayed.
  */
 void init_scrolling_display(void);
 
-/* Set the colour of all text to be scrolled. If this is called
- * whilst text is scrolling then the colour may change part way
- * through a character. Default colour is red.
+/* Set the colour of all text to be scrolled (other than text after a
+ * colour code). If this is called whilst text is scrolling then the
+ * colour may change part way through a character. Default colour is
+ * red.
  */
 void set_text_colour(PixelColour colour);
 
+/* Set how fast update_scrolling_display() scrolls the text, in
+ * pixels per second (1 to 250). Default is
+ * SCROLLING_DISPLAY_DEFAULT_SPEED.
+ */
+void set_scroll_speed(uint8_t pixels_per_second);
+
 /* Sets the text to be displayed. The message will only
  * be displayed after the current message (if any). (Only
  * one message can be queued for display (i.e. to be 
  * displayed after the current message) - from the last
- * call to this function.) Note that this string is not 
- * copied, so it is important that this string not change
- * after this function is called while the string is still
- * being displayed.
+ * call to this function.) The message is rendered into
+ * columns of dots as soon as it can be (straight away, if
+ * nothing else is being displayed), after which the string
+ * is no longer needed. Until then it is not copied, so it
+ * is important that this string not change while it is
+ * waiting to be displayed.
  */
 void set_scrolling_display_text(char* string);
 
@@ -41,5 +78,25 @@ void set_scrolling_display_text(char* string);
  * Returns 1 while a message is still scrolling, 0 when done.
  */
 uint8_t scroll_display(void);
+
+/* Scroll the display if it is time to, at the speed given by
+ * set_scroll_speed(), and return immediately otherwise. This should
+ * be called often (every time around a main loop) so that other work
+ * such as reading input can carry on while text is scrolling. The
+ * speed doesn't depend on how often this is called, as long as it
+ * is called more often than the display needs to be scrolled. Uses
+ * timer 0, which must be running.
+ * Returns 1 while a message is still scrolling, 0 when done.
+ */
+uint8_t update_scrolling_display(void);
+
+/* Display a short message (such as a score) in the middle of the
+ * display, without scrolling. Digits are drawn 3 dots wide so that
+ * four of them fit. The whole display is replaced, so this shouldn't
+ * be called while a message is scrolling.
+ * Returns 1 if the message was displayed, or 0 (leaving the display as
+ * it was) if it is too wide to fit - it could be scrolled instead.
+ */
+uint8_t display_static_text(const char* string);
 	
 #endif /* SCROLLING_CHAR_DISPLAY_H_ */
\ No newline at end of file
@@ -26,6 +26,9 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
+#include "latency.h"
+#include "bench.h"
+
 /* System clock rate in Hz. (L at the end indicates this is a long constant) */
 #define SYSCLK 8000000L
 
@@ -218,6 +221,7 @@ int uart_get_char(FILE* stream) {
  */
 ISR(USART0_UDRE_vect) 
 {
+	BENCH_BEGIN(BENCH_ISR_USART_UDRE);
 	/* Check if we have data in our buffer */
 	if(bytes_in_out_buffer > 0) {
 		/* Yes we do - remove the pending byte and output it
@@ -250,6 +254,7 @@ ISR(USART0_UDRE_vect)
 		 */
 		UCSR0B &= ~(1<<UDRIE0);
 	}
+	BENCH_END(BENCH_ISR_USART_UDRE);
 }
 
 /*
@@ -260,9 +265,13 @@ ISR(USART0_UDRE_vect)
 
 ISR(USART0_RX_vect) 
 {
+	BENCH_BEGIN(BENCH_ISR_USART_RX);
 	/* Read the character - we ignore the possibility of overrun. */
 	char c;
 	c = UDR0;
+	
+	/* Timestamp this input for latency measurement */
+	latency_input_isr(LATENCY_SOURCE_SERIAL);
 		
 	if(do_echo && bytes_in_out_buffer < OUTPUT_BUFFER_SIZE) {
 		/* If echoing is enabled and there is output buffer
@@ -299,4 +308,5 @@ ISR(USART0_RX_vect)
 			input_insert_pos = 0;
 		}
 	}
+	BENCH_END(BENCH_ISR_USART_RX);
 }
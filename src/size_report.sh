@@ -0,0 +1,66 @@
+#!/bin/sh
+#
+# size_report.sh
+#
+# Author: Sean Manson
+#
+# Prints how much flash and SRAM each module of the firmware uses, and
+# the largest stack frame in each (from the .su files written by
+# -fstack-usage), then the totals for the whole program and its
+# largest variables. Run by 'make size'.
+#
+# Usage: size_report.sh build_dir elf sram_size flash_size sram_headroom
+#
+# Fails if less than sram_headroom bytes of SRAM are left over for the
+# stack, or if the program doesn't fit in flash.
+
+SIZE=${SIZE:-avr-size}
+NM=${NM:-avr-nm}
+
+build=$1
+elf=$2
+sram_size=$3
+flash_size=$4
+sram_headroom=$5
+
+# Per module. The PROGMEM tables (e.g. the font) are counted as text,
+# since that's where they live.
+printf '%-24s %7s %7s %7s %7s\n' module text data bss frame
+for object in "$build"/*.o; do
+	module=$(basename "$object" .o)
+	set -- $($SIZE -B "$object" | tail -n 1)
+	frame=$(cat "$build/$module.su" 2>/dev/null | awk -F '\t' '$2 > max { max = $2 } END { print max + 0 }')
+	printf '%-24s %7s %7s %7s %7s\n' "$module" "$1" "$2" "$3" "$frame"
+done
+echo
+
+# Largest variables in SRAM (.data and .bss)
+echo "Largest variables in SRAM:"
+$NM --size-sort -r -S -t d "$elf" | awk '$3 ~ /^[bBdD]$/ { printf "  %-30s %5d\n", $4, $2 }' | head -n 10
+echo
+
+# Totals, from the linked program. .noinit is in SRAM as well.
+$SIZE -A "$elf" | awk -v sram_size="$sram_size" -v flash_size="$flash_size" \
+		-v sram_headroom="$sram_headroom" '
+	$1 == ".text" { text = $2 }
+	$1 == ".data" { data = $2 }
+	$1 == ".bss" { bss = $2 }
+	$1 == ".noinit" { noinit = $2 }
+	END {
+		flash = text + data
+		sram = data + bss + noinit
+		left = sram_size - sram
+		printf "Flash: %d of %d bytes (%.1f%%)\n", flash, flash_size, 100 * flash / flash_size
+		printf "SRAM:  %d of %d bytes (%.1f%%) - %d bytes left for the stack\n",
+				sram, sram_size, 100 * sram / sram_size, left
+		failed = 0
+		if (flash > flash_size) {
+			print "FAIL: the program does not fit in flash"
+			failed = 1
+		}
+		if (left < sram_headroom) {
+			printf "FAIL: less than %d bytes of SRAM left for the stack\n", sram_headroom
+			failed = 1
+		}
+		exit failed
+	}'
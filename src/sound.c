@@ -4,74 +4,144 @@
  * Written by Sean Manson
  *
  * Buzzer controls.
- * 
+ *
  */
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 
 #include "sound.h"
-#include "timer0.h"
+#include "synth.h"
+
+// Minimum and maximum allowable frequencies + system clock
+#define FREQ_MIN 150
+#define FREQ_MAX 1000
+#define SYS_CLK 8000000L
+
+// The OCR1A value for a given frequency. Because we are toggling our
+// sound, we want the compare match to occur with a frequency twice that
+// of the sound.
+#define OCR_VALUE(frequency) ((SYS_CLK/((frequency)*2)) - 1)
+
+// Sounds are kept as pitch values: OCR1A values when toggling the
+// buzzer, or phase steps for the synthesiser.
+#ifdef SOUND_SYNTH
+#define PITCH_VALUE(frequency) SYNTH_STEP(frequency)
+#else
+#define PITCH_VALUE(frequency) OCR_VALUE(frequency)
+#endif
+
+// Pitch values for each note (indexed by NOTE_*). These are worked out
+// at compile time so that the timer interrupt never has to divide.
+static const uint16_t note_pitches[NUM_NOTES] PROGMEM = {
+	PITCH_VALUE(FREQ_C4), PITCH_VALUE(FREQ_C4SHARP), PITCH_VALUE(FREQ_D4),
+	PITCH_VALUE(FREQ_D4SHARP), PITCH_VALUE(FREQ_E4), PITCH_VALUE(FREQ_F4),
+	PITCH_VALUE(FREQ_F4SHARP), PITCH_VALUE(FREQ_G4), PITCH_VALUE(FREQ_G4SHARP),
+	PITCH_VALUE(FREQ_A4), PITCH_VALUE(FREQ_A4SHARP), PITCH_VALUE(FREQ_B4),
+	PITCH_VALUE(FREQ_C5), PITCH_VALUE(FREQ_C5SHARP), PITCH_VALUE(FREQ_D5),
+	PITCH_VALUE(FREQ_D5SHARP), PITCH_VALUE(FREQ_E5), PITCH_VALUE(FREQ_F5),
+	PITCH_VALUE(FREQ_F5SHARP), PITCH_VALUE(FREQ_G5), PITCH_VALUE(FREQ_G5SHARP),
+	PITCH_VALUE(FREQ_A5), PITCH_VALUE(FREQ_A5SHARP), PITCH_VALUE(FREQ_B5),
+	PITCH_VALUE(FREQ_C6)
+};
+
+// The in-built tunes. Each is a list of notes and times (in hundredths
+// of seconds), finished by TUNE_END.
+static const uint8_t tune_startup[] PROGMEM = {
+	NOTE_F5, 37, NOTE_C5SHARP, 10, NOTE_D5SHARP, 30,
+	NOTE_G5SHARP, 25, NOTE_F5, 25, NOTE_C5SHARP, 40, TUNE_END
+};
+static const uint8_t tune_success[] PROGMEM = {
+	NOTE_C5SHARP, 10, NOTE_D5SHARP, 30, NOTE_G5SHARP, 25, NOTE_B5, 40,
+	TUNE_END
+};
+static const uint8_t tune_dead[] PROGMEM = {
+	NOTE_F5, 15, NOTE_G5SHARP, 10, NOTE_C5SHARP, 10, NOTE_B4, 40,
+	TUNE_END
+};
+static const uint8_t tune_lost[] PROGMEM = {
+	NOTE_G5SHARP, 10, NOTE_C5SHARP, 10, NOTE_B4, 10, NOTE_G4, 40,
+	TUNE_END
+};
+
+// The tune currently playing. tune_next points to its next note in
+// program memory, or is NULL if there is no tune. tune_pitch is the
+// note being played and tune_time_left the time (ms) left to play it
+// for; this only counts down while the tune can be heard, so (without
+// the synthesiser) the tune is paused while effects are played over
+// the top of it.
+static const uint8_t* volatile tune_next;
+static volatile uint8_t tune_priority;
+static uint16_t tune_pitch;
+static uint16_t tune_time_left;
 
-// Our queue size is the maximum number of sounds which can be stored.
-// Our buffer does not wrap around.
-#define SOUND_QUEUE_SIZE 6
+// Our effect queue. This is a circular buffer - play_sound() adds
+// sounds at the head and sound_timer_tick() takes them from the tail.
+// As each end is only changed by one side, we don't need to turn off
+// interrupts to use it. Must be a power of 2.
+#define SOUND_QUEUE_SIZE 8
 
-// We store the frequencies and times for each sound separately.
-static uint16_t sound_frequencies_queue[SOUND_QUEUE_SIZE];
+// We store the pitch values and times for each sound separately.
+static uint16_t sound_pitch_queue[SOUND_QUEUE_SIZE];
 static uint8_t sound_times_queue[SOUND_QUEUE_SIZE];
+static volatile uint8_t queue_head;
+static volatile uint8_t queue_tail;
 
-// Current length of the queue.
-static int8_t queue_length;
+// Time (ms) left to play the current effect. 0 means no effect is playing.
+static volatile uint16_t effect_time_left;
 
-// Time to stop playing the current sound.
-static int32_t stop_time;
+#ifndef SOUND_SYNTH
+// The OCR1A value currently being played. 0 means the buzzer is quiet.
+static uint16_t output_ocr_value;
 
-// Minimum and maximum allowable frequencies + system clock
-#define FREQ_MIN 150
-#define FREQ_MAX 1000
-#define SYS_CLK 8000000L
+static void set_output(uint16_t ocr_value);
+#endif
 
 void init_buzzer(void) {
 	// Disable interrupts so we can be sure that the interrupt
 	// doesn't fire halfway through.
 	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
 	cli();
-	
-	// Clear the queue.
-	queue_length = 0;
-	
-	// Clear the time to stop at.
-	stop_time = 0;
-	
+
+	// Clear the queue and the tune.
+	queue_head = 0;
+	queue_tail = 0;
+	tune_next = 0;
+
+	// Nothing is playing.
+	effect_time_left = 0;
+
+#ifdef SOUND_SYNTH
+	init_synth();
+#else
+	output_ocr_value = 0;
+
 	// Clear the timer.
 	TCNT1 = 0;
 
 	// Set the output compare value to match a default frequency.
 	OCR1A = get_OCRB_value(FREQ_A4);
-	
+
 	// Set the timer to clear on compare match (CTC mode)
 	// and to not divide the clock. This starts the timer
 	// running.
 	TCCR1A = 0;
 	TCCR1B = (1 <<WGM12 | 1<<CS10);
-	
+
+	// No interrupt is needed - the hardware toggles D5 on each compare
+	// match by itself, and sound_timer_tick() changes the note when
+	// required.
+	TIMSK1 &= ~(1<<OCIE1A);
+#endif
+
 	// Set D3 as an input.
 	DDRD &= ~(1 << DDRD3);
-	
+
 	// Set D5, D7 as outputs.
 	DDRD |= (1 << DDRD5 | 1 << DDRD7);
 	PORTD &= ~(1 << DDRD7); //GND value for buzzer
-	
-	// Enable an interrupt on output compare match. 
-	// Note that interrupts have to be enabled globally
-	// before the interrupts will fire.
-	TIMSK1 |= (1<<OCIE1A);
-	
-	// Make sure the interrupt flag is cleared by writing a 
-	// 1 to it.
-	TIFR1 &= (1<<OCF1A);
-	
+
 	//Reenable interrupts
 	if(interruptsOn) {
 		sei();
@@ -80,32 +150,148 @@ void init_buzzer(void) {
 
 void play_sound(uint16_t frequency, uint8_t time) {
 	// Ignore invalid values
-	if (frequency < FREQ_MIN || frequency > FREQ_MAX || queue_length >= SOUND_QUEUE_SIZE) {
+	if (frequency < FREQ_MIN || frequency > FREQ_MAX) {
+		return;
+	}
+
+	// Add this sound to the queue, if there's room.
+	uint8_t next_head = (queue_head + 1) & (SOUND_QUEUE_SIZE - 1);
+	if (next_head == queue_tail) {
 		return;
 	}
-	
-	// Add this sound to the queue.
-	sound_frequencies_queue[queue_length] = frequency;
-	sound_times_queue[queue_length] = time;
-	queue_length++;
+	sound_pitch_queue[queue_head] = PITCH_VALUE((uint32_t)frequency);
+	sound_times_queue[queue_head] = time;
+	queue_head = next_head;
 }
 
 void play_quiet_sound(uint16_t frequency, uint8_t time) {
-	// Ignore if other sounds are playing.
-	if (queue_length > 0) {
+	// Ignore if other effects or an alert are playing.
+	if (queue_head != queue_tail || effect_time_left != 0 ||
+			(tune_next && tune_priority == SOUND_PRIORITY_ALERT)) {
 		return;
 	}
-	
+
 	// Add to queue.
 	play_sound(frequency, time);
 }
 
+void play_tune(const uint8_t* tune, uint8_t priority) {
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+
+	// Only replace a tune which is as or less important than this one
+	if (tune_next == 0 || priority >= tune_priority) {
+		tune_next = tune;
+		tune_priority = priority;
+		tune_time_left = 0;
+
+		// Alerts cut off any effects
+		if (priority == SOUND_PRIORITY_ALERT) {
+			queue_tail = queue_head;
+			effect_time_left = 0;
+		}
+	}
+
+	if(interruptsOn) {
+		sei();
+	}
+}
+
 void clear_sounds() {
-	queue_length = 0;
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	queue_tail = queue_head;
+	tune_next = 0;
+	if(interruptsOn) {
+		sei();
+	}
 }
 
 uint8_t is_playing_sound(void) {
-	return (queue_length > 0);
+	return (queue_head != queue_tail || tune_next != 0);
+}
+
+void sound_timer_tick(void) {
+	// Deactivate sound if D3 is not active.
+	if (!is_sound_on()) {
+		queue_tail = queue_head;
+		tune_next = 0;
+		effect_time_left = 0;
+#ifdef SOUND_SYNTH
+		synth_silence();
+#else
+		set_output(0);
+#endif
+		return;
+	}
+
+#ifdef SOUND_SYNTH
+	synth_timer_tick();
+#endif
+
+	// Keep playing the current effect until its time is up. Otherwise,
+	// effects take priority over background tunes, but not alerts.
+	uint8_t effect_playing = 1;
+	if (effect_time_left == 0 || --effect_time_left == 0) {
+		if (queue_head != queue_tail &&
+				!(tune_next && tune_priority > SOUND_PRIORITY_EFFECT)) {
+#ifdef SOUND_SYNTH
+			synth_note_on(SYNTH_VOICE_EFFECT, sound_pitch_queue[queue_tail]);
+#else
+			set_output(sound_pitch_queue[queue_tail]);
+#endif
+			effect_time_left = 10 * sound_times_queue[queue_tail];
+			queue_tail = (queue_tail + 1) & (SOUND_QUEUE_SIZE - 1);
+		} else {
+			effect_playing = 0;
+#ifdef SOUND_SYNTH
+			synth_note_off(SYNTH_VOICE_EFFECT);
+#endif
+		}
+	}
+
+#ifdef SOUND_SYNTH
+	// The tune is mixed with any effect on its own voice
+	(void)effect_playing;
+#else
+	// There's only one square wave, so the tune waits for the effect
+	if (effect_playing) {
+		return;
+	}
+#endif
+
+	if (tune_next) {
+		// Move on to the next note of the tune if required
+		if (tune_time_left == 0) {
+			uint8_t note = pgm_read_byte(tune_next);
+			if (note == TUNE_END) {
+				tune_next = 0;
+#ifdef SOUND_SYNTH
+				synth_note_off(SYNTH_VOICE_MELODY);
+#else
+				set_output(0);
+#endif
+				return;
+			}
+			tune_pitch = pgm_read_word(&note_pitches[note]);
+			tune_time_left = 10 * pgm_read_byte(tune_next + 1);
+			tune_next += 2;
+#ifdef SOUND_SYNTH
+			synth_note_on(SYNTH_VOICE_MELODY, tune_pitch);
+#endif
+		}
+#ifndef SOUND_SYNTH
+		// (Re)start the note if an effect was played over it
+		set_output(tune_pitch);
+#endif
+		tune_time_left--;
+	} else {
+#ifdef SOUND_SYNTH
+		synth_note_off(SYNTH_VOICE_MELODY);
+#else
+		set_output(0);
+#endif
+	}
 }
 
 /* HELPER FUNCTIONS */
@@ -118,28 +304,7 @@ uint16_t get_OCRB_value(uint16_t frequency) {
 	// firing with a frequency twice that of the sound.
 	// Also, OCR value = counts/interrupt = (counts/s)/(interrupts/s).
 	// We then subtract 1 because we start counting from 0.
-	return (SYS_CLK/(frequency*2)) - 1;
-}
-
-void start_next_sound(void) {
-	// Clear the timer
-	TCNT1 = 0;
-	
-	// Set the output compare value to match the next sound's frequency
-	OCR1A = get_OCRB_value(sound_frequencies_queue[0]);
-	
-	// Start toggling the OCR1A pin (D5)
-	start_toggling();
-	
-	// Set the time to stop playing
-	stop_time = get_clock_ticks() + 10 * sound_times_queue[0];
-	
-	// Decrease queue length
-	for(uint8_t i = 1; i < queue_length; i++) {
-		sound_frequencies_queue[i-1] = sound_frequencies_queue[i];
-		sound_times_queue[i-1] = sound_times_queue[i];
-	}
-	queue_length--;
+	return OCR_VALUE((uint32_t)frequency);
 }
 
 void start_toggling(void) {
@@ -150,62 +315,42 @@ void stop_toggling(void) {
 	TCCR1A &= ~(1<<COM1A0);
 }
 
-ISR(TIMER1_COMPA_vect) {
-	// This interrupt should fire with the frequency of the current sound,
-	// and serves to ensure that the current sound stops playing as neccessary.
-	// It bases this off the values returned by timer 0.
-	
-	// Deactivate sound if D3 is not active.
-	if (!is_sound_on()) {
-		queue_length = 0;
-		
+#ifndef SOUND_SYNTH
+// Play the given OCR1A value on the buzzer, or stop the buzzer if it
+// is 0. Timer 1 is only touched if this is different to what is
+// already playing.
+static void set_output(uint16_t ocr_value) {
+	if (ocr_value == output_ocr_value) {
+		return;
+	}
+	output_ocr_value = ocr_value;
+	if (ocr_value == 0) {
 		// Stop toggling the OCR1A pin (D5)
 		stop_toggling();
 		return;
 	}
-	
-	// If we are now past the time for this sound to stop:
-	if (get_clock_ticks() > stop_time) {
-		// If this isn't the last sound, go to the next.
-		// Otherwise, stop playing sounds.
-		if (queue_length != 0) {
-			start_next_sound();
-		} else {
-			// Stop toggling the OCR1A pin (D5)
-			stop_toggling();
-		}
-	}
+
+	// Clear the timer. (Otherwise if the new OCR1A value is below
+	// the count, the timer would run all the way around first.)
+	TCNT1 = 0;
+	OCR1A = ocr_value;
+
+	// Start toggling the OCR1A pin (D5)
+	start_toggling();
 }
+#endif
 
 
 /* In-built tunes */
 void play_tune_startup(void) {
-	clear_sounds();
-	play_sound(FREQ_F5, 37);
-	play_sound(FREQ_C5SHARP, 10);
-	play_sound(FREQ_D5SHARP, 30);
-	play_sound(FREQ_G5SHARP, 25);
-	play_sound(FREQ_F5, 25);
-	play_sound(FREQ_C5SHARP, 40);
+	play_tune(tune_startup, SOUND_PRIORITY_BACKGROUND);
 }
 void play_tune_success(void) {
-	clear_sounds();
-	play_sound(FREQ_C5SHARP, 10);
-	play_sound(FREQ_D5SHARP, 30);
-	play_sound(FREQ_G5SHARP, 25);
-	play_sound(FREQ_B5, 40);
+	play_tune(tune_success, SOUND_PRIORITY_BACKGROUND);
 }
 void play_tune_dead(void) {
-	clear_sounds();
-	play_sound(FREQ_F5, 15);
-	play_sound(FREQ_G5SHARP, 10);
-	play_sound(FREQ_C5SHARP, 10);
-	play_sound(FREQ_B4, 40);
+	play_tune(tune_dead, SOUND_PRIORITY_ALERT);
 }
 void play_tune_lost(void) {
-	clear_sounds();
-	play_sound(FREQ_G5SHARP, 10);
-	play_sound(FREQ_C5SHARP, 10);
-	play_sound(FREQ_B4, 10);
-	play_sound(FREQ_G4, 40);
-}
\ No newline at end of file
+	play_tune(tune_lost, SOUND_PRIORITY_ALERT);
+}
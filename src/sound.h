@@ -12,14 +12,28 @@
  * time value. The frequency is the Hz of the sound, while the
  * time is the length of the sound to play in hundredths of seconds.
  *
- * A jingle or tune is a combination of sounds in a particular order.
- * By playing multiple sounds in a row, this file can store them in
- * a buffer and play them in order as soon as each time value clears
- * up. This allows for the playing of simple melodies.
+ * Sounds played with play_sound() are effects. These are kept in a
+ * small queue and played in order as soon as each time value clears up.
+ *
+ * A jingle or tune is a list of notes (NOTE_* values) and times kept in
+ * program memory and finished by TUNE_END. Each tune is played with a
+ * priority: background tunes are paused while any effects are played
+ * over them and then carry on, while alert tunes cut off any effects
+ * and can't be interrupted by them. A tune will only replace another
+ * tune which is of the same or lower priority.
  *
  * Internally it uses timer1 for playing different frequencies and 
- * timer0 for organising its times. It stores an internal buffer of
- * the last 6 sounds, which it plays through at the soonest possible
+ * timer0 for organising its times. Timer1 toggles the buzzer pin in
+ * hardware, without any interrupts; the 1ms timer0 interrupt counts
+ * down the length of each sound and only reprograms timer1 when one
+ * sound ends and the next begins. How much CPU time this saves over
+ * the old timer1 interrupt hasn't been measured; the cost of the tick
+ * is part of the isr_timer0 marker in the cycle benchmark (see bench/).
+ * (If the firmware is built with
+ * SOUND_SYNTH defined, the two-voice synthesiser in synth.h is used
+ * instead, and effects are mixed with the tune rather than pausing it.)
+ * It stores an internal buffer of
+ * up to 7 effects, which it plays through at the soonest possible
  * opportunity.
  *
  * The buzzer must have one end set up at pin D5, and the other at
@@ -68,33 +82,79 @@
 #define FREQ_B5 988
 #define FREQ_C6 1047
 
+// Notes which can be used in tunes, and the value which marks
+// the end of a tune
+#define NOTE_C4 0
+#define NOTE_C4SHARP 1
+#define NOTE_D4 2
+#define NOTE_D4SHARP 3
+#define NOTE_E4 4
+#define NOTE_F4 5
+#define NOTE_F4SHARP 6
+#define NOTE_G4 7
+#define NOTE_G4SHARP 8
+#define NOTE_A4 9
+#define NOTE_A4SHARP 10
+#define NOTE_B4 11
+#define NOTE_C5 12
+#define NOTE_C5SHARP 13
+#define NOTE_D5 14
+#define NOTE_D5SHARP 15
+#define NOTE_E5 16
+#define NOTE_F5 17
+#define NOTE_F5SHARP 18
+#define NOTE_G5 19
+#define NOTE_G5SHARP 20
+#define NOTE_A5 21
+#define NOTE_A5SHARP 22
+#define NOTE_B5 23
+#define NOTE_C6 24
+#define NUM_NOTES 25
+#define TUNE_END 0xFF
+
+// Sound priorities, from least to most important
+#define SOUND_PRIORITY_BACKGROUND 0
+#define SOUND_PRIORITY_EFFECT 1
+#define SOUND_PRIORITY_ALERT 2
+
 /* Sets up this buzzer for use on an IO level.
  */
 void init_buzzer(void);
 
-/* Add a new sound to the internal buffer. If the buffer
+/* Add a new effect to the internal buffer. If the buffer
  * is full, or if the frequency is too low or high, this
  * command does nothing.
  */
 void play_sound(uint16_t frequency, uint8_t time);
 
-/* Add a new sound to the internal buffer ONLY if the
- * buffer is empty. Otherwise same as play_sound().
+/* Add a new effect to the internal buffer ONLY if no other
+ * effects or alerts are playing. Otherwise same as play_sound().
  * This is ideal for short sounds which should be ignored
  * when more important sounds are playing.
  */
 void play_quiet_sound(uint16_t frequency, uint8_t time);
 
-/* Clears all sounds in the buffer. Will cease all sounds
- * immediately after being run.
+/* Start playing the given tune (in program memory) with the given
+ * priority (SOUND_PRIORITY_BACKGROUND or SOUND_PRIORITY_ALERT). This
+ * does nothing if a more important tune is playing.
+ */
+void play_tune(const uint8_t* tune, uint8_t priority);
+
+/* Clears all effects in the buffer and stops any tune. The
+ * current effect will finish playing.
  */
 void clear_sounds(void);
 
-/* Returns whether or not a sound is contained in the buffer,
- * about to be played.
+/* Returns whether or not an effect is contained in the buffer,
+ * about to be played, or a tune is playing.
  */
 uint8_t is_playing_sound(void);
 
+/* Count down the current sound and move on to the next when it is
+ * finished. Called from the timer 0 interrupt handler every millisecond.
+ */
+void sound_timer_tick(void);
+
 /* HELPER FUNCTIONS */
 /* Returns whether the D3 pin is on or not.
  */
@@ -105,11 +165,6 @@ uint8_t is_sound_on(void);
  */
 uint16_t get_OCRB_value(uint16_t frequency);
 
-/* Advances to the next sound in the queue, setting the timer
- * accordingly.
- */
-void start_next_sound(void);
-
 /* Set pin D5 to start toggling values into the buzzer to play
  * sound.
  */
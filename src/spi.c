@@ -70,4 +70,45 @@ uint8_t spi_send_byte(uint8_t byte) {
 		; // wait
 	}
 	return SPDR0;
-}
\ No newline at end of file
+}
+
+void spi_setup_slave_selects(uint8_t num_slaves) {
+	// Select lines are active low, so start them all high
+	if(num_slaves > 1) {
+		DDRA |= (1<<4);
+		PORTA |= (1<<4);
+	}
+	if(num_slaves > 2) {
+		DDRA |= (1<<5);
+		PORTA |= (1<<5);
+	}
+	if(num_slaves > 3) {
+		DDRD |= (1<<6);
+		PORTD |= (1<<6);
+	}
+}
+
+void spi_select_slave(uint8_t slave) {
+	// Deselect them all, then take the one we want low. (The unused
+	// lines are inputs, so writing to them only changes their pull-ups.
+	// Each bit is set on its own so that these are single SBI/CBI
+	// instructions, which an interrupt can't come in the middle of.)
+	PORTB |= (1<<4);
+	PORTA |= (1<<4);
+	PORTA |= (1<<5);
+	PORTD |= (1<<6);
+	switch(slave) {
+		case 0:
+			PORTB &= ~(1<<4);
+			break;
+		case 1:
+			PORTA &= ~(1<<4);
+			break;
+		case 2:
+			PORTA &= ~(1<<5);
+			break;
+		case 3:
+			PORTD &= ~(1<<6);
+			break;
+	}
+}
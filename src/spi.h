@@ -15,4 +15,16 @@ void spi_setup_master(uint8_t clockdivider);
 // cyles of the divided clock
 uint8_t spi_send_byte(uint8_t byte);
 
+// Most slaves which can share the bus. Each has its own slave select
+// line: slave 0 uses SS (B4), slaves 1 to 3 use A4, A5 and D6.
+#define SPI_MAX_SLAVES 4
+
+// Make the select lines of slaves 1 to num_slaves-1 outputs, with those
+// slaves not selected. (spi_setup_master() selects slave 0.)
+void spi_setup_slave_selects(uint8_t num_slaves);
+
+// Select the given slave (0 to SPI_MAX_SLAVES-1) and deselect the others.
+// Only call this between transfers.
+void spi_select_slave(uint8_t slave);
+
 #endif /* SPI_H_ */
\ No newline at end of file
@@ -0,0 +1,99 @@
+/*
+ * stackcheck.c
+ *
+ * Written by Sean Manson
+ *
+ * Stack painting and overflow checks.
+ */
+
+#include "stackcheck.h"
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+
+#include "eestore.h"
+#include "terminalio.h"
+
+// Value each byte of the stack area is painted with. (Unlikely to be
+// pushed by chance, unlike 0x00 or 0xFF.)
+#define STACK_PAINT 0xC5
+
+// Set by the linker: the end of the variables (.data, .bss and
+// .noinit), and the top of the stack
+extern uint8_t _end;
+extern uint8_t __stack;
+
+void paint_stack(void) __attribute__((naked, used, section(".init1")));
+
+// Runs before the C runtime has set anything up (including r1 being
+// zero), so this is written in assembler. Paints every byte from _end
+// to __stack inclusive.
+void paint_stack(void) {
+	__asm__ volatile (
+		"    ldi r30, lo8(_end)\n"
+		"    ldi r31, hi8(_end)\n"
+		"    ldi r24, %0\n"
+		"    ldi r25, hi8(__stack)\n"
+		"    rjmp 2f\n"
+		"1:  st Z+, r24\n"
+		"2:  cpi r30, lo8(__stack)\n"
+		"    cpc r31, r25\n"
+		"    brlo 1b\n"
+		"    breq 1b\n"
+		:: "M" (STACK_PAINT)
+	);
+}
+
+uint16_t get_stack_size(void) {
+	return &__stack - &_end + 1;
+}
+
+uint16_t get_stack_high_water(void) {
+	const uint8_t* p = &_end;
+	while (p <= &__stack && *p == STACK_PAINT) {
+		p++;
+	}
+	return &__stack - p + 1;
+}
+
+void check_stack(void) {
+	const uint8_t* p = &_end;
+	uint8_t i;
+
+	for (i = 0; i < STACK_GUARD_SIZE; i++) {
+		if (p[i] != STACK_PAINT) {
+			break;
+		}
+	}
+	if (i == STACK_GUARD_SIZE) {
+		return;
+	}
+
+	// The stack has overflowed into the guard zone. The variables should
+	// still be intact, so let anything already queued for the EEPROM
+	// finish, but don't let anything else be saved.
+	eestore_lock();
+
+	clear_terminal();
+	set_display_attribute(RED_TEXT);
+	move_cursor(SCREENSPACE(5, 7));
+	printf_P(PSTR("Stack overflow - halted."));
+	move_cursor(SCREENSPACE(5, 8));
+	printf_P(PSTR("Used %u of %u bytes of stack."), get_stack_high_water(),
+			get_stack_size());
+	move_cursor(SCREENSPACE(5, 9));
+	printf_P(PSTR("Reset the board to continue."));
+	normal_display_mode();
+
+	// Stay here. Interrupts are left on so the message above is sent.
+	while (1) {
+		;
+	}
+}
+
+void stack_report(uint8_t screen_x, uint8_t screen_y) {
+	move_cursor(SCREENSPACE(screen_x, screen_y));
+	printf_P(PSTR("Stack: %u of %u bytes used (most so far)"),
+			get_stack_high_water(), get_stack_size());
+}
@@ -0,0 +1,53 @@
+/*
+ * stackcheck.h
+ *
+ * Author: Sean Manson
+ *
+ * Stack usage monitoring.
+ *
+ * At startup (before main() is called, from the .init1 section) all of
+ * the SRAM between the end of the variables and the top of the stack
+ * is painted with a fixed pattern. The stack grows down into this
+ * area, and anything it overwrites stays overwritten, so the lowest
+ * painted byte left tells us how deep the stack has ever been - even
+ * inside interrupt handlers.
+ *
+ * The bottom STACK_GUARD_SIZE bytes of the area are a guard zone. If
+ * any of these has been overwritten the stack has come within a few
+ * bytes of the variables, and the next deeper call could corrupt them
+ * (and, through them, what we save to the EEPROM). check_stack()
+ * looks for this and halts the game if so.
+ */
+
+#ifndef STACKCHECK_H_
+#define STACKCHECK_H_
+
+#include <stdint.h>
+
+// Number of bytes at the bottom of the stack area which must never be
+// used
+#define STACK_GUARD_SIZE 16
+
+/* Return the size of the stack area (the free SRAM when the program
+ * started), in bytes.
+ */
+uint16_t get_stack_size(void);
+
+/* Return the most stack that has been used since the program started,
+ * in bytes.
+ */
+uint16_t get_stack_high_water(void);
+
+/* Check the guard zone at the bottom of the stack area. If it has been
+ * overwritten, finish any EEPROM writes, stop any more from being made,
+ * print a message on the terminal and halt. Otherwise returns straight
+ * away. Should be called regularly from the main loop (not from an
+ * interrupt handler). eestore_write() calls this before anything is saved.
+ */
+void check_stack(void);
+
+/* Print the stack usage on the terminal at the given position.
+ */
+void stack_report(uint8_t screen_x, uint8_t screen_y);
+
+#endif /* STACKCHECK_H_ */
@@ -0,0 +1,203 @@
+/*
+ * synth.c
+ *
+ * Written by Sean Manson
+ *
+ * Two-voice synthesiser for the buzzer. Only built when SOUND_SYNTH
+ * is defined.
+ */
+
+#include "synth.h"
+#include "bench.h"
+
+#ifdef SOUND_SYNTH
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+// One cycle of our waveform: a sine with some odd harmonics added to
+// give it a bit more bite on the buzzer. The peak is 63 so that two
+// voices at full volume still fit in a signed byte.
+#define WAVETABLE_BITS 5
+static const int8_t wavetable[1<<WAVETABLE_BITS] PROGMEM = {
+	0, 37, 60, 63, 55, 48, 49, 56, 59, 56, 49, 48, 55, 63, 60, 37,
+	0, -37, -60, -63, -55, -48, -49, -56, -59, -56, -49, -48, -55, -63, -60, -37
+};
+
+// Envelope stages
+#define ENVELOPE_OFF 0
+#define ENVELOPE_ATTACK 1
+#define ENVELOPE_DECAY 2
+#define ENVELOPE_SUSTAIN 3
+#define ENVELOPE_RELEASE 4
+
+// Volume change per millisecond for each stage, and the level each
+// voice decays to. The effect voice is kept louder so it stands out
+// over the melody.
+#define ATTACK_STEP 64
+#define DECAY_STEP 4
+#define RELEASE_STEP 8
+static const uint8_t sustain_level[2] = {144, 208};
+
+// The state of each voice. These are only changed from interrupt
+// handlers, which don't interrupt each other.
+static volatile uint16_t phase[2];
+static volatile uint16_t step[2];
+static volatile uint8_t volume[2];
+static uint8_t envelope[2];
+
+// Longest the sample interrupt has taken, in timer2 counts (8 cycles)
+static volatile uint8_t max_isr_count;
+
+static void start_sampling(void);
+static void stop_sampling(void);
+
+void init_synth(void) {
+	// Disable interrupts so we can be sure that the interrupts
+	// don't fire halfway through.
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+
+	for (uint8_t voice = 0; voice < 2; voice++) {
+		phase[voice] = 0;
+		step[voice] = 0;
+		volume[voice] = 0;
+		envelope[voice] = ENVELOPE_OFF;
+	}
+	max_isr_count = 0;
+
+	// Timer 1 in 8-bit fast PWM mode, not dividing the clock. The
+	// output on OC1A (D5) is connected when sampling starts.
+	TCNT1 = 0;
+	OCR1A = 128;
+	TCCR1A = (1<<WGM10);
+	TCCR1B = (1<<WGM12)|(1<<CS10);
+	TIMSK1 = 0;
+
+	// Timer 2 clears on compare match, dividing the clock by 8 and
+	// counting to 124. This gives a sample every 125us (8kHz).
+	TCNT2 = 0;
+	OCR2A = 124;
+	TCCR2A = (1<<WGM21);
+	TCCR2B = (1<<CS21);
+	TIMSK2 &= ~(1<<OCIE2A);
+
+	//Reenable interrupts
+	if(interruptsOn) {
+		sei();
+	}
+}
+
+void synth_note_on(uint8_t voice, uint16_t new_step) {
+	step[voice] = new_step;
+	envelope[voice] = ENVELOPE_ATTACK;
+	start_sampling();
+}
+
+void synth_note_off(uint8_t voice) {
+	if (envelope[voice] != ENVELOPE_OFF && envelope[voice] != ENVELOPE_RELEASE) {
+		envelope[voice] = ENVELOPE_RELEASE;
+	}
+}
+
+void synth_silence(void) {
+	for (uint8_t voice = 0; voice < 2; voice++) {
+		volume[voice] = 0;
+		envelope[voice] = ENVELOPE_OFF;
+	}
+	stop_sampling();
+}
+
+void synth_timer_tick(void) {
+	uint8_t voice, level;
+
+	for (voice = 0; voice < 2; voice++) {
+		level = volume[voice];
+		switch (envelope[voice]) {
+			case ENVELOPE_ATTACK:
+			if (level >= 255 - ATTACK_STEP) {
+				level = 255;
+				envelope[voice] = ENVELOPE_DECAY;
+			} else {
+				level += ATTACK_STEP;
+			}
+			break;
+			case ENVELOPE_DECAY:
+			if (level <= sustain_level[voice] + DECAY_STEP) {
+				level = sustain_level[voice];
+				envelope[voice] = ENVELOPE_SUSTAIN;
+			} else {
+				level -= DECAY_STEP;
+			}
+			break;
+			case ENVELOPE_RELEASE:
+			if (level <= RELEASE_STEP) {
+				level = 0;
+				envelope[voice] = ENVELOPE_OFF;
+			} else {
+				level -= RELEASE_STEP;
+			}
+			break;
+		}
+		volume[voice] = level;
+	}
+
+	// Stop working out samples once both voices have faded out
+	if (envelope[SYNTH_VOICE_MELODY] == ENVELOPE_OFF &&
+			envelope[SYNTH_VOICE_EFFECT] == ENVELOPE_OFF) {
+		stop_sampling();
+	}
+}
+
+uint16_t get_synth_max_isr_cycles(void) {
+	return max_isr_count * 8;
+}
+
+
+/* HELPER FUNCTIONS */
+// Connect the PWM output and start the sample interrupt
+static void start_sampling(void) {
+	if (TIMSK2 & (1<<OCIE2A)) {
+		return;
+	}
+	OCR1A = 128;
+	TCCR1A |= (1<<COM1A1);
+	TCNT2 = 0;
+	TIFR2 = (1<<OCF2A);
+	TIMSK2 |= (1<<OCIE2A);
+}
+
+// Stop the sample interrupt and disconnect the PWM output
+static void stop_sampling(void) {
+	TIMSK2 &= ~(1<<OCIE2A);
+	TCCR1A &= ~(1<<COM1A1);
+}
+
+ISR(TIMER2_COMPA_vect) {
+	BENCH_BEGIN(BENCH_ISR_SYNTH);
+	int8_t mix;
+	uint8_t count;
+
+	// Step each voice through the wavetable, scale it by its volume
+	// and mix the two together
+	phase[0] += step[0];
+	phase[1] += step[1];
+	mix = ((int8_t)pgm_read_byte(&wavetable[phase[0] >> (16 - WAVETABLE_BITS)])
+			* (int16_t)volume[0]) >> 8;
+	mix += ((int8_t)pgm_read_byte(&wavetable[phase[1] >> (16 - WAVETABLE_BITS)])
+			* (int16_t)volume[1]) >> 8;
+
+	// Centre the sample in the PWM range
+	OCR1A = (uint8_t)(128 + mix);
+
+	// Timer 2 was cleared at the compare match, so it now holds how
+	// long we've taken (including getting into the handler)
+	count = TCNT2;
+	if (count > max_isr_count) {
+		max_isr_count = count;
+	}
+	BENCH_END(BENCH_ISR_SYNTH);
+}
+
+#endif /* SOUND_SYNTH */
@@ -0,0 +1,76 @@
+/*
+ * synth.h
+ *
+ * Author: Sean Manson
+ *
+ * Two-voice synthesiser for the buzzer.
+ *
+ * When the firmware is built with SOUND_SYNTH defined, sound.c plays
+ * through this instead of toggling the buzzer pin directly. Timer1
+ * runs in 8-bit fast PWM mode on OC1A (D5), giving a ~31kHz carrier,
+ * and timer2 interrupts SYNTH_SAMPLE_RATE times a second to work out
+ * the next sample. Each sample mixes two voices - the melody (tunes)
+ * and the effect (e.g. the movement blip) - so effects no longer cut
+ * off the music.
+ *
+ * Each voice has a 16-bit phase accumulator which steps through a
+ * 32-entry wavetable in program memory, and an 8-bit volume. Volumes
+ * follow a simple attack/decay/sustain/release envelope, updated from
+ * the 1ms timer0 tick rather than in the sample interrupt.
+ *
+ * The sample interrupt has no loops and a fixed path, so its length
+ * is bounded. Its worst case is measured as it runs (by reading timer2
+ * at the end of the handler) and can be retrieved with
+ * get_synth_max_isr_cycles(). The sample interrupt is turned off
+ * whenever both voices are silent.
+ */
+
+#ifndef SYNTH_H_
+#define SYNTH_H_
+
+#include <stdint.h>
+
+// Samples per second
+#define SYNTH_SAMPLE_RATE 8000
+
+// The phase step for a given frequency
+#define SYNTH_STEP(frequency) ((uint16_t)(((uint32_t)(frequency) << 16) / SYNTH_SAMPLE_RATE))
+
+// Voices
+#define SYNTH_VOICE_MELODY 0
+#define SYNTH_VOICE_EFFECT 1
+
+// Most clock cycles the sample interrupt may take (out of the
+// 1000 cycles between samples)
+#define SYNTH_CYCLE_BUDGET 200
+
+/* Sets up timers 1 and 2 for synthesis. Both voices start silent.
+ */
+void init_synth(void);
+
+/* Start playing a note with the given phase step (see SYNTH_STEP)
+ * on a voice, restarting its envelope.
+ */
+void synth_note_on(uint8_t voice, uint16_t step);
+
+/* Let the note on a voice fade out. Does nothing if the voice is
+ * already fading or silent.
+ */
+void synth_note_off(uint8_t voice);
+
+/* Silence both voices immediately.
+ */
+void synth_silence(void);
+
+/* Update the voice envelopes. Called every millisecond from the
+ * timer 0 interrupt handler (via sound_timer_tick()).
+ */
+void synth_timer_tick(void);
+
+/* Returns the longest time the sample interrupt has taken, in clock
+ * cycles, from the compare match to the end of the handler (to the
+ * nearest 8 cycles, not including the final register restores).
+ */
+uint16_t get_synth_max_isr_cycles(void);
+
+#endif /* SYNTH_H_ */
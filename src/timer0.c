@@ -13,6 +13,10 @@
 #include <avr/interrupt.h>
 
 #include "timer0.h"
+#include "joystick.h"
+#include "buttons.h"
+#include "sound.h"
+#include "bench.h"
 
 /* Our internal clock tick count - incremented every 
  * millisecond. Will overflow every ~49 days. */
@@ -92,6 +96,31 @@ uint32_t get_clock_ticks(void) {
 	return returnValue;
 }
 
+uint32_t get_clock_micros(void) {
+	uint32_t ticks;
+	uint8_t count;
+
+	/* Read the tick count and the current position of the timer
+	 * together. If the compare match has already happened but its
+	 * interrupt hasn't run yet (e.g. we are inside another interrupt
+	 * handler) then the timer has wrapped without clockTicks being
+	 * incremented, so we account for that millisecond ourselves.
+	 */
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	ticks = clockTicks;
+	count = TCNT0;
+	if((TIFR0 & (1<<OCF0A)) && count < OCR0A) {
+		ticks++;
+	}
+	if(interruptsOn) {
+		sei();
+	}
+	
+	/* Each timer count is 64 clock cycles, i.e. 8us at 8MHz */
+	return ticks*1000 + (uint16_t)count*8;
+}
+
 uint32_t get_ingame_clock_ticks(void) {
 	uint32_t returnValue;
 
@@ -145,9 +174,16 @@ uint8_t get_countdown_time_remaining(void) {
 
 
 ISR(TIMER0_COMPA_vect) {
+	BENCH_BEGIN(BENCH_ISR_TIMER0);
 	/* Increment our clock tick count */
 	clockTicks++;
 	
+	/* Sample the buttons, time any repeated joystick movement
+	 * and move on to the next sound when required */
+	button_timer_tick();
+	joystick_timer_tick();
+	sound_timer_tick();
+	
 	if (ingame_timer_is_counting) {
 		inGameClockTicks++;
 		if (countdown > 0) {
@@ -194,4 +230,5 @@ ISR(TIMER0_COMPA_vect) {
 	} else {
 		PORTD &= ~(1 << PORTD2);
 	}
+	BENCH_END(BENCH_ISR_TIMER0);
 }
@@ -35,6 +35,12 @@ void init_timer0(void);
  */
 uint32_t get_clock_ticks(void);
 
+/* Return the current time in microseconds since the timer was initialised,
+ * with a resolution of 8us (one count of timer 0). Safe to call from an
+ * interrupt handler. Will overflow every ~71 minutes.
+ */
+uint32_t get_clock_micros(void);
+
 /* Return the click value for the in-game timer, which can be manually
  * stopped and started.
  */